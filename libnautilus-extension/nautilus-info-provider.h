@@ -58,6 +58,15 @@ struct _NautilusInfoProviderIface {
 						     NautilusOperationHandle **handle);
 	void                    (*cancel_update)    (NautilusInfoProvider     *provider,
 						     NautilusOperationHandle  *handle);
+
+	/* Optional. Updates all the files in the list, which come from
+	 * the same directory, and completes them together. Providers
+	 * that leave this NULL get update_file_info called per file.
+	 */
+	NautilusOperationResult (*update_file_info_batch) (NautilusInfoProvider     *provider,
+							   GList                    *files,
+							   GClosure                 *update_complete,
+							   NautilusOperationHandle **handle);
 };
 
 /* Interface Functions */
@@ -68,6 +77,11 @@ NautilusOperationResult nautilus_info_provider_update_file_info       (NautilusI
 								       NautilusOperationHandle **handle);
 void                    nautilus_info_provider_cancel_update          (NautilusInfoProvider     *provider,
 								       NautilusOperationHandle  *handle);
+gboolean                nautilus_info_provider_can_update_file_info_batch (NautilusInfoProvider *provider);
+NautilusOperationResult nautilus_info_provider_update_file_info_batch (NautilusInfoProvider     *provider,
+								       GList                    *files,
+								       GClosure                 *update_complete,
+								       NautilusOperationHandle **handle);
 
 
 
@@ -50,6 +50,13 @@ static int ring_buffer_max_lines = DEFAULT_RING_BUFFER_NUM_LINES;
 static GSList *milestones_head;
 static GSList *milestones_tail;
 
+typedef struct {
+	char *name;
+	NautilusDebugLogSectionFunc func;
+} Section;
+
+static GSList *sections;
+
 static void
 lock (void)
 {
@@ -577,6 +584,54 @@ dump_ring_buffer (const char *filename, FILE *file, GError **error)
 	return TRUE;
 }
 
+static gboolean
+dump_sections (const char *filename, FILE *file, GError **error)
+{
+	GSList *l;
+
+	for (l = sections; l; l = l->next) {
+		Section *section;
+		char *begin, *end, *str;
+		gboolean success;
+
+		section = l->data;
+
+		begin = g_strdup_printf ("===== BEGIN %s =====\n", section->name);
+		end = g_strdup_printf ("===== END %s =====\n", section->name);
+		str = (* section->func) ();
+
+		success = (write_string (filename, file, begin, error)
+			   && (str == NULL || write_string (filename, file, str, error))
+			   && write_string (filename, file, end, error));
+
+		g_free (begin);
+		g_free (end);
+		g_free (str);
+
+		if (!success)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+void
+nautilus_debug_log_add_section (const char *name, NautilusDebugLogSectionFunc func)
+{
+	Section *section;
+
+	g_assert (name != NULL);
+	g_assert (func != NULL);
+
+	section = g_new (Section, 1);
+	section->name = g_strdup (name);
+	section->func = func;
+
+	lock ();
+	sections = g_slist_append (sections, section);
+	unlock ();
+}
+
 gboolean
 nautilus_debug_log_dump (const char *filename, GError **error)
 {
@@ -603,6 +658,7 @@ nautilus_debug_log_dump (const char *filename, GError **error)
 
 	if (!(dump_milestones (filename, file, error)
 	      && dump_ring_buffer (filename, file, error)
+	      && dump_sections (filename, file, error)
 	      && dump_configuration (filename, file, error))) {
 		goto do_close;
 	}
@@ -49,6 +49,14 @@ gboolean nautilus_debug_log_is_domain_enabled (const char *domain);
 
 gboolean nautilus_debug_log_dump (const char *filename, GError **error);
 
+/* Sections are extra blocks of text written by nautilus_debug_log_dump(),
+ * for subsystems that keep their own statistics.  The function is called
+ * with the debug log lock held, so it must not log anything itself.
+ */
+typedef char * (* NautilusDebugLogSectionFunc) (void);
+
+void nautilus_debug_log_add_section (const char *name, NautilusDebugLogSectionFunc func);
+
 void nautilus_debug_log_set_max_lines (int num_lines);
 int nautilus_debug_log_get_max_lines (void);
 
@@ -163,6 +163,7 @@ update_info_from_link (NautilusDesktopIconFile *icon_file)
 {
 	NautilusFile *file;
 	NautilusDesktopLink *link;
+	NautilusFileRareDetails *rare;
 	char *display_name;
 	GMount *mount;
 	
@@ -206,8 +207,9 @@ update_info_from_link (NautilusDesktopIconFile *icon_file)
 		g_object_unref (file->details->icon);
 	}
 	file->details->icon = nautilus_desktop_link_get_icon (link);
-	g_free (file->details->activation_uri);
-	file->details->activation_uri = nautilus_desktop_link_get_activation_uri (link);
+	rare = nautilus_file_ensure_rare_details (file);
+	g_free (rare->activation_uri);
+	rare->activation_uri = nautilus_desktop_link_get_activation_uri (link);
 	file->details->got_link_info = TRUE;
 	file->details->link_info_is_up_to_date = TRUE;
 
@@ -24,12 +24,15 @@
 
 #include <config.h>
 
+#include "nautilus-debug-log.h"
 #include "nautilus-directory-notify.h"
 #include "nautilus-directory-private.h"
 #include "nautilus-file-attributes.h"
+#include "nautilus-file-icon-cache.h"
 #include "nautilus-file-private.h"
 #include "nautilus-file-utilities.h"
 #include "nautilus-signaller.h"
+#include "nautilus-trace.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-link.h"
 #include "nautilus-marshal.h"
@@ -37,8 +40,11 @@
 #include <eel/eel-string.h>
 #include <gtk/gtk.h>
 #include <libxml/parser.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 /* turn this on to see messages about each load_directory call: */
 #if 0
@@ -60,6 +66,54 @@
 /* Keep async. jobs down to this number for all directories. */
 #define MAX_ASYNC_JOBS 10
 
+/* Thumbnails are read and decoded in threads, a few at a time for
+ * each directory.
+ */
+#define MAX_THUMBNAIL_LOADS_PER_DIRECTORY 4
+
+/* A folder's thumbnail pack is written this many seconds after the
+ * last thumbnail was read, if it has at least this many thumbnails.
+ */
+#define THUMBNAIL_PACK_WRITE_DELAY 10
+#define MIN_THUMBNAILS_PER_PACK 32
+
+/* File info is refreshed with this many queries in flight per
+ * directory. A local query is a stat() that a few threads keep up
+ * with, a remote one mostly waits for the server, so more of those
+ * are sent at once to hide the round trips.
+ */
+#define MAX_FILE_INFO_QUERIES_PER_LOCAL_DIRECTORY 4
+#define MAX_FILE_INFO_QUERIES_PER_REMOTE_DIRECTORY 8
+
+/* Directory item counts are done in threads, this many at a time for
+ * each directory. Results for directories that haven't changed are
+ * remembered.
+ */
+#define MAX_DIRECTORY_COUNTS_PER_DIRECTORY 8
+#define DIRECTORY_COUNT_CACHE_SIZE 10000
+
+/* Deep counts of directory subtrees are remembered too, so counting a
+ * parent later can reuse them. Entries are dropped when a change
+ * notification comes in for anything below them, and not trusted
+ * after DEEP_COUNT_CACHE_MAX_AGE seconds since changes in unmonitored
+ * subdirectories don't show up in the mtime of the subtree root.
+ */
+#define DEEP_COUNT_CACHE_SIZE 10000
+#define DEEP_COUNT_CACHE_MAX_AGE (10 * 60)
+
+/* How long dequeue_pending_idle_callback may keep the main loop
+ * busy, in microseconds, and how many files it handles between
+ * looking at the clock.
+ */
+#define DEQUEUE_PENDING_TIME_SLICE (8 * 1000)
+#define DEQUEUE_PENDING_CHECK_TIME_INTERVAL 16
+
+/* Most files a batching info provider gets in one call */
+#define MAX_EXTENSION_INFO_BATCH 100
+
+/* How often results of jobs run in threads are handed to the main loop */
+#define JOB_RESULT_DELIVERY_INTERVAL 50
+
 struct TopLeftTextReadState {
 	NautilusDirectory *directory;
 	NautilusFile *file;
@@ -77,10 +131,22 @@ struct ThumbnailState {
 	NautilusDirectory *directory;
 	GCancellable *cancellable;
 	NautilusFile *file;
-	gboolean trying_original;
 	gboolean tried_original;
+
+	/* Set up before the job starts, only used by the job */
+	GFile *original_location;
+	GFile *thumbnail_location;
+
+	/* Result of the job */
+	GdkPixbuf *pixbuf;
 };
 
+/* A thumbnail found in the folder's pack, to tell views about */
+typedef struct {
+	NautilusDirectory *directory;
+	NautilusFile *file;
+} ThumbnailPackHit;
+
 struct MountState {
 	NautilusDirectory *directory;
 	GCancellable *cancellable;
@@ -100,6 +166,14 @@ struct DirectoryLoadState {
 	GHashTable *load_mime_list_hash;
 	NautilusFile *load_directory_file;
 	int load_file_count;
+
+	/* For the debug log */
+	int load_batch_count;
+	int load_info_count;
+	int load_new_file_count;
+	int load_updated_file_count;
+	int load_shared_name_count;
+	int load_mime_type_copy_count;
 };
 
 struct MimeListState {
@@ -112,6 +186,7 @@ struct MimeListState {
 
 struct GetInfoState {
 	NautilusDirectory *directory;
+	NautilusFile *file;
 	GCancellable *cancellable;
 };
 
@@ -125,17 +200,49 @@ struct DirectoryCountState {
 	NautilusDirectory *directory;
 	NautilusFile *count_file;
 	GCancellable *cancellable;
-	GFileEnumerator *enumerator;
-	int file_count;
+
+	/* Set up before the job starts, only used by the job */
+	GFile *location;
+	time_t cached_mtime;
+	guint cached_counts[2][2];
+
+	/* Result of the job, see DirectoryCountCacheEntry */
+	time_t mtime;
+	gboolean from_cache;
+	gboolean succeeded;
+	guint counts[2][2];
 };
 
+/* A directory in the tree being deep counted. The totals of its
+ * subtree are the deep counts of the file when it is done minus
+ * those when it was started.
+ */
+typedef struct {
+	GFile *location;
+	guint32 device;
+	guint64 inode;
+	time_t mtime;
+
+	time_t start_time;
+	guint start_directory_count;
+	guint start_file_count;
+	guint start_unreadable_count;
+	goffset start_size;
+	guint start_hard_link_count;
+
+	GList *subdirectories; /* of DeepCountFrame, not started yet */
+} DeepCountFrame;
+
 struct DeepCountState {
 	NautilusDirectory *directory;
+	GFile *root;
 	GCancellable *cancellable;
 	GFileEnumerator *enumerator;
-	GFile *deep_count_location;
-	GList *deep_count_subdirectories;
-	GArray *seen_deep_count_inodes;
+	GList *deep_count_frames; /* innermost first, the first is being read */
+	GHashTable *seen_deep_count_inodes;
+	guint hard_link_count;
+	guint directories_read;
+	guint directories_reused;
 };
 
 
@@ -205,6 +312,7 @@ static void     move_file_to_extension_queue                  (NautilusDirectory
 							       NautilusFile           *file);
 static void     nautilus_directory_invalidate_file_attributes (NautilusDirectory      *directory,
 							       NautilusFileAttributes  file_attributes);
+static void     directory_count_cache_remove                  (NautilusFile           *file);
 
 void
 nautilus_set_kde_trash_name (const char *trash_dir)
@@ -243,13 +351,22 @@ istr_set_new (void)
 	return g_hash_table_new_full (istr_hash, istr_equal, g_free, NULL);
 }
 
-static void
+/* Most files share their MIME type with one seen before, so the
+ * string is only copied the first time. Returns TRUE if it was.
+ */
+static gboolean
 istr_set_insert (GHashTable *table, const char *istr)
 {
 	char *key;
 
+	if (g_hash_table_lookup (table, istr) != NULL) {
+		return FALSE;
+	}
+
 	key = g_strdup (istr);
-	g_hash_table_replace (table, key, key);
+	g_hash_table_insert (table, key, key);
+
+	return TRUE;
 }
 
 static void
@@ -303,6 +420,22 @@ request_counter_remove_request (RequestCounter counter,
 	}
 }
 
+/* A job that is running, until async_job_end () records its span */
+typedef struct {
+	const char *job;
+	gint64 start_time;
+	gint64 queue_wait;
+} TraceJobStart;
+
+static const char *
+trace_location (NautilusDirectory *directory)
+{
+	if (directory->details->trace_uri == NULL) {
+		directory->details->trace_uri = nautilus_directory_get_uri (directory);
+	}
+	return directory->details->trace_uri;
+}
+
 /* Start a job. This is really just a way of limiting the number of
  * async. requests that we issue at any given time. Without this, the
  * number of requests is unbounded.
@@ -311,6 +444,8 @@ static gboolean
 async_job_start (NautilusDirectory *directory,
 		 const char *job)
 {
+	TraceJobStart *job_start;
+	gint64 now;
 #ifdef DEBUG_ASYNC_JOBS
 	char *key;
 #endif
@@ -322,7 +457,13 @@ async_job_start (NautilusDirectory *directory,
 	g_assert (async_job_count >= 0);
 	g_assert (async_job_count <= MAX_ASYNC_JOBS);
 
+	now = nautilus_trace_get_time ();
+
 	if (async_job_count >= MAX_ASYNC_JOBS) {
+		if (directory->details->trace_wait_start == 0) {
+			directory->details->trace_wait_start = now;
+		}
+
 		if (waiting_directories == NULL) {
 			waiting_directories = eel_g_hash_table_new_free_at_exit
 				(NULL, NULL,
@@ -355,6 +496,18 @@ async_job_start (NautilusDirectory *directory,
 	}
 #endif	
 
+	/* The wait is put on whatever job gets the slot */
+	job_start = g_new (TraceJobStart, 1);
+	job_start->job = job;
+	job_start->start_time = now;
+	job_start->queue_wait = -1;
+	if (directory->details->trace_wait_start != 0) {
+		job_start->queue_wait = now - directory->details->trace_wait_start;
+		directory->details->trace_wait_start = 0;
+	}
+	directory->details->trace_job_starts =
+		g_list_append (directory->details->trace_job_starts, job_start);
+
 	async_job_count += 1;
 	return TRUE;
 }
@@ -364,6 +517,8 @@ static void
 async_job_end (NautilusDirectory *directory,
 	       const char *job)
 {
+	TraceJobStart *job_start;
+	GList *node;
 #ifdef DEBUG_ASYNC_JOBS
 	char *key;
 	gpointer table_key, value;
@@ -393,6 +548,19 @@ async_job_end (NautilusDirectory *directory,
 	}
 #endif
 
+	/* Jobs of the same kind are matched up oldest first */
+	for (node = directory->details->trace_job_starts; node != NULL; node = node->next) {
+		job_start = node->data;
+		if (strcmp (job_start->job, job) == 0) {
+			nautilus_trace_add_span (job_start->job, trace_location (directory),
+						 job_start->start_time, job_start->queue_wait);
+			directory->details->trace_job_starts =
+				g_list_delete_link (directory->details->trace_job_starts, node);
+			g_free (job_start);
+			break;
+		}
+	}
+
 	async_job_count -= 1;
 }
 
@@ -448,11 +616,156 @@ async_job_wake_up (void)
 	already_waking_up = FALSE;
 }
 
+/* Jobs run in threads hand their results to the main loop through
+ * queue_job_result(). Results are delivered in batches: all files are
+ * updated first, then each directory emits a single files_changed and
+ * reruns its state machine once.
+ */
+typedef void (* JobResultFunc) (gpointer result,
+				NautilusDirectory **directory,
+				NautilusFile **changed_file);
+
+typedef struct {
+	JobResultFunc func;
+	gpointer result;
+} JobResult;
+
+G_LOCK_DEFINE_STATIC (job_results);
+static GList *job_results;
+static guint deliver_job_results_timeout_id;
+
+static gboolean
+deliver_job_results_callback (gpointer callback_data)
+{
+	GList *results, *node, *directories, *self_owned_files;
+	GHashTable *changed_files;
+	JobResult *job_result;
+	NautilusDirectory *directory;
+	NautilusFile *file;
+	GList *files;
+
+	G_LOCK (job_results);
+	results = g_list_reverse (job_results);
+	job_results = NULL;
+	deliver_job_results_timeout_id = 0;
+	G_UNLOCK (job_results);
+
+	/* Update all the files before emitting anything, since the
+	 * signal handlers may cancel or start other jobs.
+	 */
+	directories = NULL;
+	self_owned_files = NULL;
+	changed_files = g_hash_table_new (NULL, NULL);
+	for (node = results; node != NULL; node = node->next) {
+		job_result = node->data;
+
+		job_result->func (job_result->result, &directory, &file);
+		g_free (job_result);
+
+		if (directory == NULL) {
+			/* Job was cancelled */
+			g_assert (file == NULL);
+			continue;
+		}
+
+		if (g_list_find (directories, directory) == NULL) {
+			directories = g_list_prepend (directories, directory);
+		} else {
+			nautilus_directory_unref (directory);
+		}
+
+		if (file == NULL) {
+			continue;
+		}
+		if (nautilus_file_is_self_owned (file)) {
+			self_owned_files = g_list_prepend (self_owned_files, file);
+		} else {
+			files = g_hash_table_lookup (changed_files, directory);
+			g_hash_table_insert (changed_files, directory,
+					     g_list_prepend (files, file));
+		}
+	}
+	g_list_free (results);
+
+	for (node = directories; node != NULL; node = node->next) {
+		directory = node->data;
+		files = g_list_reverse (g_hash_table_lookup (changed_files, directory));
+		nautilus_directory_emit_change_signals (directory, files);
+		nautilus_file_list_free (files);
+	}
+	g_hash_table_destroy (changed_files);
+
+	for (node = self_owned_files; node != NULL; node = node->next) {
+		nautilus_file_emit_changed (node->data);
+	}
+	nautilus_file_list_free (self_owned_files);
+
+	for (node = directories; node != NULL; node = node->next) {
+		nautilus_directory_async_state_changed (node->data);
+	}
+	nautilus_directory_list_free (directories);
+
+	return FALSE;
+}
+
+/* Can be called from any thread. func is called in the main loop, and
+ * returns references to the directory and file, if any, to update.
+ */
+static void
+queue_job_result (JobResultFunc func,
+		  gpointer result)
+{
+	JobResult *job_result;
+
+	job_result = g_new (JobResult, 1);
+	job_result->func = func;
+	job_result->result = result;
+
+	G_LOCK (job_results);
+	job_results = g_list_prepend (job_results, job_result);
+	if (deliver_job_results_timeout_id == 0) {
+		deliver_job_results_timeout_id =
+			g_timeout_add (JOB_RESULT_DELIVERY_INTERVAL,
+				       deliver_job_results_callback, NULL);
+	}
+	G_UNLOCK (job_results);
+}
+
+static DirectoryCountState *
+get_directory_count_state (NautilusDirectory *directory,
+			   NautilusFile *file)
+{
+	GList *node;
+	DirectoryCountState *state;
+
+	for (node = directory->details->count_in_progress; node != NULL; node = node->next) {
+		state = node->data;
+		if (state->count_file == file) {
+			return state;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+directory_count_cancel_state (NautilusDirectory *directory,
+			      DirectoryCountState *state)
+{
+	/* The job still finishes, and the state is freed when it is delivered */
+	g_cancellable_cancel (state->cancellable);
+	state->directory = NULL;
+	directory->details->count_in_progress =
+		g_list_remove (directory->details->count_in_progress, state);
+	async_job_end (directory, "directory count");
+}
+
 static void
 directory_count_cancel (NautilusDirectory *directory)
 {
-	if (directory->details->count_in_progress != NULL) {
-		g_cancellable_cancel (directory->details->count_in_progress->cancellable);
+	while (directory->details->count_in_progress != NULL) {
+		directory_count_cancel_state (directory,
+					      directory->details->count_in_progress->data);
 	}
 }
 
@@ -505,14 +818,41 @@ link_info_cancel (NautilusDirectory *directory)
 	}
 }
 
+static ThumbnailState *
+get_thumbnail_state (NautilusDirectory *directory,
+		     NautilusFile *file)
+{
+	GList *node;
+	ThumbnailState *state;
+
+	for (node = directory->details->thumbnail_states; node != NULL; node = node->next) {
+		state = node->data;
+		if (state->file == file) {
+			return state;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+thumbnail_cancel_state (NautilusDirectory *directory,
+			ThumbnailState *state)
+{
+	/* The job still finishes, and the state is freed when it is delivered */
+	g_cancellable_cancel (state->cancellable);
+	state->directory = NULL;
+	directory->details->thumbnail_states =
+		g_list_remove (directory->details->thumbnail_states, state);
+	async_job_end (directory, "thumbnail");
+}
+
 static void
 thumbnail_cancel (NautilusDirectory *directory)
 {
-	if (directory->details->thumbnail_state != NULL) {
-		g_cancellable_cancel (directory->details->thumbnail_state->cancellable);
-		directory->details->thumbnail_state->directory = NULL;
-		directory->details->thumbnail_state = NULL;
-		async_job_end (directory, "thumbnail");
+	while (directory->details->thumbnail_states != NULL) {
+		thumbnail_cancel_state (directory,
+					directory->details->thumbnail_states->data);
 	}
 }
 
@@ -527,16 +867,34 @@ mount_cancel (NautilusDirectory *directory)
 	}
 }
 
+/* The file was taken off the work queue while waiting for the info.
+ * Pass requeue if it should go back for its other attributes, rather
+ * than staying off because loading it was cancelled.
+ */
 static void
-file_info_cancel (NautilusDirectory *directory)
+file_info_cancel_state (NautilusDirectory *directory,
+			GetInfoState *state,
+			gboolean requeue)
 {
-	if (directory->details->get_info_in_progress != NULL) {
-		g_cancellable_cancel (directory->details->get_info_in_progress->cancellable);
-		directory->details->get_info_in_progress->directory = NULL;
-		directory->details->get_info_in_progress = NULL;
-		directory->details->get_info_file = NULL;
+	g_cancellable_cancel (state->cancellable);
+	state->directory = NULL;
+	directory->details->get_info_in_progress =
+		g_list_remove (directory->details->get_info_in_progress, state);
+
+	if (requeue && state->file != NULL && !state->file->details->is_gone) {
+		nautilus_directory_add_file_to_work_queue (directory, state->file);
+	}
+
+	async_job_end (directory, "file info");
+}
 
-		async_job_end (directory, "file info");
+static void
+file_info_cancel (NautilusDirectory *directory)
+{
+	while (directory->details->get_info_in_progress != NULL) {
+		file_info_cancel_state (directory,
+					directory->details->get_info_in_progress->data,
+					FALSE);
 	}
 }
 
@@ -802,8 +1160,8 @@ show_backup_files_changed_callback (gpointer callback_data)
 	show_backup_files = eel_preferences_get_boolean (NAUTILUS_PREFERENCES_SHOW_BACKUP_FILES);
 }
 
-static gboolean
-should_skip_file (NautilusDirectory *directory, GFileInfo *info)
+static void
+init_skip_file_preferences (void)
 {
 	static gboolean show_hidden_files_changed_callback_installed = FALSE;
 	static gboolean show_backup_files_changed_callback_installed = FALSE;
@@ -829,6 +1187,12 @@ should_skip_file (NautilusDirectory *directory, GFileInfo *info)
 		/* Peek for the first time */
 		show_backup_files_changed_callback (NULL);
 	}
+}
+
+static gboolean
+should_skip_file (NautilusDirectory *directory, GFileInfo *info)
+{
+	init_skip_file_preferences ();
 
 	if (!show_hidden_files &&
 	    (g_file_info_get_is_hidden (info) ||
@@ -849,13 +1213,15 @@ static gboolean
 dequeue_pending_idle_callback (gpointer callback_data)
 {
 	NautilusDirectory *directory;
-	GList *pending_file_info;
+	GPtrArray *pending_file_info;
 	GList *node, *next;
+	guint i, n_processed;
 	NautilusFile *file;
 	GList *changed_files, *added_files;
 	GFileInfo *file_info;
-	const char *mimetype, *name;
+	const char *name;
 	DirectoryLoadState *dir_load_state;
+	gint64 deadline;
 
 	directory = NAUTILUS_DIRECTORY (callback_data);
 
@@ -864,8 +1230,11 @@ dequeue_pending_idle_callback (gpointer callback_data)
 	directory->details->dequeue_pending_idle_id = 0;
 
 	/* Handle the files in the order we saw them. */
-	pending_file_info = g_list_reverse (directory->details->pending_file_info);
+	pending_file_info = directory->details->pending_file_info;
 	directory->details->pending_file_info = NULL;
+	if (pending_file_info == NULL) {
+		pending_file_info = g_ptr_array_new ();
+	}
 
 	/* If we are no longer monitoring, then throw away these. */
 	if (!nautilus_directory_is_file_list_monitored (directory)) {
@@ -877,32 +1246,21 @@ dequeue_pending_idle_callback (gpointer callback_data)
 	changed_files = NULL;
 
 	dir_load_state = directory->details->directory_load_in_progress;
+	deadline = eel_get_system_time () + DEQUEUE_PENDING_TIME_SLICE;
 	
-	/* Build a list of NautilusFile objects. */
-	for (node = pending_file_info; node != NULL; node = node->next) {
-		file_info = node->data;
+	/* Build a list of NautilusFile objects, for as long as the
+	 * time slice allows.
+	 */
+	for (i = 0; i < pending_file_info->len; i++) {
+		if (i > 0 && i % DEQUEUE_PENDING_CHECK_TIME_INTERVAL == 0 &&
+		    eel_get_system_time () > deadline) {
+			break;
+		}
+
+		file_info = g_ptr_array_index (pending_file_info, i);
 
 		name = g_file_info_get_name (file_info);
 		
-		/* Update the file count. */
-		/* FIXME bugzilla.gnome.org 45063: This could count a
-		 * file twice if we get it from both load_directory
-		 * and from new_files_callback. Not too hard to fix by
-		 * moving this into the actual callback instead of
-		 * waiting for the idle function.
-		 */
-		if (dir_load_state &&
-		    !should_skip_file (directory, file_info)) {
-			dir_load_state->load_file_count += 1;
-
-			/* Add the MIME type to the set. */
-			mimetype = g_file_info_get_content_type (file_info);
-			if (mimetype != NULL) {
-				istr_set_insert (dir_load_state->load_mime_list_hash,
-						 mimetype);
-			}
-		}
-		
 		/* check if the file already exists */
 		file = nautilus_directory_find_file_by_name (directory, name);
 		if (file != NULL) {
@@ -921,6 +1279,9 @@ dequeue_pending_idle_callback (gpointer callback_data)
 				/* File changed, notify about the change. */
 				nautilus_file_ref (file);
 				changed_files = g_list_prepend (changed_files, file);
+				if (dir_load_state) {
+					dir_load_state->load_updated_file_count += 1;
+				}
 			}
 		} else {
 			/* new file, create a nautilus file object and add it to the list */
@@ -928,13 +1289,43 @@ dequeue_pending_idle_callback (gpointer callback_data)
 			nautilus_directory_add_file (directory, file);			
 			file->details->is_added = TRUE;
 			added_files = g_list_prepend (added_files, file);
+			if (dir_load_state) {
+				dir_load_state->load_new_file_count += 1;
+				if (file->details->display_name == file->details->name) {
+					dir_load_state->load_shared_name_count += 1;
+				}
+			}
+		}
+	}
+
+	/* Keep what didn't fit in this slice for the next one, ahead
+	 * of anything that came in meanwhile.
+	 */
+	n_processed = i;
+	if (n_processed < pending_file_info->len) {
+		for (i = 0; i < n_processed; i++) {
+			g_object_unref (g_ptr_array_index (pending_file_info, i));
+		}
+		g_ptr_array_remove_range (pending_file_info, 0, n_processed);
+
+		if (directory->details->pending_file_info != NULL) {
+			for (i = 0; i < directory->details->pending_file_info->len; i++) {
+				g_ptr_array_add (pending_file_info,
+						 g_ptr_array_index (directory->details->pending_file_info, i));
+			}
+			g_ptr_array_free (directory->details->pending_file_info, TRUE);
 		}
+		directory->details->pending_file_info = pending_file_info;
+		pending_file_info = NULL;
+
+		nautilus_directory_schedule_dequeue_pending (directory);
 	}
 
 	/* If we are done loading, then we assume that any unconfirmed
          * files are gone.
 	 */
-	if (directory->details->directory_loaded) {
+	if (directory->details->directory_loaded &&
+	    directory->details->pending_file_info == NULL) {
 		for (node = directory->details->file_list;
 		     node != NULL; node = next) {
 			file = NAUTILUS_FILE (node->data);
@@ -956,33 +1347,21 @@ dequeue_pending_idle_callback (gpointer callback_data)
 	nautilus_file_list_free (added_files);
 
 	if (directory->details->directory_loaded &&
+	    directory->details->pending_file_info == NULL &&
 	    !directory->details->directory_loaded_sent_notification) {
 		/* Send the done_loading signal. */
 		nautilus_directory_emit_done_loading (directory);
 
-		if (dir_load_state) {
-			file = dir_load_state->load_directory_file;
-			
-			file->details->directory_count = dir_load_state->load_file_count;
-			file->details->directory_count_is_up_to_date = TRUE;
-			file->details->got_directory_count = TRUE;
-
-			file->details->got_mime_list = TRUE;
-			file->details->mime_list_is_up_to_date = TRUE;
-			eel_g_list_free_deep (file->details->mime_list);
-			file->details->mime_list = istr_set_get_as_list
-				(dir_load_state->load_mime_list_hash);
-
-			nautilus_file_changed (file);
-		}
-		
 		nautilus_directory_async_state_changed (directory);
 
 		directory->details->directory_loaded_sent_notification = TRUE;
 	}
 
  drain:
-	eel_g_object_list_free (pending_file_info);
+	if (pending_file_info != NULL) {
+		g_ptr_array_foreach (pending_file_info, (GFunc) g_object_unref, NULL);
+		g_ptr_array_free (pending_file_info, TRUE);
+	}
 
 	/* Get the state machine running again. */
 	nautilus_directory_async_state_changed (directory);
@@ -1000,10 +1379,25 @@ nautilus_directory_schedule_dequeue_pending (NautilusDirectory *directory)
 	}
 }
 
+void
+nautilus_directory_free_pending_file_info (NautilusDirectory *directory)
+{
+	if (directory->details->pending_file_info != NULL) {
+		g_ptr_array_foreach (directory->details->pending_file_info,
+				     (GFunc) g_object_unref, NULL);
+		g_ptr_array_free (directory->details->pending_file_info, TRUE);
+		directory->details->pending_file_info = NULL;
+	}
+}
+
+/* Takes over the reference to info */
 static void
 directory_load_one (NautilusDirectory *directory,
 		    GFileInfo *info)
 {
+	DirectoryLoadState *state;
+	const char *mimetype;
+
 	if (info == NULL) {
 		return;
 	}
@@ -1014,14 +1408,36 @@ directory_load_one (NautilusDirectory *directory,
 		uri = nautilus_directory_get_uri (directory);
 		g_warning ("Got GFileInfo with NULL name in %s, ignoring. This shouldn't happen unless the gvfs backend is broken.\n", uri);
 		g_free (uri);
+		g_object_unref (info);
 		
 		return;
 	}
+
+	/* Update the file count. */
+	/* FIXME bugzilla.gnome.org 45063: This could count a
+	 * file twice if we get it from both load_directory
+	 * and from new_files_callback.
+	 */
+	state = directory->details->directory_load_in_progress;
+	if (state != NULL &&
+	    !should_skip_file (directory, info)) {
+		state->load_file_count += 1;
+
+		/* Add the MIME type to the set. */
+		mimetype = g_file_info_get_content_type (info);
+		if (mimetype != NULL &&
+		    istr_set_insert (state->load_mime_list_hash,
+				     mimetype)) {
+			state->load_mime_type_copy_count += 1;
+		}
+	}
 	
 	/* Arrange for the "loading" part of the work. */
-	g_object_ref (info);
-	directory->details->pending_file_info
-		= g_list_prepend (directory->details->pending_file_info, info);
+	if (directory->details->pending_file_info == NULL) {
+		directory->details->pending_file_info =
+			g_ptr_array_sized_new (DIRECTORY_LOAD_ITEMS_PER_CALLBACK);
+	}
+	g_ptr_array_add (directory->details->pending_file_info, info);
 	nautilus_directory_schedule_dequeue_pending (directory);
 }
 
@@ -1062,16 +1478,72 @@ file_list_cancel (NautilusDirectory *directory)
 		directory->details->dequeue_pending_idle_id = 0;
 	}
 
-	if (directory->details->pending_file_info != NULL) {
-		eel_g_object_list_free  (directory->details->pending_file_info);
-		directory->details->pending_file_info = NULL;
-	}
+	nautilus_directory_free_pending_file_info (directory);
 
 	if (directory->details->hidden_file_hash) {
 		g_hash_table_foreach_remove (directory->details->hidden_file_hash, remove_callback, NULL);
 	}
 }
 
+static void
+log_directory_load_stats (NautilusDirectory *directory)
+{
+	DirectoryLoadState *state;
+	char *uri;
+
+	state = directory->details->directory_load_in_progress;
+	if (state == NULL ||
+	    !nautilus_debug_log_is_domain_enabled (NAUTILUS_DEBUG_LOG_DOMAIN_ASYNC)) {
+		return;
+	}
+
+	uri = nautilus_directory_get_uri (directory);
+	nautilus_debug_log (FALSE, NAUTILUS_DEBUG_LOG_DOMAIN_ASYNC,
+			    "loaded %s: %d file infos in %d batches, %d files created "
+			    "(%d sharing their name and display name), %d files updated, "
+			    "%d MIME type strings copied for %d files counted",
+			    uri,
+			    state->load_info_count,
+			    state->load_batch_count,
+			    state->load_new_file_count,
+			    state->load_shared_name_count,
+			    state->load_updated_file_count,
+			    state->load_mime_type_copy_count,
+			    state->load_file_count);
+	g_free (uri);
+}
+
+static void
+set_directory_count_from_load (NautilusDirectory *directory)
+{
+	DirectoryLoadState *state;
+	NautilusFile *file;
+	NautilusFileRareDetails *rare;
+
+	state = directory->details->directory_load_in_progress;
+	if (state == NULL) {
+		return;
+	}
+
+	/* All the infos have been counted by now, even if some are
+	 * still waiting to be turned into files.
+	 */
+	file = state->load_directory_file;
+			
+	file->details->directory_count = state->load_file_count;
+	file->details->directory_count_is_up_to_date = TRUE;
+	file->details->got_directory_count = TRUE;
+
+	file->details->got_mime_list = TRUE;
+	file->details->mime_list_is_up_to_date = TRUE;
+	rare = nautilus_file_ensure_rare_details (file);
+	eel_g_list_free_deep (rare->mime_list);
+	rare->mime_list = istr_set_get_as_list
+		(state->load_mime_list_hash);
+
+	nautilus_file_changed (file);
+}
+
 static void
 directory_load_done (NautilusDirectory *directory,
 		     GError *error)
@@ -1081,6 +1553,8 @@ directory_load_done (NautilusDirectory *directory,
 	directory->details->directory_loaded = TRUE;
 	directory->details->directory_loaded_sent_notification = FALSE;
 
+	set_directory_count_from_load (directory);
+
 	if (error != NULL) {
 		/* The load did not complete successfully. This means
 		 * we don't know the status of the files in this directory.
@@ -1102,6 +1576,8 @@ directory_load_done (NautilusDirectory *directory,
 	}
 	dequeue_pending_idle_callback (directory);
 
+	log_directory_load_stats (directory);
+
 	directory_load_cancel (directory);
 }
 
@@ -1451,10 +1927,7 @@ new_files_callback (GObject *source_object,
 	
 	/* Queue up the new file. */
 	info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
-	if (info != NULL) {
-		directory_load_one (directory, info);
-		g_object_unref (info);
-	}
+	directory_load_one (directory, info);
 
 	new_files_state_unref (state);
 
@@ -1504,6 +1977,9 @@ nautilus_async_destroying_file (NautilusFile *file)
 	GList *node, *next;
 	ReadyCallback *callback;
 	Monitor *monitor;
+	ThumbnailState *state;
+	GetInfoState *get_info_state;
+	DirectoryCountState *count_state;
 
 	directory = file->details->directory;
 	changed = FALSE;
@@ -1539,10 +2015,12 @@ nautilus_async_destroying_file (NautilusFile *file)
 	/* Check if it's a file that's currently being worked on.
 	 * If so, make that NULL so it gets canceled right away.
 	 */
-	if (directory->details->count_in_progress != NULL &&
-	    directory->details->count_in_progress->count_file == file) {
-		directory->details->count_in_progress->count_file = NULL;
-		changed = TRUE;
+	for (node = directory->details->count_in_progress; node != NULL; node = node->next) {
+		count_state = node->data;
+		if (count_state->count_file == file) {
+			count_state->count_file = NULL;
+			changed = TRUE;
+		}
 	}
 	if (directory->details->deep_count_file == file) {
 		directory->details->deep_count_file = NULL;
@@ -1553,9 +2031,12 @@ nautilus_async_destroying_file (NautilusFile *file)
 		directory->details->mime_list_in_progress->mime_list_file = NULL;
 		changed = TRUE;
 	}
-	if (directory->details->get_info_file == file) {
-		directory->details->get_info_file = NULL;
-		changed = TRUE;
+	for (node = directory->details->get_info_in_progress; node != NULL; node = node->next) {
+		get_info_state = node->data;
+		if (get_info_state->file == file) {
+			get_info_state->file = NULL;
+			changed = TRUE;
+		}
 	}
 	if (directory->details->top_left_read_state != NULL
 	    && directory->details->top_left_read_state->file == file) {
@@ -1567,15 +2048,18 @@ nautilus_async_destroying_file (NautilusFile *file)
 		directory->details->link_info_read_state->file = NULL;
 		changed = TRUE;
 	}
-	if (directory->details->extension_info_file == file) {
-		directory->details->extension_info_file = NULL;
+	if (g_list_find (directory->details->extension_info_files, file) != NULL) {
+		directory->details->extension_info_files =
+			g_list_remove (directory->details->extension_info_files, file);
 		changed = TRUE;
 	}
 
-	if (directory->details->thumbnail_state != NULL &&
-	    directory->details->thumbnail_state->file ==  file) {
-		directory->details->thumbnail_state->file = NULL;
-		changed = TRUE;
+	for (node = directory->details->thumbnail_states; node != NULL; node = node->next) {
+		state = node->data;
+		if (state->file == file) {
+			state->file = NULL;
+			changed = TRUE;
+		}
 	}
 	
 	if (directory->details->mount_state != NULL &&
@@ -1702,7 +2186,7 @@ lacks_mount (NautilusFile *file)
 		 
 		 /* Mountable with a target_uri, could be a mountpoint */
 		 (file->details->type == G_FILE_TYPE_MOUNTABLE &&
-		  file->details->activation_uri != NULL)
+		  NAUTILUS_FILE_RARE_DETAIL (file, activation_uri) != NULL)
 
 		 )
 		);
@@ -2066,10 +2550,13 @@ more_files_callback (GObject *source_object,
 	files = g_file_enumerator_next_files_finish (state->enumerator,
 						     res, &error);
 
+	if (files != NULL) {
+		state->load_batch_count += 1;
+	}
 	for (l = files; l != NULL; l = l->next) {
 		info = l->data;
+		state->load_info_count += 1;
 		directory_load_one (directory, info);
-		g_object_unref (info);
 	}
 
 	if (nautilus_directory_file_list_length_reached (directory) ||
@@ -2231,6 +2718,7 @@ nautilus_file_invalidate_count_and_mime_list (NautilusFile *file)
 	attributes = NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT |
 		NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_MIME_TYPES;
 	
+	directory_count_cache_remove (file);
 	nautilus_file_invalidate_attributes (file, attributes);
 }
 
@@ -2360,44 +2848,30 @@ static void
 directory_count_stop (NautilusDirectory *directory)
 {
 	NautilusFile *file;
+	DirectoryCountState *state;
+	GList *node, *next;
 
-	if (directory->details->count_in_progress != NULL) {
-		file = directory->details->count_in_progress->count_file;
+	for (node = directory->details->count_in_progress; node != NULL; node = next) {
+		next = node->next;
+		state = node->data;
+		file = state->count_file;
 		if (file != NULL) {
 			g_assert (NAUTILUS_IS_FILE (file));
 			g_assert (file->details->directory == directory);
 			if (is_needy (file,
 				      should_get_directory_count_now,
 				      REQUEST_DIRECTORY_COUNT)) {
-				return;
+				continue;
 			}
 		}
 
 		/* The count is not wanted, so stop it. */
-		directory_count_cancel (directory);
+		directory_count_cancel_state (directory, state);
 	}
 }
 
-static guint
-count_non_skipped_files (GList *list)
-{
-	guint count;
-	GList *node;
-	GFileInfo *info;
-
-	count = 0;
-	for (node = list; node != NULL; node = node->next) {
-		info = node->data;
-		if (!should_skip_file (NULL, info)) {
-			count += 1;
-		}
-	}
-	return count;
-}
-
 static void
-count_children_done (NautilusDirectory *directory,
-		     NautilusFile *count_file,
+count_children_done (NautilusFile *count_file,
 		     gboolean succeeded,
 		     int count)
 {
@@ -2415,144 +2889,280 @@ count_children_done (NautilusDirectory *directory,
 		count_file->details->got_directory_count = TRUE;
 		count_file->details->directory_count = count;
 	}
-	directory->details->count_in_progress = NULL;
-
-	/* Send file-changed even if count failed, so interested parties can
-	 * distinguish between unknowable and not-yet-known cases.
-	 */
-	nautilus_file_changed (count_file);
-
-	/* Start up the next one. */
-	async_job_end (directory, "directory count");
-	nautilus_directory_async_state_changed (directory);
-}
+}
 
 static void
 directory_count_state_free (DirectoryCountState *state)
 {
-	if (state->enumerator) {
-		if (!g_file_enumerator_is_closed (state->enumerator)) {
-			g_file_enumerator_close_async (state->enumerator,
-						       0, NULL, NULL, NULL);
-		}
-		g_object_unref (state->enumerator);
-	}
 	g_object_unref (state->cancellable);
-	nautilus_directory_unref (state->directory);
+	g_object_unref (state->location);
 	g_free (state);
 }
 
-static void
-count_more_files_callback (GObject *source_object,
-			   GAsyncResult *res,
-			   gpointer user_data)
+/* Counts of all the children of a directory, by whether they
+ * are hidden and whether they are backup files, so the visible
+ * count can be worked out for any preference settings.
+ */
+typedef struct {
+	time_t mtime;
+	guint counts[2][2];
+} DirectoryCountCacheEntry;
+
+static GHashTable *directory_count_cache;
+
+static guint
+count_visible_children (guint counts[2][2])
 {
-	DirectoryCountState *state;
-	NautilusDirectory *directory;
-	GError *error;
-	GList *files;
+	guint count;
 
-	state = user_data;
-	directory = state->directory;
-	
-	if (g_cancellable_is_cancelled (state->cancellable)) {
-		/* Operation was cancelled. Bail out */
-		directory->details->count_in_progress = NULL;
+	/* Make sure the preferences are being tracked */
+	init_skip_file_preferences ();
 
-		async_job_end (directory, "directory count");
-		nautilus_directory_async_state_changed (directory);
-		
-		directory_count_state_free (state);
+	count = counts[FALSE][FALSE];
+	if (show_hidden_files) {
+		count += counts[TRUE][FALSE];
+	}
+	if (show_backup_files) {
+		count += counts[FALSE][TRUE];
+	}
+	if (show_hidden_files && show_backup_files) {
+		count += counts[TRUE][TRUE];
+	}
 
-		return;
+	return count;
+}
+
+/* The mtime of the file may be out of date, so an entry found here
+ * is only used once the count job has checked it against the mtime
+ * of the directory itself.
+ */
+static DirectoryCountCacheEntry *
+directory_count_cache_lookup (NautilusFile *file)
+{
+	DirectoryCountCacheEntry *entry;
+	char *uri;
+
+	if (directory_count_cache == NULL) {
+		return NULL;
 	}
 
-	g_assert (directory->details->count_in_progress != NULL);
-	g_assert (directory->details->count_in_progress == state);
+	uri = nautilus_file_get_uri (file);
+	entry = g_hash_table_lookup (directory_count_cache, uri);
+	g_free (uri);
 
-	error = NULL;
-	files = g_file_enumerator_next_files_finish (state->enumerator,
-						     res, &error);
+	return entry;
+}
 
-	state->file_count += count_non_skipped_files (files);
-	
-	if (files == NULL) {
-		count_children_done (directory, state->count_file,
-				     TRUE, state->file_count);
-		directory_count_state_free (state);
-	} else {
-		g_file_enumerator_next_files_async (state->enumerator,
-						    DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-						    G_PRIORITY_DEFAULT,
-						    state->cancellable,
-						    count_more_files_callback,
-						    state);
+static void
+directory_count_cache_remove (NautilusFile *file)
+{
+	char *uri;
+
+	if (directory_count_cache == NULL) {
+		return;
 	}
 
-	eel_g_object_list_free (files);
+	uri = nautilus_file_get_uri (file);
+	g_hash_table_remove (directory_count_cache, uri);
+	g_free (uri);
+}
 
-	if (error) {
-		g_error_free (error);
+static void
+directory_count_cache_add (NautilusFile *file,
+			   time_t mtime,
+			   guint counts[2][2])
+{
+	DirectoryCountCacheEntry *entry;
+
+	/* A directory changed in the same second as its mtime
+	 * could still be counted wrong, so leave those out. */
+	if (mtime == 0 || mtime >= time (NULL) - 1) {
+		return;
 	}
+
+	if (directory_count_cache == NULL) {
+		directory_count_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+							       g_free, g_free);
+	} else if (g_hash_table_size (directory_count_cache) >= DIRECTORY_COUNT_CACHE_SIZE) {
+		/* Simplest eviction there is, it's just a cache */
+		g_hash_table_remove_all (directory_count_cache);
+	}
+
+	entry = g_new (DirectoryCountCacheEntry, 1);
+	entry->mtime = mtime;
+	memcpy (entry->counts, counts, sizeof (entry->counts));
+	g_hash_table_replace (directory_count_cache, nautilus_file_get_uri (file), entry);
 }
 
 static void
-count_children_callback (GObject *source_object,
-			 GAsyncResult *res,
-			 gpointer user_data)
+directory_count_job_result (gpointer result,
+			    NautilusDirectory **directory,
+			    NautilusFile **changed_file)
 {
 	DirectoryCountState *state;
-	GFileEnumerator *enumerator;
-	NautilusDirectory *directory;
-	GError *error;
 
-	state = user_data;
+	state = result;
 
-	if (g_cancellable_is_cancelled (state->cancellable)) {
-		/* Operation was cancelled. Bail out */
-		directory = state->directory;
-		directory->details->count_in_progress = NULL;
+	*directory = NULL;
+	*changed_file = NULL;
 
-		async_job_end (directory, "directory count");
-		nautilus_directory_async_state_changed (directory);
-		
-		directory_count_state_free (state);
+	if (state->directory != NULL) {
+		state->directory->details->count_in_progress =
+			g_list_remove (state->directory->details->count_in_progress, state);
+		async_job_end (state->directory, "directory count");
 
-		return;
+		*directory = nautilus_directory_ref (state->directory);
+		if (state->count_file != NULL) {
+			if (state->succeeded && !state->from_cache) {
+				directory_count_cache_add (state->count_file, state->mtime, state->counts);
+			}
+			count_children_done (state->count_file,
+					     state->succeeded,
+					     count_visible_children (state->counts));
+
+			/* Send file-changed even if count failed, so interested parties can
+			 * distinguish between unknowable and not-yet-known cases.
+			 */
+			*changed_file = nautilus_file_ref (state->count_file);
+		}
 	}
-	
-	error = NULL;
-	enumerator = g_file_enumerate_children_finish  (G_FILE (source_object),
-							res, &error);
 
+	directory_count_state_free (state);
+}
+
+static inline gboolean
+is_hidden_file_name (const char *name)
+{
+	return name[0] == '.';
+}
+
+static inline gboolean
+is_backup_file_name (const char *name)
+{
+	return name[0] != '\0' && name[strlen (name) - 1] == '~';
+}
+
+/* Only the names are needed to tell what is hidden or a backup file,
+ * so local directories are counted by reading them without any stat.
+ */
+static gboolean
+count_children_local (const char *path,
+		      guint counts[2][2],
+		      GCancellable *cancellable)
+{
+	DIR *dir;
+	struct dirent *dirent;
+	const char *name;
+	guint n;
+
+	dir = opendir (path);
+	if (dir == NULL) {
+		return FALSE;
+	}
+
+	n = 0;
+	while ((dirent = readdir (dir)) != NULL) {
+		name = dirent->d_name;
+		if (strcmp (name, ".") == 0 || strcmp (name, "..") == 0) {
+			continue;
+		}
+
+		counts[is_hidden_file_name (name)][is_backup_file_name (name)]++;
+
+		if (++n % DIRECTORY_LOAD_ITEMS_PER_CALLBACK == 0 &&
+		    g_cancellable_is_cancelled (cancellable)) {
+			break;
+		}
+	}
+	closedir (dir);
+
+	return TRUE;
+}
+
+static gboolean
+count_children_enumerate (GFile *location,
+			  guint counts[2][2],
+			  GCancellable *cancellable)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+
+	enumerator = g_file_enumerate_children (location,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
+						G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						cancellable, NULL);
 	if (enumerator == NULL) {
-		count_children_done (state->directory,
-				     state->count_file,
-				     FALSE, 0);
-		g_error_free (error);
-		directory_count_state_free (state);
-		return;
+		return FALSE;
+	}
+
+	while ((info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL) {
+		counts[g_file_info_get_is_hidden (info) != FALSE]
+			[g_file_info_get_is_backup (info) != FALSE]++;
+		g_object_unref (info);
+	}
+
+	g_file_enumerator_close (enumerator, NULL, NULL);
+	g_object_unref (enumerator);
+
+	return TRUE;
+}
+
+static gboolean
+count_children_job (GIOSchedulerJob *job,
+		    GCancellable *cancellable,
+		    gpointer user_data)
+{
+	DirectoryCountState *state;
+	GFileInfo *info;
+	char *path;
+
+	state = user_data;
+
+	/* Taken before counting, so a change made while counting
+	 * leaves a cache entry that won't match next time.
+	 */
+	info = g_file_query_info (state->location,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+				  0, cancellable, NULL);
+	if (info != NULL) {
+		state->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+		g_object_unref (info);
+	}
+
+	if (state->mtime != 0 && state->mtime == state->cached_mtime) {
+		state->from_cache = TRUE;
+		state->succeeded = TRUE;
+		memcpy (state->counts, state->cached_counts, sizeof (state->counts));
 	} else {
-		state->enumerator = enumerator;
-		g_file_enumerator_next_files_async (state->enumerator,
-						    DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-						    G_PRIORITY_DEFAULT,
-						    state->cancellable,
-						    count_more_files_callback,
-						    state);
+		path = g_file_get_path (state->location);
+		if (path != NULL) {
+			state->succeeded = count_children_local (path, state->counts, cancellable);
+			g_free (path);
+		} else {
+			state->succeeded = count_children_enumerate (state->location, state->counts, cancellable);
+		}
 	}
+
+	queue_job_result (directory_count_job_result, state);
+
+	return FALSE;
 }
 
+/* Several directories are counted at once. Files being counted
+ * don't hold up the work queue, the results are delivered in
+ * batches by queue_job_result().
+ */
 static void
 directory_count_start (NautilusDirectory *directory,
 		       NautilusFile *file,
 		       gboolean *doing_io)
 {
 	DirectoryCountState *state;
-	GFile *location;
+	DirectoryCountCacheEntry *entry;
 
-	if (directory->details->count_in_progress != NULL) {
-		*doing_io = TRUE;
+	if (get_directory_count_state (directory, file) != NULL) {
 		return;
 	}
 
@@ -2561,9 +3171,10 @@ directory_count_start (NautilusDirectory *directory,
 		       REQUEST_DIRECTORY_COUNT)) {
 		return;
 	}
-	*doing_io = TRUE;
 
 	if (!nautilus_file_is_directory (file)) {
+		*doing_io = TRUE;
+
 		file->details->directory_count_is_up_to_date = TRUE;
 		file->details->directory_count_failed = FALSE;
 		file->details->got_directory_count = FALSE;
@@ -2572,71 +3183,285 @@ directory_count_start (NautilusDirectory *directory,
 		return;
 	}
 
-	if (!async_job_start (directory, "directory count")) {
-		return;
-	}
-
-	/* Start counting. */
 	state = g_new0 (DirectoryCountState, 1);
 	state->count_file = file;
-	state->directory = nautilus_directory_ref (directory);
+	state->directory = directory;
 	state->cancellable = g_cancellable_new ();
-	
-	directory->details->count_in_progress = state;
-	
-	location = nautilus_file_get_location (file);
+	state->location = nautilus_file_get_location (file);
+
+	entry = directory_count_cache_lookup (file);
+	if (entry != NULL) {
+		state->cached_mtime = entry->mtime;
+		memcpy (state->cached_counts, entry->counts, sizeof (state->cached_counts));
+	}
+
+	if (g_list_length (directory->details->count_in_progress) >= MAX_DIRECTORY_COUNTS_PER_DIRECTORY ||
+	    !async_job_start (directory, "directory count")) {
+		*doing_io = TRUE;
+		directory_count_state_free (state);
+		return;
+	}
+
+	directory->details->count_in_progress =
+		g_list_prepend (directory->details->count_in_progress, state);
+
 #ifdef DEBUG_LOAD_DIRECTORY		
 	{
 		char *uri;
-		uri = g_file_get_uri (location);
+		uri = g_file_get_uri (state->location);
 		g_message ("load_directory called to get shallow file count for %s", uri);
 		g_free (uri);
 	}
 #endif
 
-	g_file_enumerate_children_async (location,
-					 G_FILE_ATTRIBUTE_STANDARD_NAME ","
-					 G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
-					 G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP,
-					 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, /* flags */
-					 G_PRIORITY_DEFAULT, /* prio */
-					 state->cancellable,
-					 count_children_callback,
-					 state);
-	g_object_unref (location);
+	g_io_scheduler_push_job (count_children_job,
+				 state,
+				 NULL,
+				 G_PRIORITY_DEFAULT,
+				 state->cancellable);
 }
 
-static inline gboolean
+/* The deep counts of a directory subtree, see DeepCountFrame */
+typedef struct {
+	guint32 device;
+	guint64 inode;
+	time_t mtime;
+	time_t time_added;
+	guint directory_count;
+	guint file_count;
+	goffset size;
+} DeepCountCacheEntry;
+
+/* Keys are URIs. An entry with mtime 0 marks a directory in which
+ * something changed at time_added, so counts started before that
+ * are not added. Marks are only needed below the roots of counts
+ * that are still running.
+ */
+static GHashTable *deep_count_cache;
+static GList *running_deep_count_roots; /* of GFile */
+
+static gboolean
+is_being_deep_counted (GFile *location)
+{
+	GList *l;
+
+	for (l = running_deep_count_roots; l != NULL; l = l->next) {
+		if (g_file_equal (location, l->data) ||
+		    g_file_has_prefix (location, l->data)) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static gboolean
+deep_count_cache_entry_is_evictable (gpointer key,
+				     gpointer value,
+				     gpointer callback_data)
+{
+	DeepCountCacheEntry *entry;
+
+	entry = value;
+	return entry->mtime != 0 || running_deep_count_roots == NULL;
+}
+
+static DeepCountCacheEntry *
+deep_count_cache_lookup (DeepCountFrame *frame)
+{
+	DeepCountCacheEntry *entry;
+	char *uri;
+
+	if (deep_count_cache == NULL || frame->mtime == 0) {
+		return NULL;
+	}
+
+	uri = g_file_get_uri (frame->location);
+	entry = g_hash_table_lookup (deep_count_cache, uri);
+	g_free (uri);
+
+	/* The device and inode aren't known for the directory a
+	 * count starts at, only for the ones found while counting.
+	 */
+	if (entry == NULL ||
+	    entry->mtime != frame->mtime ||
+	    (frame->inode != 0 && entry->inode != 0 &&
+	     (entry->device != frame->device || entry->inode != frame->inode)) ||
+	    entry->time_added < time (NULL) - DEEP_COUNT_CACHE_MAX_AGE) {
+		return NULL;
+	}
+	return entry;
+}
+
+static void
+deep_count_cache_add (DeepCountFrame *frame,
+		      NautilusFile *file)
+{
+	DeepCountCacheEntry *entry;
+	NautilusFileRareDetails *rare;
+	char *uri;
+
+	/* Same as for directory_count_cache_add () */
+	if (frame->mtime == 0 || frame->mtime >= time (NULL) - 1) {
+		return;
+	}
+
+	uri = g_file_get_uri (frame->location);
+
+	if (deep_count_cache == NULL) {
+		deep_count_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+							  g_free, g_free);
+	} else {
+		entry = g_hash_table_lookup (deep_count_cache, uri);
+		if (entry != NULL && entry->mtime == 0 &&
+		    entry->time_added >= frame->start_time) {
+			/* Something changed below it while counting */
+			g_free (uri);
+			return;
+		}
+		if (g_hash_table_size (deep_count_cache) >= DEEP_COUNT_CACHE_SIZE) {
+			/* Keep the marks that running counts rely on */
+			g_hash_table_foreach_remove (deep_count_cache,
+						     deep_count_cache_entry_is_evictable,
+						     NULL);
+		}
+	}
+
+	rare = file->details->rare;
+
+	entry = g_new (DeepCountCacheEntry, 1);
+	entry->device = frame->device;
+	entry->inode = frame->inode;
+	entry->mtime = frame->mtime;
+	entry->time_added = time (NULL);
+	entry->directory_count = rare->deep_directory_count - frame->start_directory_count;
+	entry->file_count = rare->deep_file_count - frame->start_file_count;
+	entry->size = rare->deep_size - frame->start_size;
+	g_hash_table_replace (deep_count_cache, uri, entry);
+}
+
+/* Called when something in or below location changed. The entries
+ * of all the directories above it, up to the root, are replaced by
+ * change marks where a count is running, and dropped elsewhere. An
+ * uncached directory doesn't end the walk, since its ancestors may
+ * still have been cached by an earlier count.
+ */
+void
+nautilus_directory_invalidate_deep_count_cache (GFile *location)
+{
+	DeepCountCacheEntry *entry;
+	GFile *parent, *next;
+	char *uri;
+
+	if (running_deep_count_roots == NULL &&
+	    (deep_count_cache == NULL || g_hash_table_size (deep_count_cache) == 0)) {
+		return;
+	}
+
+	if (deep_count_cache == NULL) {
+		deep_count_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+							  g_free, g_free);
+	}
+
+	parent = g_file_get_parent (location);
+	while (parent != NULL) {
+		uri = g_file_get_uri (parent);
+
+		if (is_being_deep_counted (parent)) {
+			entry = g_new0 (DeepCountCacheEntry, 1);
+			entry->time_added = time (NULL);
+			g_hash_table_replace (deep_count_cache, uri, entry);
+		} else {
+			g_hash_table_remove (deep_count_cache, uri);
+			g_free (uri);
+		}
+
+		next = g_file_get_parent (parent);
+		g_object_unref (parent);
+		parent = next;
+	}
+}
+
+static guint
+seen_inode_hash (gconstpointer key)
+{
+	const guint64 *device_and_inode = key;
+
+	return (guint) (device_and_inode[0] ^ device_and_inode[1] ^ (device_and_inode[1] >> 32));
+}
+
+static gboolean
+seen_inode_equal (gconstpointer a, gconstpointer b)
+{
+	return memcmp (a, b, 2 * sizeof (guint64)) == 0;
+}
+
+/* Returns TRUE if the file is another link to an inode already
+ * counted. Only files with more than one link are remembered.
+ */
+static gboolean
 seen_inode (DeepCountState *state,
 	    GFileInfo *info)
 {
-	guint64 inode, inode2;
-	guint i;
+	guint64 *device_and_inode;
+	guint64 inode;
 
 	inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+	if (inode == 0) {
+		return FALSE;
+	}
 
-	if (inode != 0) {
-		for (i = 0; i < state->seen_deep_count_inodes->len; i++) {
-			inode2 = g_array_index (state->seen_deep_count_inodes, guint64, i);
-			if (inode == inode2) {
-				return TRUE;
-			}
-		}
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_NLINK) &&
+	    g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) < 2) {
+		return FALSE;
+	}
+
+	/* Subtrees with hard links are not cached, since their sizes
+	 * depend on what else was counted.
+	 */
+	state->hard_link_count += 1;
+
+	device_and_inode = g_new (guint64, 2);
+	device_and_inode[0] = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+	device_and_inode[1] = inode;
+
+	if (g_hash_table_lookup (state->seen_deep_count_inodes, device_and_inode) != NULL) {
+		g_free (device_and_inode);
+		return TRUE;
 	}
 
+	g_hash_table_insert (state->seen_deep_count_inodes,
+			     device_and_inode, device_and_inode);
 	return FALSE;
 }
 
-static inline void
-mark_inode_as_seen (DeepCountState *state,
-		    GFileInfo *info)
+static DeepCountFrame *
+deep_count_frame_new (GFile *location,
+		      GFileInfo *info)
 {
-	guint64 inode;
+	DeepCountFrame *frame;
 
-	inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
-	if (inode != 0) {
-		g_array_append_val (state->seen_deep_count_inodes, inode);
+	frame = g_slice_new0 (DeepCountFrame);
+	frame->location = location;
+	if (info != NULL) {
+		frame->device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+		frame->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+		frame->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	}
+
+	return frame;
+}
+
+static void
+deep_count_frame_free (DeepCountFrame *frame)
+{
+	GList *l;
+
+	g_object_unref (frame->location);
+	for (l = frame->subdirectories; l != NULL; l = l->next) {
+		deep_count_frame_free (l->data);
 	}
+	g_list_free (frame->subdirectories);
+	g_slice_free (DeepCountFrame, frame);
 }
 
 static void
@@ -2644,43 +3469,43 @@ deep_count_one (DeepCountState *state,
 		GFileInfo *info)
 {
 	NautilusFile *file;
-	GFile *subdir;
+	DeepCountFrame *frame, *subdir;
 	gboolean is_seen_inode;
 
 	if (should_skip_file (NULL, info)) {
 		return;
 	}
 
-	is_seen_inode = seen_inode (state, info);
-	if (!is_seen_inode) {
-		mark_inode_as_seen (state, info);
-	}
-
 	file = state->directory->details->deep_count_file;
+	frame = state->deep_count_frames->data;
 
 	if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
 		/* Count the directory. */
-		file->details->deep_directory_count += 1;
+		file->details->rare->deep_directory_count += 1;
 
 		/* Record the fact that we have to descend into this directory. */
-
-		subdir = g_file_get_child (state->deep_count_location, g_file_info_get_name (info));
-		state->deep_count_subdirectories = g_list_prepend
-			(state->deep_count_subdirectories, subdir);
+		subdir = deep_count_frame_new (g_file_get_child (frame->location,
+								 g_file_info_get_name (info)),
+					       info);
+		frame->subdirectories = g_list_prepend (frame->subdirectories, subdir);
+		is_seen_inode = FALSE;
 	} else {
 		/* Even non-regular files count as files. */
-		file->details->deep_file_count += 1;
+		file->details->rare->deep_file_count += 1;
+		is_seen_inode = seen_inode (state, info);
 	}
 
 	/* Count the size. */
 	if (!is_seen_inode && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE)) {
-		file->details->deep_size += g_file_info_get_size (info);
+		file->details->rare->deep_size += g_file_info_get_size (info);
 	}
 }
 
 static void
 deep_count_state_free (DeepCountState *state)
 {
+	GList *l;
+
 	if (state->enumerator) {
 		if (!g_file_enumerator_is_closed (state->enumerator)) {
 			g_file_enumerator_close_async (state->enumerator,
@@ -2689,43 +3514,119 @@ deep_count_state_free (DeepCountState *state)
 		g_object_unref (state->enumerator);
 	}
 	g_object_unref (state->cancellable);
-	if (state->deep_count_location) {
-		g_object_unref (state->deep_count_location);
+	running_deep_count_roots = g_list_remove (running_deep_count_roots, state->root);
+	g_object_unref (state->root);
+	for (l = state->deep_count_frames; l != NULL; l = l->next) {
+		deep_count_frame_free (l->data);
 	}
-	eel_g_object_list_free (state->deep_count_subdirectories);
-	g_array_free (state->seen_deep_count_inodes, TRUE);
+	g_list_free (state->deep_count_frames);
+	g_hash_table_destroy (state->seen_deep_count_inodes);
 	g_free (state);
 }
 
+static void
+deep_count_push (DeepCountState *state,
+		 DeepCountFrame *frame)
+{
+	NautilusFileRareDetails *rare;
+
+	rare = state->directory->details->deep_count_file->details->rare;
+
+	frame->start_time = time (NULL);
+	frame->start_directory_count = rare->deep_directory_count;
+	frame->start_file_count = rare->deep_file_count;
+	frame->start_unreadable_count = rare->deep_unreadable_count;
+	frame->start_size = rare->deep_size;
+	frame->start_hard_link_count = state->hard_link_count;
+
+	state->deep_count_frames = g_list_prepend (state->deep_count_frames, frame);
+	state->directories_read += 1;
+	deep_count_load (state, frame->location);
+}
+
+/* Adds the cached counts of the subtree, if there are any */
+static gboolean
+deep_count_reuse (DeepCountState *state,
+		  DeepCountFrame *frame)
+{
+	DeepCountCacheEntry *entry;
+	NautilusFileRareDetails *rare;
+
+	entry = deep_count_cache_lookup (frame);
+	if (entry == NULL) {
+		return FALSE;
+	}
+
+	rare = state->directory->details->deep_count_file->details->rare;
+	rare->deep_directory_count += entry->directory_count;
+	rare->deep_file_count += entry->file_count;
+	rare->deep_size += entry->size;
+	state->directories_reused += 1;
+
+	return TRUE;
+}
+
+/* Called when the innermost directory has been read. Moves on to the
+ * next one that isn't cached, adding up the finished subtrees on the
+ * way.
+ */
 static void
 deep_count_next_dir (DeepCountState *state)
 {
-	GFile *location;
+	DeepCountFrame *frame, *subdir;
 	NautilusFile *file;
 	NautilusDirectory *directory;
 	gboolean done;
+	char *uri;
 
 	directory = state->directory;
-	
-	g_object_unref (state->deep_count_location);
-	state->deep_count_location = NULL;
+	file = directory->details->deep_count_file;
 
 	done = FALSE;
-	file = directory->details->deep_count_file;
-	
-	if (state->deep_count_subdirectories != NULL) {
+	while (TRUE) {
+		frame = state->deep_count_frames->data;
+
 		/* Work on a new directory. */
-		location = state->deep_count_subdirectories->data;
-		state->deep_count_subdirectories = g_list_remove
-			(state->deep_count_subdirectories, location);
-		deep_count_load (state, location);
-		g_object_unref (location);
-	} else {
-		file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
-		directory->details->deep_count_file = NULL;
-		directory->details->deep_count_in_progress = NULL;
-		deep_count_state_free (state);
-		done = TRUE;
+		subdir = NULL;
+		while (frame->subdirectories != NULL) {
+			subdir = frame->subdirectories->data;
+			frame->subdirectories = g_list_delete_link (frame->subdirectories,
+								    frame->subdirectories);
+			if (!deep_count_reuse (state, subdir)) {
+				break;
+			}
+			deep_count_frame_free (subdir);
+			subdir = NULL;
+		}
+		if (subdir != NULL) {
+			deep_count_push (state, subdir);
+			break;
+		}
+
+		/* The whole subtree is counted. Unreadable directories
+		 * could become readable without any change notification.
+		 */
+		if (state->hard_link_count == frame->start_hard_link_count &&
+		    file->details->rare->deep_unreadable_count == frame->start_unreadable_count) {
+			deep_count_cache_add (frame, file);
+		}
+		state->deep_count_frames = g_list_remove (state->deep_count_frames, frame);
+		deep_count_frame_free (frame);
+
+		if (state->deep_count_frames == NULL) {
+			uri = nautilus_file_get_uri (file);
+			nautilus_debug_log (FALSE, NAUTILUS_DEBUG_LOG_DOMAIN_ASYNC,
+					    "deep count of %s: %u directories read, %u reused from cache",
+					    uri, state->directories_read, state->directories_reused);
+			g_free (uri);
+
+			file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
+			directory->details->deep_count_file = NULL;
+			directory->details->deep_count_in_progress = NULL;
+			deep_count_state_free (state);
+			done = TRUE;
+			break;
+		}
 	}
 	
 	nautilus_file_updated_deep_count_in_progress (file);
@@ -2811,7 +3712,7 @@ deep_count_callback (GObject *source_object,
 	enumerator = g_file_enumerate_children_finish  (G_FILE (source_object),	res, NULL);
 	
 	if (enumerator == NULL) {
-		file->details->deep_unreadable_count += 1;
+		file->details->rare->deep_unreadable_count += 1;
 		
 		deep_count_next_dir (state);
 	} else {
@@ -2829,21 +3730,19 @@ deep_count_callback (GObject *source_object,
 static void
 deep_count_load (DeepCountState *state, GFile *location)
 {
-	NautilusDirectory *directory;
-
-	directory = state->directory;
-	state->deep_count_location = g_object_ref (location);
-
 #ifdef DEBUG_LOAD_DIRECTORY		
 	g_message ("load_directory called to get deep file count for %p", location);
 #endif	
-	g_file_enumerate_children_async (state->deep_count_location,
+	g_file_enumerate_children_async (location,
 					 G_FILE_ATTRIBUTE_STANDARD_NAME ","
 					 G_FILE_ATTRIBUTE_STANDARD_TYPE ","
 					 G_FILE_ATTRIBUTE_STANDARD_SIZE ","
 					 G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
 					 G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP ","
-					 G_FILE_ATTRIBUTE_UNIX_INODE,
+					 G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+					 G_FILE_ATTRIBUTE_UNIX_DEVICE ","
+					 G_FILE_ATTRIBUTE_UNIX_INODE ","
+					 G_FILE_ATTRIBUTE_UNIX_NLINK,
 					 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, /* flags */
 					 G_PRIORITY_LOW, /* prio */
 					 state->cancellable,
@@ -2851,6 +3750,19 @@ deep_count_load (DeepCountState *state, GFile *location)
 					 state);
 }
 
+static void
+deep_count_cache_job_result (gpointer result,
+			     NautilusDirectory **directory,
+			     NautilusFile **changed_file)
+{
+	NautilusFile *file;
+
+	file = result;
+
+	*directory = nautilus_directory_ref (file->details->directory);
+	*changed_file = file;
+}
+
 static void
 deep_count_stop (NautilusDirectory *directory)
 {
@@ -2878,8 +3790,10 @@ deep_count_start (NautilusDirectory *directory,
 		  NautilusFile *file,
 		  gboolean *doing_io)
 {
-	GFile *location;
 	DeepCountState *state;
+	DeepCountFrame *frame;
+	DeepCountCacheEntry *entry;
+	NautilusFileRareDetails *rare;
 	
 	if (directory->details->deep_count_in_progress != NULL) {
 		*doing_io = TRUE;
@@ -2900,28 +3814,49 @@ deep_count_start (NautilusDirectory *directory,
 		return;
 	}
 
+	frame = deep_count_frame_new (nautilus_file_get_location (file), NULL);
+	frame->mtime = file->details->mtime;
+
+	entry = deep_count_cache_lookup (frame);
+	if (entry != NULL) {
+		rare = nautilus_file_ensure_rare_details (file);
+		rare->deep_directory_count = entry->directory_count;
+		rare->deep_file_count = entry->file_count;
+		rare->deep_size = entry->size;
+		rare->deep_unreadable_count = 0;
+		file->details->deep_counts_status = NAUTILUS_REQUEST_DONE;
+		deep_count_frame_free (frame);
+
+		/* Still announced from the main loop, like counted ones */
+		queue_job_result (deep_count_cache_job_result, nautilus_file_ref (file));
+		return;
+	}
+
 	if (!async_job_start (directory, "deep count")) {
+		deep_count_frame_free (frame);
 		return;
 	}
 
 	/* Start counting. */
 	file->details->deep_counts_status = NAUTILUS_REQUEST_IN_PROGRESS;
-	file->details->deep_directory_count = 0;
-	file->details->deep_file_count = 0;
-	file->details->deep_unreadable_count = 0;
-	file->details->deep_size = 0;
+	rare = nautilus_file_ensure_rare_details (file);
+	rare->deep_directory_count = 0;
+	rare->deep_file_count = 0;
+	rare->deep_unreadable_count = 0;
+	rare->deep_size = 0;
 	directory->details->deep_count_file = file;
 
 	state = g_new0 (DeepCountState, 1);
 	state->directory = directory;
+	state->root = g_object_ref (frame->location);
 	state->cancellable = g_cancellable_new ();
-	state->seen_deep_count_inodes = g_array_new (FALSE, TRUE, sizeof (guint64));
+	state->seen_deep_count_inodes = g_hash_table_new_full (seen_inode_hash, seen_inode_equal,
+							       g_free, NULL);
 
 	directory->details->deep_count_in_progress = state;
+	running_deep_count_roots = g_list_prepend (running_deep_count_roots, state->root);
 	
-	location = nautilus_file_get_location (file);
-	deep_count_load (state, location);
-	g_object_unref (location);
+	deep_count_push (state, frame);
 }
 
 static void
@@ -2968,6 +3903,7 @@ mime_list_done (MimeListState *state, gboolean success)
 {
 	NautilusFile *file;
 	NautilusDirectory *directory;
+	NautilusFileRareDetails *rare;
 
 	directory = state->directory;
 	g_assert (directory != NULL);
@@ -2975,13 +3911,14 @@ mime_list_done (MimeListState *state, gboolean success)
 	file = state->mime_list_file;
 	
 	file->details->mime_list_is_up_to_date = TRUE;
-	eel_g_list_free_deep (file->details->mime_list);
+	rare = nautilus_file_ensure_rare_details (file);
+	eel_g_list_free_deep (rare->mime_list);
 	if (success) {
 		file->details->mime_list_failed = TRUE;
-		file->details->mime_list = NULL;
+		rare->mime_list = NULL;
 	} else {
 		file->details->got_mime_list = TRUE;
-		file->details->mime_list = istr_set_get_as_list	(state->mime_list_hash);
+		rare->mime_list = istr_set_get_as_list	(state->mime_list_hash);
 	}
 	directory->details->mime_list_in_progress = NULL;
 
@@ -3140,7 +4077,10 @@ mime_list_start (NautilusDirectory *directory,
 	*doing_io = TRUE;
 
 	if (!nautilus_file_is_directory (file)) {
-		g_list_free (file->details->mime_list);
+		if (file->details->rare != NULL) {
+			eel_g_list_free_deep (file->details->rare->mime_list);
+			file->details->rare->mime_list = NULL;
+		}
 		file->details->mime_list_failed = FALSE;
 		file->details->got_mime_list = FALSE;
 		file->details->mime_list_is_up_to_date = TRUE;
@@ -3222,6 +4162,7 @@ top_left_read_callback (GObject *source_object,
 	TopLeftTextReadState *state;
 	NautilusDirectory *directory;
 	NautilusFileDetails *file_details;
+	NautilusFileRareDetails *rare;
 	gsize file_size;
 	char *file_contents;
 
@@ -3238,18 +4179,19 @@ top_left_read_callback (GObject *source_object,
 	file_details = state->file->details;
 
 	file_details->top_left_text_is_up_to_date = TRUE;
-	g_free (file_details->top_left_text);
+	rare = nautilus_file_ensure_rare_details (state->file);
+	g_free (rare->top_left_text);
 
 	if (g_file_load_partial_contents_finish (G_FILE (source_object),
 						 res,
 						 &file_contents, &file_size,
 						 NULL, NULL)) {
-		file_details->top_left_text = nautilus_extract_top_left_text (file_contents, state->large, file_size);
+		rare->top_left_text = nautilus_extract_top_left_text (file_contents, state->large, file_size);
 		file_details->got_top_left_text = TRUE;
 		file_details->got_large_top_left_text = state->large;
 		g_free (file_contents);
 	} else {
-		file_details->top_left_text = NULL;
+		rare->top_left_text = NULL;
 		file_details->got_top_left_text = FALSE;
 		file_details->got_large_top_left_text = FALSE;
 	}
@@ -3329,8 +4271,10 @@ top_left_start (NautilusDirectory *directory,
 	*doing_io = TRUE;
 
 	if (!nautilus_file_contains_text (file)) {
-		g_free (file->details->top_left_text);
-		file->details->top_left_text = NULL;
+		if (file->details->rare != NULL) {
+			g_free (file->details->rare->top_left_text);
+			file->details->rare->top_left_text = NULL;
+		}
 		file->details->got_top_left_text = FALSE;
 		file->details->got_large_top_left_text = FALSE;
 		file->details->top_left_text_is_up_to_date = TRUE;
@@ -3361,11 +4305,28 @@ top_left_start (NautilusDirectory *directory,
 	g_object_unref (location);
 }
 
-static void
-get_info_state_free (GetInfoState *state)
-{
-	g_object_unref (state->cancellable);
-	g_free (state);
+static void
+get_info_state_free (GetInfoState *state)
+{
+	g_object_unref (state->cancellable);
+	g_free (state);
+}
+
+static GetInfoState *
+get_info_state_for_file (NautilusDirectory *directory,
+			 NautilusFile *file)
+{
+	GList *node;
+	GetInfoState *state;
+
+	for (node = directory->details->get_info_in_progress; node != NULL; node = node->next) {
+		state = node->data;
+		if (state->file == file) {
+			return state;
+		}
+	}
+
+	return NULL;
 }
 
 static void
@@ -3389,37 +4350,54 @@ query_info_callback (GObject *source_object,
 	
 	directory = nautilus_directory_ref (state->directory);
 
-	get_info_file = directory->details->get_info_file;
-	g_assert (NAUTILUS_IS_FILE (get_info_file));
+	get_info_file = state->file;
 
-	directory->details->get_info_file = NULL;
-	directory->details->get_info_in_progress = NULL;
-	
-	/* ref here because we might be removing the last ref when we
-	 * mark the file gone below, but we need to keep a ref at
-	 * least long enough to send the change notification. 
-	 */
-	nautilus_file_ref (get_info_file);
+	directory->details->get_info_in_progress =
+		g_list_remove (directory->details->get_info_in_progress, state);
 
 	error = NULL;
 	info = g_file_query_info_finish (G_FILE (source_object), res, &error);
-	
-	if (info == NULL) {
-		if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_NOT_FOUND) {
-			/* mark file as gone */
-			nautilus_file_mark_gone (get_info_file);
+
+	if (get_info_file == NULL) {
+		/* The file went away meanwhile */
+		if (info != NULL) {
+			g_object_unref (info);
+		}
+		if (error != NULL) {
+			g_error_free (error);
 		}
-		get_info_file->details->file_info_is_up_to_date = TRUE;
-		nautilus_file_clear_info (get_info_file);
-		get_info_file->details->get_info_failed = TRUE;
-		get_info_file->details->get_info_error = error;
 	} else {
-		nautilus_file_update_info (get_info_file, info);
-		g_object_unref (info);
-	}
+		g_assert (NAUTILUS_IS_FILE (get_info_file));
+
+		/* ref here because we might be removing the last ref when we
+		 * mark the file gone below, but we need to keep a ref at
+		 * least long enough to send the change notification. 
+		 */
+		nautilus_file_ref (get_info_file);
 
-	nautilus_file_changed (get_info_file);
-	nautilus_file_unref (get_info_file);
+		if (info == NULL) {
+			if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_NOT_FOUND) {
+				/* mark file as gone */
+				nautilus_file_mark_gone (get_info_file);
+			}
+			get_info_file->details->file_info_is_up_to_date = TRUE;
+			nautilus_file_clear_info (get_info_file);
+			get_info_file->details->get_info_failed = TRUE;
+			get_info_file->details->get_info_error = error;
+		} else {
+			nautilus_file_update_info (get_info_file, info);
+			g_object_unref (info);
+		}
+
+		/* The file was taken off the work queue while waiting,
+		 * put it back for the attributes that need the info. */
+		if (!get_info_file->details->is_gone) {
+			nautilus_directory_add_file_to_work_queue (directory, get_info_file);
+		}
+
+		nautilus_file_changed (get_info_file);
+		nautilus_file_unref (get_info_file);
+	}
 
 	async_job_end (directory, "file info");
 	nautilus_directory_async_state_changed (directory);
@@ -3433,22 +4411,39 @@ static void
 file_info_stop (NautilusDirectory *directory)
 {
 	NautilusFile *file;
+	GetInfoState *state;
+	GList *node, *next;
 
-	if (directory->details->get_info_in_progress != NULL) {
-		file = directory->details->get_info_file;
+	for (node = directory->details->get_info_in_progress; node != NULL; node = next) {
+		next = node->next;
+		state = node->data;
+		file = state->file;
 		if (file != NULL) {
 			g_assert (NAUTILUS_IS_FILE (file));
 			g_assert (file->details->directory == directory);
 			if (is_needy (file, lacks_info, REQUEST_FILE_INFO)) {
-				return;
+				continue;
 			}
 		}
 
-		/* The info is not wanted, so stop it. */
-		file_info_cancel (directory);
+		/* The info is not wanted, so stop it. The file may
+		 * still want its other attributes.
+		 */
+		file_info_cancel_state (directory, state, TRUE);
 	}
 }
 
+static gboolean
+file_info_is_in_progress (NautilusDirectory *directory,
+			  NautilusFile *file)
+{
+	return get_info_state_for_file (directory, file) != NULL;
+}
+
+/* Several queries may be in flight for a directory. The file being
+ * queried is taken off the work queue by start_or_stop_io(), and put
+ * back when the info arrives.
+ */
 static void
 file_info_start (NautilusDirectory *directory,
 		 NautilusFile *file,
@@ -3459,21 +4454,27 @@ file_info_start (NautilusDirectory *directory,
 	
 	file_info_stop (directory);
 
-	if (directory->details->get_info_in_progress != NULL) {
-		*doing_io = TRUE;
+	if (file_info_is_in_progress (directory, file)) {
 		return;
 	}
 
 	if (!is_needy (file, lacks_info, REQUEST_FILE_INFO)) {
 		return;
 	}
-	*doing_io = TRUE;
+
+	if (g_list_length (directory->details->get_info_in_progress) >=
+	    (nautilus_directory_is_local (directory) ?
+	     MAX_FILE_INFO_QUERIES_PER_LOCAL_DIRECTORY :
+	     MAX_FILE_INFO_QUERIES_PER_REMOTE_DIRECTORY)) {
+		*doing_io = TRUE;
+		return;
+	}
 
 	if (!async_job_start (directory, "file info")) {
+		*doing_io = TRUE;
 		return;
 	}
 
-	directory->details->get_info_file = file;
 	file->details->get_info_failed = FALSE;
 	if (file->details->get_info_error) {
 		g_error_free (file->details->get_info_error);
@@ -3482,9 +4483,11 @@ file_info_start (NautilusDirectory *directory,
 
 	state = g_new (GetInfoState, 1);
 	state->directory = directory;
+	state->file = file;
 	state->cancellable = g_cancellable_new ();
 
-	directory->details->get_info_in_progress = state;
+	directory->details->get_info_in_progress =
+		g_list_prepend (directory->details->get_info_in_progress, state);
 	
 	location = nautilus_file_get_location (file);
 	g_file_query_info_async (location,
@@ -3531,6 +4534,7 @@ link_info_done (NautilusDirectory *directory,
 		gboolean is_foreign)
 {
 	gboolean is_trusted;
+	NautilusFileRareDetails *rare;
 	
 	file->details->link_info_is_up_to_date = TRUE;
 
@@ -3543,16 +4547,18 @@ link_info_done (NautilusDirectory *directory,
 	}
 	
 	file->details->got_link_info = TRUE;
-	g_free (file->details->custom_icon);
-	file->details->custom_icon = NULL;
+	if (file->details->rare != NULL) {
+		g_free (file->details->rare->custom_icon);
+		file->details->rare->custom_icon = NULL;
+	}
 	if (uri) {
-		g_free (file->details->activation_uri);
-		file->details->activation_uri = NULL;
+		rare = nautilus_file_ensure_rare_details (file);
+		g_free (rare->activation_uri);
 		file->details->got_custom_activation_uri = TRUE;
-		file->details->activation_uri = g_strdup (uri);
+		rare->activation_uri = g_strdup (uri);
 	}
-	if (is_trusted) {
-		file->details->custom_icon = g_strdup (icon);
+	if (is_trusted && icon != NULL) {
+		nautilus_file_ensure_rare_details (file)->custom_icon = g_strdup (icon);
 	}
 	file->details->is_launcher = is_launcher;
 	file->details->is_foreign_link = is_foreign;
@@ -3753,6 +4759,7 @@ thumbnail_done (NautilusDirectory *directory,
 		g_object_unref (file->details->thumbnail);
 		file->details->thumbnail = NULL;
 	}
+	nautilus_file_icon_cache_thumbnail_changed (file);
 	if (pixbuf) {
 		if (tried_original) {
 			thumb_mtime = file->details->mtime;
@@ -3772,17 +4779,19 @@ thumbnail_done (NautilusDirectory *directory,
 			file->details->thumbnail_path = NULL;
 		}
 	}
-	
-	nautilus_directory_async_state_changed (directory);
 }
 
 static void
 thumbnail_stop (NautilusDirectory *directory)
 {
 	NautilusFile *file;
+	ThumbnailState *state;
+	GList *node, *next;
 
-	if (directory->details->thumbnail_state != NULL) {
-		file = directory->details->thumbnail_state->file;
+	for (node = directory->details->thumbnail_states; node != NULL; node = next) {
+		next = node->next;
+		state = node->data;
+		file = state->file;
 
 		if (file != NULL) {
 			g_assert (NAUTILUS_IS_FILE (file));
@@ -3790,39 +4799,28 @@ thumbnail_stop (NautilusDirectory *directory)
 			if (is_needy (file,
 				      lacks_thumbnail,
 				      REQUEST_THUMBNAIL)) {
-				return;
+				continue;
 			}
 		}
 
-		/* The link info is not wanted, so stop it. */
-		thumbnail_cancel (directory);
-	}
-}
-
-static void
-thumbnail_got_pixbuf (NautilusDirectory *directory,
-		      NautilusFile *file,
-		      GdkPixbuf *pixbuf,
-		      gboolean tried_original)
-{
-	nautilus_directory_ref (directory);
-
-	nautilus_file_ref (file);
-	thumbnail_done (directory, file, pixbuf, tried_original);
-	nautilus_file_changed (file);
-	nautilus_file_unref (file);
-	
-	if (pixbuf) {
-		g_object_unref (pixbuf);
+		/* The thumbnail is not wanted, so stop it. */
+		thumbnail_cancel_state (directory, state);
 	}
-
-	nautilus_directory_unref (directory);
 }
 
 static void
 thumbnail_state_free (ThumbnailState *state)
 {
 	g_object_unref (state->cancellable);
+	if (state->original_location != NULL) {
+		g_object_unref (state->original_location);
+	}
+	if (state->thumbnail_location != NULL) {
+		g_object_unref (state->thumbnail_location);
+	}
+	if (state->pixbuf != NULL) {
+		g_object_unref (state->pixbuf);
+	}
 	g_free (state);
 }
 
@@ -3894,60 +4892,194 @@ get_pixbuf_for_content (goffset file_len,
 	return pixbuf;
 }
 
-
-static void
-thumbnail_read_callback (GObject *source_object,
-			 GAsyncResult *res,
-			 gpointer user_data)
+static GdkPixbuf *
+load_pixbuf (GFile *location,
+	     GCancellable *cancellable)
 {
-	ThumbnailState *state;
-	gsize file_size;
 	char *file_contents;
-	gboolean result;
-	NautilusDirectory *directory;
+	gsize file_size;
 	GdkPixbuf *pixbuf;
-	GFile *location;
 
-	state = user_data;
+	if (!g_file_load_contents (location, cancellable,
+				   &file_contents, &file_size,
+				   NULL, NULL)) {
+		return NULL;
+	}
 
-	if (state->directory == NULL) {
-		/* Operation was cancelled. Bail out */
-		thumbnail_state_free (state);
-		return;
+	pixbuf = get_pixbuf_for_content (file_size, file_contents);
+	g_free (file_contents);
+
+	return pixbuf;
+}
+
+/* Returns the thumbnail of the file from the folder's pack, if the
+ * pack has one for the file as it is now.
+ */
+static GdkPixbuf *
+thumbnail_pack_lookup (NautilusDirectory *directory,
+		       const char *file_uri,
+		       time_t mtime)
+{
+	char *uri;
+
+	if (!nautilus_thumbnail_pack_is_enabled ()) {
+		return NULL;
 	}
 
-	directory = nautilus_directory_ref (state->directory);
+	/* Open it again if the thumbnail size changed */
+	if (directory->details->thumbnail_pack_size != cached_thumbnail_size) {
+		nautilus_thumbnail_pack_unref (directory->details->thumbnail_pack);
 
-	result = g_file_load_contents_finish (G_FILE (source_object),
-					      res,
-					      &file_contents, &file_size,
-					      NULL, NULL);
+		uri = nautilus_directory_get_uri (directory);
+		directory->details->thumbnail_pack =
+			nautilus_thumbnail_pack_open (uri, cached_thumbnail_size);
+		directory->details->thumbnail_pack_size = cached_thumbnail_size;
+		g_free (uri);
+	}
 
-	pixbuf = NULL;
-	if (result) {
-		pixbuf = get_pixbuf_for_content (file_size, file_contents);
-		g_free (file_contents);
+	if (directory->details->thumbnail_pack == NULL) {
+		return NULL;
 	}
-	
-	if (pixbuf == NULL && state->trying_original) {
-		state->trying_original = FALSE;
 
-		location = g_file_new_for_path (state->file->details->thumbnail_path);
-		g_file_load_contents_async (location,
-					    state->cancellable,
-					    thumbnail_read_callback,
-					    state);
-		g_object_unref (location);
+	return nautilus_thumbnail_pack_lookup (directory->details->thumbnail_pack,
+					       file_uri, mtime);
+}
+
+static gboolean
+thumbnail_pack_write_callback (gpointer callback_data)
+{
+	NautilusDirectory *directory;
+	NautilusThumbnailPackBuilder *builder;
+	NautilusFile *file;
+	GdkPixbuf *pixbuf;
+	GList *node;
+	char *uri;
+
+	directory = callback_data;
+	directory->details->thumbnail_pack_write_id = 0;
+
+	builder = nautilus_thumbnail_pack_builder_new (cached_thumbnail_size);
+	for (node = directory->details->file_list; node != NULL; node = node->next) {
+		file = NAUTILUS_FILE (node->data);
+		uri = nautilus_file_get_uri (file);
+
+		if (file->details->thumbnail != NULL &&
+		    file->details->thumbnail_is_up_to_date &&
+		    !file->details->thumbnail_tried_original) {
+			pixbuf = g_object_ref (file->details->thumbnail);
+		} else {
+			/* Not read this time, keep what the old pack has */
+			pixbuf = thumbnail_pack_lookup (directory, uri, file->details->mtime);
+		}
+
+		if (pixbuf != NULL) {
+			nautilus_thumbnail_pack_builder_add (builder, uri,
+							     file->details->mtime,
+							     pixbuf);
+			g_object_unref (pixbuf);
+		}
+		g_free (uri);
+	}
+
+	if (nautilus_thumbnail_pack_builder_get_n_thumbnails (builder) < MIN_THUMBNAILS_PER_PACK) {
+		nautilus_thumbnail_pack_builder_free (builder);
 	} else {
-		state->directory->details->thumbnail_state = NULL;
+		uri = nautilus_directory_get_uri (directory);
+		nautilus_thumbnail_pack_builder_write_async (builder, uri);
+		g_free (uri);
+	}
+
+	return FALSE;
+}
+
+static void
+thumbnail_pack_schedule_write (NautilusDirectory *directory)
+{
+	if (!nautilus_thumbnail_pack_is_enabled ()) {
+		return;
+	}
+
+	/* Wait until the thumbnails stop coming */
+	if (directory->details->thumbnail_pack_write_id != 0) {
+		g_source_remove (directory->details->thumbnail_pack_write_id);
+	}
+	directory->details->thumbnail_pack_write_id =
+		g_timeout_add_seconds (THUMBNAIL_PACK_WRITE_DELAY,
+				       thumbnail_pack_write_callback,
+				       directory);
+}
+
+static void
+thumbnail_pack_hit_result (gpointer result,
+			   NautilusDirectory **directory,
+			   NautilusFile **changed_file)
+{
+	ThumbnailPackHit *hit;
+
+	hit = result;
+
+	/* Hands over the references */
+	*directory = hit->directory;
+	*changed_file = hit->file;
+
+	g_free (hit);
+}
+
+static void
+thumbnail_job_result (gpointer result,
+		      NautilusDirectory **directory,
+		      NautilusFile **changed_file)
+{
+	ThumbnailState *state;
+
+	state = result;
+
+	*directory = NULL;
+	*changed_file = NULL;
+
+	if (state->directory != NULL) {
+		state->directory->details->thumbnail_states =
+			g_list_remove (state->directory->details->thumbnail_states, state);
 		async_job_end (state->directory, "thumbnail");
-		
-		thumbnail_got_pixbuf (state->directory, state->file, pixbuf, state->tried_original);
-	
-		thumbnail_state_free (state);
+
+		*directory = nautilus_directory_ref (state->directory);
+		if (state->file != NULL) {
+			thumbnail_done (state->directory, state->file,
+					state->pixbuf, state->tried_original);
+			*changed_file = nautilus_file_ref (state->file);
+
+			if (!state->tried_original &&
+			    state->file->details->thumbnail != NULL) {
+				thumbnail_pack_schedule_write (state->directory);
+			}
+		}
 	}
-	
-	nautilus_directory_unref (directory);
+
+	thumbnail_state_free (state);
+}
+
+static gboolean
+thumbnail_load_job (GIOSchedulerJob *job,
+		    GCancellable *cancellable,
+		    gpointer user_data)
+{
+	ThumbnailState *state;
+	GdkPixbuf *pixbuf;
+
+	state = user_data;
+
+	pixbuf = NULL;
+	if (state->original_location != NULL) {
+		pixbuf = load_pixbuf (state->original_location, cancellable);
+	}
+	if (pixbuf == NULL && state->thumbnail_location != NULL) {
+		pixbuf = load_pixbuf (state->thumbnail_location, cancellable);
+	}
+	state->pixbuf = pixbuf;
+
+	queue_job_result (thumbnail_job_result, state);
+
+	return FALSE;
 }
 
 static void
@@ -3955,11 +5087,13 @@ thumbnail_start (NautilusDirectory *directory,
 		 NautilusFile *file,
 		 gboolean *doing_io)
 {
-	GFile *location;
 	ThumbnailState *state;
+	ThumbnailPackHit *hit;
+	GdkPixbuf *pixbuf;
+	char *uri;
 	
-	if (directory->details->thumbnail_state != NULL) {
-		*doing_io = TRUE;
+	if (get_thumbnail_state (directory, file) != NULL) {
+		/* Already loading, the queue can move on meanwhile */
 		return;
 	}
 
@@ -3968,9 +5102,34 @@ thumbnail_start (NautilusDirectory *directory,
 		       REQUEST_THUMBNAIL)) {
 		return;
 	}
-	*doing_io = TRUE;
+
+	/* Decoded already if it is in the pack, no I/O needed */
+	if (!file->details->thumbnail_wants_original) {
+		uri = nautilus_file_get_uri (file);
+		pixbuf = thumbnail_pack_lookup (directory, uri, file->details->mtime);
+		g_free (uri);
+
+		if (pixbuf != NULL) {
+			thumbnail_done (directory, file, pixbuf, FALSE);
+			file->details->thumbnail_mtime = file->details->mtime;
+			g_object_unref (pixbuf);
+
+			/* Views are told along with the other results */
+			hit = g_new (ThumbnailPackHit, 1);
+			hit->directory = nautilus_directory_ref (directory);
+			hit->file = nautilus_file_ref (file);
+			queue_job_result (thumbnail_pack_hit_result, hit);
+			return;
+		}
+	}
+
+	if (g_list_length (directory->details->thumbnail_states) >= MAX_THUMBNAIL_LOADS_PER_DIRECTORY) {
+		*doing_io = TRUE;
+		return;
+	}
 
 	if (!async_job_start (directory, "thumbnail")) {
+		*doing_io = TRUE;
 		return;
 	}
 	
@@ -3979,21 +5138,23 @@ thumbnail_start (NautilusDirectory *directory,
 	state->file = file;
 	state->cancellable = g_cancellable_new ();
 
+	/* The job falls back to the thumbnail if the original can't be read */
 	if (file->details->thumbnail_wants_original) {
 		state->tried_original = TRUE;
-		state->trying_original = TRUE;
-		location = nautilus_file_get_location (file);
-	} else {
-		location = g_file_new_for_path (file->details->thumbnail_path);
+		state->original_location = nautilus_file_get_location (file);
+	}
+	if (file->details->thumbnail_path != NULL) {
+		state->thumbnail_location = g_file_new_for_path (file->details->thumbnail_path);
 	}
 	
-	directory->details->thumbnail_state = state;
+	directory->details->thumbnail_states =
+		g_list_prepend (directory->details->thumbnail_states, state);
 	
-	g_file_load_contents_async (location,
-				    state->cancellable,
-				    thumbnail_read_callback,
-				    state);
-	g_object_unref (location);
+	g_io_scheduler_push_job (thumbnail_load_job,
+				 state,
+				 NULL,
+				 G_PRIORITY_DEFAULT,
+				 state->cancellable);
 }
 
 static void
@@ -4338,7 +5499,8 @@ extension_info_cancel (NautilusDirectory *directory)
 		}
 
 		directory->details->extension_info_in_progress = NULL;
-		directory->details->extension_info_file = NULL;
+		g_list_free (directory->details->extension_info_files);
+		directory->details->extension_info_files = NULL;
 		directory->details->extension_info_provider = NULL;
 		directory->details->extension_info_idle = 0;
 
@@ -4351,9 +5513,13 @@ extension_info_stop (NautilusDirectory *directory)
 {
 	if (directory->details->extension_info_in_progress != NULL) {
 		NautilusFile *file;
+		GList *node;
 
-		file = directory->details->extension_info_file;
-		if (file != NULL) {
+		/* Keep the batch going as long as any of its files still
+		 * wants the info.
+		 */
+		for (node = directory->details->extension_info_files; node != NULL; node = node->next) {
+			file = node->data;
 			g_assert (NAUTILUS_IS_FILE (file));
 			g_assert (file->details->directory == directory);
 			if (is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
@@ -4368,18 +5534,27 @@ extension_info_stop (NautilusDirectory *directory)
 
 static void
 finish_info_provider (NautilusDirectory *directory,
-		      NautilusFile *file,
+		      GList *files,
 		      NautilusInfoProvider *provider)
 {
-	file->details->pending_info_providers = 
-		g_list_remove  (file->details->pending_info_providers,
-				provider);
-	g_object_unref (provider);
+	NautilusFile *file;
+	GList *node;
+
+	for (node = files; node != NULL; node = node->next) {
+		file = node->data;
+		file->details->pending_info_providers = 
+			g_list_remove  (file->details->pending_info_providers,
+					provider);
+		g_object_unref (provider);
+	}
 
 	nautilus_directory_async_state_changed (directory);
 
-	if (file->details->pending_info_providers == NULL) {
-		nautilus_file_info_providers_done (file);
+	for (node = files; node != NULL; node = node->next) {
+		file = node->data;
+		if (file->details->pending_info_providers == NULL) {
+			nautilus_file_info_providers_done (file);
+		}
 	}
 }
 
@@ -4397,17 +5572,19 @@ info_provider_idle_callback (gpointer user_data)
 	    || response->provider != directory->details->extension_info_provider) {
 		g_warning ("Unexpected plugin response.  This probably indicates a bug in a Nautilus extension: handle=%p", response->handle);
 	} else {
-		NautilusFile *file;
+		GList *files;
 		async_job_end (directory, "extension info");
 
-		file = directory->details->extension_info_file;
+		files = directory->details->extension_info_files;
 
-		directory->details->extension_info_file = NULL;
+		directory->details->extension_info_files = NULL;
 		directory->details->extension_info_provider = NULL;
 		directory->details->extension_info_in_progress = NULL;
 		directory->details->extension_info_idle = 0;
 		
-		finish_info_provider (directory, file, response->provider);
+		nautilus_file_list_ref (files);
+		finish_info_provider (directory, files, response->provider);
+		nautilus_file_list_free (files);
 	}
 
 	return FALSE;
@@ -4433,6 +5610,37 @@ info_provider_callback (NautilusInfoProvider *provider,
 				 g_free);
 }
 
+/* Collects the queued files that are waiting for the same provider
+ * as file, so a batching provider can do them all in one go.
+ */
+static GList *
+get_extension_info_batch (NautilusDirectory *directory,
+			  NautilusFile *file,
+			  NautilusInfoProvider *provider)
+{
+	NautilusFile *queued_file;
+	GList *files, *node;
+	int count;
+
+	files = g_list_prepend (NULL, file);
+	count = 1;
+
+	for (node = nautilus_file_queue_peek_head_link (directory->details->extension_queue);
+	     node != NULL && count < MAX_EXTENSION_INFO_BATCH;
+	     node = node->next) {
+		queued_file = node->data;
+		if (queued_file != file &&
+		    queued_file->details->pending_info_providers != NULL &&
+		    queued_file->details->pending_info_providers->data == provider &&
+		    is_needy (queued_file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
+			files = g_list_prepend (files, queued_file);
+			count++;
+		}
+	}
+
+	return g_list_reverse (files);
+}
+
 static void
 extension_info_start (NautilusDirectory *directory,
 		      NautilusFile *file,
@@ -4442,6 +5650,7 @@ extension_info_start (NautilusDirectory *directory,
 	NautilusOperationResult result;
 	NautilusOperationHandle *handle;
 	GClosure *update_complete;
+	GList *files;
 
 	if (directory->details->extension_info_in_progress != NULL) {
 		*doing_io = TRUE;
@@ -4464,23 +5673,36 @@ extension_info_start (NautilusDirectory *directory,
 					  NULL);
 	g_closure_set_marshal (update_complete,
 			       nautilus_marshal_VOID__POINTER_ENUM);
-			       
-	result = nautilus_info_provider_update_file_info
-		(provider, 
-		 NAUTILUS_FILE_INFO (file), 
-		 update_complete, 
-		 &handle);
+
+	/* Older extensions only know about one file at a time */
+	if (nautilus_info_provider_can_update_file_info_batch (provider)) {
+		files = get_extension_info_batch (directory, file, provider);
+		result = nautilus_info_provider_update_file_info_batch
+			(provider,
+			 files,
+			 update_complete,
+			 &handle);
+	} else {
+		files = g_list_prepend (NULL, file);
+		result = nautilus_info_provider_update_file_info
+			(provider, 
+			 NAUTILUS_FILE_INFO (file), 
+			 update_complete, 
+			 &handle);
+	}
 
 	g_closure_unref (update_complete);
 
 	if (result == NAUTILUS_OPERATION_COMPLETE ||
 	    result == NAUTILUS_OPERATION_FAILED) {
-		finish_info_provider (directory, file, provider);
 		async_job_end (directory, "extension info");
+		nautilus_file_list_ref (files);
+		finish_info_provider (directory, files, provider);
+		nautilus_file_list_free (files);
 	} else {
 		directory->details->extension_info_in_progress = handle;
 		directory->details->extension_info_provider = provider;
-		directory->details->extension_info_file = file;
+		directory->details->extension_info_files = files;
 	}
 }
 
@@ -4512,6 +5734,17 @@ start_or_stop_io (NautilusDirectory *directory)
 
 		/* Start getting attributes if possible */
 		file_info_start (directory, file, &doing_io);
+		if (doing_io) {
+			return;
+		}
+
+		if (file_info_is_in_progress (directory, file)) {
+			/* Go on with the next file while this one waits */
+			nautilus_file_queue_remove (directory->details->high_priority_queue,
+						    file);
+			continue;
+		}
+
 		link_info_start (directory, file, &doing_io);
 
 		if (doing_io) {
@@ -4561,6 +5794,8 @@ start_or_stop_io (NautilusDirectory *directory)
 void
 nautilus_directory_async_state_changed (NautilusDirectory *directory)
 {
+	gint64 start_time, io_start_time;
+
 	/* Check if any callbacks are satisfied and call them if they
 	 * are. Do this last so that any changes done in start or stop
 	 * I/O functions immediately (not in callbacks) are taken into
@@ -4575,13 +5810,19 @@ nautilus_directory_async_state_changed (NautilusDirectory *directory)
 	}
 	directory->details->in_async_service_loop = TRUE;
 	nautilus_directory_ref (directory);
+	start_time = nautilus_trace_get_time ();
 	do {
 		directory->details->state_changed = FALSE;
+		io_start_time = nautilus_trace_get_time ();
 		start_or_stop_io (directory);
+		nautilus_trace_add_span ("start or stop I/O", trace_location (directory),
+					 io_start_time, -1);
 		if (call_ready_callbacks (directory)) {
 			directory->details->state_changed = TRUE;
 		}
 	} while (directory->details->state_changed);
+	nautilus_trace_add_span ("async state changed", trace_location (directory),
+				 start_time, -1);
 	directory->details->in_async_service_loop = FALSE;
 	nautilus_directory_unref (directory);
 
@@ -4619,9 +5860,11 @@ static void
 cancel_directory_count_for_file (NautilusDirectory *directory,
 				 NautilusFile      *file)
 {
-	if (directory->details->count_in_progress != NULL &&
-	    directory->details->count_in_progress->count_file == file) {
-		directory_count_cancel (directory);
+	DirectoryCountState *state;
+
+	state = get_directory_count_state (directory, file);
+	if (state != NULL) {
+		directory_count_cancel_state (directory, state);
 	}
 }
 
@@ -4658,8 +5901,11 @@ static void
 cancel_file_info_for_file (NautilusDirectory *directory,
 			   NautilusFile      *file)
 {
-	if (directory->details->get_info_file == file) {
-		file_info_cancel (directory);
+	GetInfoState *state;
+
+	state = get_info_state_for_file (directory, file);
+	if (state != NULL) {
+		file_info_cancel_state (directory, state, FALSE);
 	}
 }
 
@@ -4667,9 +5913,11 @@ static void
 cancel_thumbnail_for_file (NautilusDirectory *directory,
 			   NautilusFile      *file)
 {
-	if (directory->details->thumbnail_state != NULL &&
-	    directory->details->thumbnail_state->file == file) {
-		thumbnail_cancel (directory);
+	ThumbnailState *state;
+
+	state = get_thumbnail_state (directory, file);
+	if (state != NULL) {
+		thumbnail_cancel_state (directory, state);
 	}
 }
 
@@ -4827,6 +6075,20 @@ nautilus_directory_remove_file_from_work_queue (NautilusDirectory *directory,
 				    file);
 }
 
+/* Gets the attributes of the file before those of the files queued
+ * ahead of it, at the same priority.
+ */
+void
+nautilus_directory_prioritize_file_in_work_queue (NautilusDirectory *directory,
+						  NautilusFile *file)
+{
+	nautilus_file_queue_move_to_head (directory->details->high_priority_queue,
+					  file);
+	nautilus_file_queue_move_to_head (directory->details->low_priority_queue,
+					  file);
+	nautilus_file_queue_move_to_head (directory->details->extension_queue,
+					  file);
+}
 
 static void
 move_file_to_low_priority_queue (NautilusDirectory *directory,
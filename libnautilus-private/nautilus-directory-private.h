@@ -29,6 +29,7 @@
 #include <libnautilus-private/nautilus-file.h>
 #include <libnautilus-private/nautilus-monitor.h>
 #include <libnautilus-private/nautilus-idle-queue.h>
+#include <libnautilus-private/nautilus-thumbnail-pack.h>
 #include <libnautilus-extension/nautilus-info-provider.h>
 #include <libxml/tree.h>
 
@@ -103,28 +104,34 @@ struct NautilusDirectoryDetails
 	gboolean directory_loaded_sent_notification;
 	DirectoryLoadState *directory_load_in_progress;
 
-	GList *pending_file_info; /* list of GnomeVFSFileInfo's that are pending */
+	GPtrArray *pending_file_info; /* GFileInfo's that are pending, in the order seen */
 	int confirmed_file_count;
         guint dequeue_pending_idle_id;
 
 	GList *new_files_in_progress; /* list of NewFilesState * */
 
-	DirectoryCountState *count_in_progress;
+	GList *count_in_progress; /* list of DirectoryCountState * */
 
 	NautilusFile *deep_count_file;
 	DeepCountState *deep_count_in_progress;
 
 	MimeListState *mime_list_in_progress;
 
-	NautilusFile *get_info_file;
-	GetInfoState *get_info_in_progress;
+	GList *get_info_in_progress;
 
-	NautilusFile *extension_info_file;
+	GList *extension_info_files;
 	NautilusInfoProvider *extension_info_provider;
 	NautilusOperationHandle *extension_info_in_progress;
 	guint extension_info_idle;
 
-	ThumbnailState *thumbnail_state;
+	GList *thumbnail_states;
+
+	/* Opened for thumbnails of thumbnail_pack_size, see
+	 * thumbnail_pack_lookup ().
+	 */
+	NautilusThumbnailPack *thumbnail_pack;
+	int thumbnail_pack_size;
+	guint thumbnail_pack_write_id;
 
 	MountState *mount_state;
 
@@ -140,6 +147,11 @@ struct NautilusDirectoryDetails
 
 	guint64 free_space; /* (guint)-1 for unknown */
 	time_t free_space_read; /* The time free_space was updated, or 0 for never */
+
+	/* For the spans in nautilus-trace.h */
+	char *trace_uri; /* NULL until needed */
+	gint64 trace_wait_start; /* when a job had to wait for a slot, or 0 */
+	GList *trace_job_starts; /* of TraceJobStart, see async_job_start () */
 };
 
 NautilusDirectory *nautilus_directory_get_existing                    (GFile                     *location);
@@ -176,6 +188,7 @@ void               nautilus_directory_get_info_for_new_files          (NautilusD
 								       GList                     *vfs_uris);
 NautilusFile *     nautilus_directory_get_existing_corresponding_file (NautilusDirectory         *directory);
 void               nautilus_directory_invalidate_count_and_mime_list  (NautilusDirectory         *directory);
+void               nautilus_directory_invalidate_deep_count_cache     (GFile                     *location);
 gboolean           nautilus_directory_is_file_list_monitored          (NautilusDirectory         *directory);
 gboolean           nautilus_directory_is_anyone_monitoring_file_list  (NautilusDirectory         *directory);
 gboolean           nautilus_directory_has_active_request_for_file     (NautilusDirectory         *directory,
@@ -183,6 +196,7 @@ gboolean           nautilus_directory_has_active_request_for_file     (NautilusD
 void               nautilus_directory_remove_file_monitor_link        (NautilusDirectory         *directory,
 								       GList                     *link);
 void               nautilus_directory_schedule_dequeue_pending        (NautilusDirectory         *directory);
+void               nautilus_directory_free_pending_file_info          (NautilusDirectory         *directory);
 void               nautilus_directory_stop_monitoring_file_list       (NautilusDirectory         *directory);
 void               nautilus_directory_cancel                          (NautilusDirectory         *directory);
 void               nautilus_async_destroying_file                     (NautilusFile              *file);
@@ -239,6 +253,8 @@ void               nautilus_directory_add_file_to_work_queue          (NautilusD
 								       NautilusFile *file);
 void               nautilus_directory_remove_file_from_work_queue     (NautilusDirectory *directory,
 								       NautilusFile *file);
+void               nautilus_directory_prioritize_file_in_work_queue   (NautilusDirectory *directory,
+								       NautilusFile *file);
 
 /* KDE compatibility hacks */
 
@@ -190,6 +190,7 @@ nautilus_directory_finalize (GObject *object)
 	if (directory->details->location) {
 		g_object_unref (directory->details->location);
 	}
+	g_free (directory->details->trace_uri);
 
 	g_assert (directory->details->file_list == NULL);
 	g_hash_table_destroy (directory->details->file_hash);
@@ -204,7 +205,13 @@ nautilus_directory_finalize (GObject *object)
 	g_assert (directory->details->directory_load_in_progress == NULL);
 	g_assert (directory->details->count_in_progress == NULL);
 	g_assert (directory->details->dequeue_pending_idle_id == 0);
-	eel_g_object_list_free (directory->details->pending_file_info);
+	nautilus_directory_free_pending_file_info (directory);
+	eel_g_list_free_deep (directory->details->trace_job_starts);
+
+	if (directory->details->thumbnail_pack_write_id != 0) {
+		g_source_remove (directory->details->thumbnail_pack_write_id);
+	}
+	nautilus_thumbnail_pack_unref (directory->details->thumbnail_pack);
 
 	EEL_CALL_PARENT (G_OBJECT_CLASS, finalize, (object));
 }
@@ -957,6 +964,8 @@ nautilus_directory_notify_files_added (GList *files)
 	for (p = files; p != NULL; p = p->next) {
 		location = p->data;
 
+		nautilus_directory_invalidate_deep_count_cache (location);
+
 		/* See if the directory is already known. */
 		directory = get_parent_directory_if_exists (location);
 		if (directory == NULL) {
@@ -1072,6 +1081,8 @@ nautilus_directory_notify_files_changed (GList *files)
 	for (node = files; node != NULL; node = node->next) {
 		location = node->data;
 
+		nautilus_directory_invalidate_deep_count_cache (location);
+
 		/* Find the file. */
 		file = nautilus_file_get_existing (location);
 		if (file != NULL) {
@@ -1124,6 +1135,8 @@ nautilus_directory_notify_files_removed (GList *files)
 	for (p = files; p != NULL; p = p->next) {
 		location = p->data;
 
+		nautilus_directory_invalidate_deep_count_cache (location);
+
 		/* Update file count for parent directory if anyone might care. */
 		directory = get_parent_directory_if_exists (location);
 		if (directory != NULL) {
@@ -1170,7 +1183,8 @@ set_directory_location (NautilusDirectory *directory,
 		g_object_unref (directory->details->location);
 	}
 	directory->details->location = g_object_ref (location);
-	
+	g_free (directory->details->trace_uri);
+	directory->details->trace_uri = NULL;
 }
 
 static void
@@ -1337,6 +1351,9 @@ nautilus_directory_notify_files_moved (GList *file_pairs)
 		from_location = pair->from;
 		to_location = pair->to;
 
+		nautilus_directory_invalidate_deep_count_cache (from_location);
+		nautilus_directory_invalidate_deep_count_cache (to_location);
+
 		/* Handle overwriting a file. */
 		file = nautilus_file_get_existing (to_location);
 		if (file != NULL) {
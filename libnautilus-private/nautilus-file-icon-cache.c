@@ -0,0 +1,390 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-file-icon-cache.c: scaled thumbnails shared by all views.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-file-icon-cache.h"
+
+#include "nautilus-debug-log.h"
+#include "nautilus-file-private.h"
+#include "nautilus-lib-self-check-functions.h"
+#include <eel/eel-debug.h>
+
+/* The least recently used icons are dropped above this */
+#define MAX_CACHE_BYTES (32 * 1024 * 1024)
+
+/* Only this flag changes how a thumbnail is scaled */
+#define CACHED_FLAGS NAUTILUS_FILE_ICON_FLAGS_FORCE_THUMBNAIL_SIZE
+
+typedef struct {
+	/* Not a reference. An entry left over from a finalized file
+	 * can't match a new file at the same address, because thumbnail
+	 * generations are never reused.
+	 */
+	NautilusFile *file;
+	int size;
+	NautilusFileIconFlags flags;
+
+	/* What the icon was made from. The thumbnail itself isn't
+	 * kept, the icon is all that is needed.
+	 */
+	guint thumbnail_generation;
+	time_t thumbnail_mtime;
+
+	NautilusIconInfo *icon;
+	GdkPixbuf *pixbuf_at_size;
+	int pixbuf_at_size_size;
+
+	gsize bytes;
+	GList lru_link;
+} CachedIcon;
+
+static GHashTable *cache;
+static GQueue lru = G_QUEUE_INIT;	/* most recently used first */
+static guint last_thumbnail_generation;
+static NautilusFileIconCacheStatistics statistics;
+static GQuark cached_icon_quark;
+
+static guint
+cached_icon_hash (gconstpointer key)
+{
+	const CachedIcon *cached_icon;
+
+	cached_icon = key;
+
+	return g_direct_hash (cached_icon->file) ^ (cached_icon->size << 1) ^ cached_icon->flags;
+}
+
+static gboolean
+cached_icon_equal (gconstpointer a, gconstpointer b)
+{
+	const CachedIcon *cached_icon_a, *cached_icon_b;
+
+	cached_icon_a = a;
+	cached_icon_b = b;
+
+	return cached_icon_a->file == cached_icon_b->file &&
+		cached_icon_a->size == cached_icon_b->size &&
+		cached_icon_a->flags == cached_icon_b->flags;
+}
+
+static gsize
+get_pixbuf_bytes (GdkPixbuf *pixbuf)
+{
+	if (pixbuf == NULL) {
+		return 0;
+	}
+
+	return gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+}
+
+static void
+cached_icon_free (gpointer data)
+{
+	CachedIcon *cached_icon;
+
+	cached_icon = data;
+
+	g_queue_unlink (&lru, &cached_icon->lru_link);
+	statistics.bytes -= cached_icon->bytes;
+	statistics.n_icons--;
+
+	/* Views may keep using the icon, without the cache */
+	g_object_set_qdata (G_OBJECT (cached_icon->icon), cached_icon_quark, NULL);
+	g_object_unref (cached_icon->icon);
+	if (cached_icon->pixbuf_at_size != NULL) {
+		g_object_unref (cached_icon->pixbuf_at_size);
+	}
+	g_slice_free (CachedIcon, cached_icon);
+}
+
+static void
+free_cache (void)
+{
+	g_hash_table_destroy (cache);
+	cache = NULL;
+}
+
+static char *
+statistics_to_string (void)
+{
+	return g_strdup_printf ("icons: %u\n"
+				"bytes: %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT "\n"
+				"hits: %u\n"
+				"misses: %u\n"
+				"evictions: %u\n",
+				statistics.n_icons,
+				statistics.bytes, statistics.max_bytes,
+				statistics.hits,
+				statistics.misses,
+				statistics.evictions);
+}
+
+static void
+ensure_cache (void)
+{
+	if (cache != NULL) {
+		return;
+	}
+
+	cache = g_hash_table_new_full (cached_icon_hash, cached_icon_equal,
+				       NULL, cached_icon_free);
+	statistics.max_bytes = MAX_CACHE_BYTES;
+
+	if (cached_icon_quark == 0) {
+		cached_icon_quark = g_quark_from_static_string ("nautilus-file-icon-cache");
+		nautilus_debug_log_add_section ("FILE ICON CACHE", statistics_to_string);
+	}
+
+	eel_debug_call_at_shutdown (free_cache);
+}
+
+static void
+evict (void)
+{
+	CachedIcon *cached_icon;
+
+	/* Keep the icon that was just used, whatever its size */
+	while (statistics.bytes > statistics.max_bytes && lru.length > 1) {
+		cached_icon = lru.tail->data;
+		statistics.evictions++;
+		g_hash_table_remove (cache, cached_icon);
+	}
+}
+
+static void
+mark_used (CachedIcon *cached_icon)
+{
+	g_queue_unlink (&lru, &cached_icon->lru_link);
+	g_queue_push_head_link (&lru, &cached_icon->lru_link);
+}
+
+NautilusIconInfo *
+nautilus_file_icon_cache_lookup (NautilusFile *file,
+				 int size,
+				 NautilusFileIconFlags flags)
+{
+	CachedIcon lookup_key, *cached_icon;
+
+	if (cache == NULL) {
+		statistics.misses++;
+		return NULL;
+	}
+
+	lookup_key.file = file;
+	lookup_key.size = size;
+	lookup_key.flags = flags & CACHED_FLAGS;
+
+	cached_icon = g_hash_table_lookup (cache, &lookup_key);
+	if (cached_icon == NULL) {
+		statistics.misses++;
+		return NULL;
+	}
+
+	if (cached_icon->thumbnail_generation != file->details->thumbnail_generation ||
+	    cached_icon->thumbnail_mtime != file->details->thumbnail_mtime) {
+		/* Made from an older thumbnail */
+		g_hash_table_remove (cache, cached_icon);
+		statistics.misses++;
+		return NULL;
+	}
+
+	statistics.hits++;
+	mark_used (cached_icon);
+
+	return g_object_ref (cached_icon->icon);
+}
+
+void
+nautilus_file_icon_cache_insert (NautilusFile *file,
+				 int size,
+				 NautilusFileIconFlags flags,
+				 NautilusIconInfo *icon)
+{
+	CachedIcon *cached_icon;
+	GdkPixbuf *pixbuf;
+
+	g_return_if_fail (file->details->thumbnail != NULL);
+
+	ensure_cache ();
+
+	cached_icon = g_slice_new0 (CachedIcon);
+	cached_icon->file = file;
+	cached_icon->size = size;
+	cached_icon->flags = flags & CACHED_FLAGS;
+	cached_icon->thumbnail_generation = file->details->thumbnail_generation;
+	cached_icon->thumbnail_mtime = file->details->thumbnail_mtime;
+	cached_icon->icon = g_object_ref (icon);
+	cached_icon->lru_link.data = cached_icon;
+
+	pixbuf = nautilus_icon_info_get_pixbuf_nodefault (icon);
+	cached_icon->bytes = get_pixbuf_bytes (pixbuf);
+	if (pixbuf != NULL) {
+		g_object_unref (pixbuf);
+	}
+
+	/* Replaces any entry for an older thumbnail */
+	g_hash_table_replace (cache, cached_icon, cached_icon);
+	g_queue_push_head_link (&lru, &cached_icon->lru_link);
+	g_object_set_qdata (G_OBJECT (icon), cached_icon_quark, cached_icon);
+	statistics.bytes += cached_icon->bytes;
+	statistics.n_icons++;
+
+	evict ();
+}
+
+GdkPixbuf *
+nautilus_file_icon_cache_get_pixbuf_at_size (NautilusIconInfo *icon,
+					     int size)
+{
+	CachedIcon *cached_icon;
+	GdkPixbuf *pixbuf;
+
+	if (cached_icon_quark == 0) {
+		return NULL;
+	}
+
+	cached_icon = g_object_get_qdata (G_OBJECT (icon), cached_icon_quark);
+	if (cached_icon == NULL) {
+		return NULL;
+	}
+
+	if (cached_icon->pixbuf_at_size == NULL ||
+	    cached_icon->pixbuf_at_size_size != size) {
+		if (cached_icon->pixbuf_at_size != NULL) {
+			cached_icon->bytes -= get_pixbuf_bytes (cached_icon->pixbuf_at_size);
+			statistics.bytes -= get_pixbuf_bytes (cached_icon->pixbuf_at_size);
+			g_object_unref (cached_icon->pixbuf_at_size);
+		}
+
+		cached_icon->pixbuf_at_size = nautilus_icon_info_get_pixbuf_at_size (icon, size);
+		cached_icon->pixbuf_at_size_size = size;
+
+		/* Already counted if no scaling was needed */
+		pixbuf = nautilus_icon_info_get_pixbuf_nodefault (icon);
+		if (pixbuf != cached_icon->pixbuf_at_size) {
+			cached_icon->bytes += get_pixbuf_bytes (cached_icon->pixbuf_at_size);
+			statistics.bytes += get_pixbuf_bytes (cached_icon->pixbuf_at_size);
+		}
+		if (pixbuf != NULL) {
+			g_object_unref (pixbuf);
+		}
+	}
+
+	pixbuf = g_object_ref (cached_icon->pixbuf_at_size);
+
+	mark_used (cached_icon);
+	evict ();
+
+	return pixbuf;
+}
+
+void
+nautilus_file_icon_cache_thumbnail_changed (NautilusFile *file)
+{
+	file->details->thumbnail_generation = ++last_thumbnail_generation;
+}
+
+void
+nautilus_file_icon_cache_clear (void)
+{
+	if (cache != NULL) {
+		g_hash_table_remove_all (cache);
+	}
+}
+
+void
+nautilus_file_icon_cache_get_statistics (NautilusFileIconCacheStatistics *statistics_out)
+{
+	*statistics_out = statistics;
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+static gboolean
+check_lookup (NautilusFile *file, int size, NautilusFileIconFlags flags,
+	      NautilusIconInfo *expected)
+{
+	NautilusIconInfo *icon;
+	gboolean found;
+
+	icon = nautilus_file_icon_cache_lookup (file, size, flags);
+	found = icon == expected;
+	if (icon != NULL) {
+		g_object_unref (icon);
+	}
+
+	return found;
+}
+
+void
+nautilus_self_check_file_icon_cache (void)
+{
+	NautilusFile *file;
+	NautilusIconInfo *icon;
+	GdkPixbuf *thumbnail, *scaled;
+	GdkPixbuf *old_thumbnail;
+	time_t old_thumbnail_mtime;
+	guint old_thumbnail_generation;
+
+	file = nautilus_file_get_by_uri ("file:///nautilus-file-icon-cache-check.png");
+	old_thumbnail = file->details->thumbnail;
+	old_thumbnail_mtime = file->details->thumbnail_mtime;
+	old_thumbnail_generation = file->details->thumbnail_generation;
+
+	thumbnail = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 64, 32);
+	scaled = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 48, 24);
+	file->details->thumbnail = thumbnail;
+	file->details->thumbnail_mtime = 1000;
+	nautilus_file_icon_cache_thumbnail_changed (file);
+
+	icon = nautilus_icon_info_new_for_pixbuf (scaled);
+	nautilus_file_icon_cache_insert (file, 48, NAUTILUS_FILE_ICON_FLAGS_USE_THUMBNAILS, icon);
+
+	EEL_CHECK_BOOLEAN_RESULT (check_lookup (file, 48, NAUTILUS_FILE_ICON_FLAGS_USE_THUMBNAILS, icon), TRUE);
+	/* Flags that don't change the scaling share the icon */
+	EEL_CHECK_BOOLEAN_RESULT (check_lookup (file, 48, NAUTILUS_FILE_ICON_FLAGS_USE_THUMBNAILS
+						| NAUTILUS_FILE_ICON_FLAGS_IGNORE_VISITING, icon), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check_lookup (file, 48, NAUTILUS_FILE_ICON_FLAGS_USE_THUMBNAILS
+						| NAUTILUS_FILE_ICON_FLAGS_FORCE_THUMBNAIL_SIZE, NULL), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check_lookup (file, 72, NAUTILUS_FILE_ICON_FLAGS_USE_THUMBNAILS, NULL), TRUE);
+
+	/* The pixbuf is already 48 wide */
+	EEL_CHECK_INTEGER_RESULT (statistics.bytes, get_pixbuf_bytes (scaled));
+	g_object_unref (nautilus_file_icon_cache_get_pixbuf_at_size (icon, 48));
+	EEL_CHECK_INTEGER_RESULT (statistics.bytes, get_pixbuf_bytes (scaled));
+
+	/* A new thumbnail */
+	nautilus_file_icon_cache_thumbnail_changed (file);
+	EEL_CHECK_BOOLEAN_RESULT (check_lookup (file, 48, NAUTILUS_FILE_ICON_FLAGS_USE_THUMBNAILS, NULL), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_icon_cache_get_pixbuf_at_size (icon, 48) == NULL, TRUE);
+	EEL_CHECK_INTEGER_RESULT (statistics.bytes, 0);
+
+	nautilus_file_icon_cache_clear ();
+
+	file->details->thumbnail = old_thumbnail;
+	file->details->thumbnail_mtime = old_thumbnail_mtime;
+	file->details->thumbnail_generation = old_thumbnail_generation;
+	g_object_unref (icon);
+	g_object_unref (scaled);
+	g_object_unref (thumbnail);
+	nautilus_file_unref (file);
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
@@ -0,0 +1,67 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-file-icon-cache.h: scaled thumbnails shared by all views.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_FILE_ICON_CACHE_H
+#define NAUTILUS_FILE_ICON_CACHE_H
+
+#include <libnautilus-private/nautilus-file.h>
+#include <libnautilus-private/nautilus-icon-info.h>
+
+/* Themed icons are already shared by nautilus_icon_info_lookup(), but
+ * thumbnails are scaled for each file, size and view. The icons
+ * nautilus_file_get_icon() makes from thumbnails are kept here, for
+ * all views and windows, until the file gets another thumbnail or
+ * the cache needs the room for more recently used icons.
+ */
+
+typedef struct {
+	guint hits;
+	guint misses;
+	guint evictions;
+	guint n_icons;
+	gsize bytes;
+	gsize max_bytes;
+} NautilusFileIconCacheStatistics;
+
+/* Returns a new reference, or NULL if there is no icon for the
+ * current thumbnail of the file.
+ */
+NautilusIconInfo *nautilus_file_icon_cache_lookup             (NautilusFile                    *file,
+								int                              size,
+								NautilusFileIconFlags            flags);
+void              nautilus_file_icon_cache_insert             (NautilusFile                    *file,
+								int                              size,
+								NautilusFileIconFlags            flags,
+								NautilusIconInfo                *icon);
+
+/* nautilus_icon_info_get_pixbuf_at_size() for icons from the cache,
+ * scaled once. Returns NULL for other icons.
+ */
+GdkPixbuf *       nautilus_file_icon_cache_get_pixbuf_at_size (NautilusIconInfo                *icon,
+								int                              size);
+
+/* Call when the file gets another thumbnail, so icons made from the
+ * old one are no longer used.
+ */
+void              nautilus_file_icon_cache_thumbnail_changed  (NautilusFile                    *file);
+void              nautilus_file_icon_cache_clear              (void);
+void              nautilus_file_icon_cache_get_statistics     (NautilusFileIconCacheStatistics *statistics);
+
+#endif /* NAUTILUS_FILE_ICON_CACHE_H */
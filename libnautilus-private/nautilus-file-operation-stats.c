@@ -0,0 +1,310 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-file-operation-stats.c: performance statistics for file operations.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-file-operation-stats.h"
+
+#include "nautilus-debug-log.h"
+
+#define KEY_FILE_GROUP "file operation stats"
+
+/* How many finished operations we remember */
+#define MAX_FINISHED_OPERATIONS 100
+
+/* Bucket 0 counts files handled in less than a microsecond, bucket i
+ * files that took between 2^(i-1) and 2^i microseconds.  The last one
+ * collects everything slower than that (about 4 seconds).
+ */
+#define N_LATENCY_BUCKETS 24
+
+#define NSEC_PER_USEC 1000
+#define NSEC_PER_SEC 1000000000.0
+
+struct NautilusFileOperationStats {
+	int serial;
+	char *kind;
+	char *source_scheme;
+	char *destination_scheme;
+	char *fs_type;
+	GTimeVal start_wall_time;
+	guint64 start_time;
+	guint64 end_time;
+
+	NautilusFileOperationPhase phase;
+	guint64 phase_start_time;
+	guint64 phase_time[NAUTILUS_FILE_OPERATION_N_PHASES];
+
+	int num_files;
+	goffset num_bytes;
+	int path_files[NAUTILUS_FILE_OPERATION_N_PATHS];
+	int latency_histogram[N_LATENCY_BUCKETS];
+};
+
+static const char *phase_keys[NAUTILUS_FILE_OPERATION_N_PHASES] = {
+	NULL,
+	"scanning-time",
+	"transferring-time",
+	"waiting-time"
+};
+
+static const char *path_keys[NAUTILUS_FILE_OPERATION_N_PATHS] = {
+	"copied-files",
+	"moved-files",
+	"renamed-files",
+	"trashed-files",
+	"deleted-files"
+};
+
+static GStaticMutex stats_mutex = G_STATIC_MUTEX_INIT;
+static GQueue *finished_operations;
+static int next_serial = 1;
+
+NautilusFileOperationStats *
+nautilus_file_operation_stats_new (void)
+{
+	return g_new0 (NautilusFileOperationStats, 1);
+}
+
+static void
+stats_free (NautilusFileOperationStats *stats)
+{
+	g_free (stats->kind);
+	g_free (stats->source_scheme);
+	g_free (stats->destination_scheme);
+	g_free (stats->fs_type);
+	g_free (stats);
+}
+
+/* Called at the start of the job, in the job thread. The filesystem
+ * type recorded is the one of the destination if there is one, since
+ * that is usually what limits the transfer.
+ */
+void
+nautilus_file_operation_stats_start (NautilusFileOperationStats *stats,
+				     const char *kind,
+				     GFile *source,
+				     GFile *destination)
+{
+	GFileInfo *info;
+	GFile *fs_file;
+
+	g_assert (stats->kind == NULL);
+
+	stats->kind = g_strdup (kind);
+	if (source != NULL) {
+		stats->source_scheme = g_file_get_uri_scheme (source);
+	}
+	if (destination != NULL) {
+		stats->destination_scheme = g_file_get_uri_scheme (destination);
+	}
+
+	fs_file = destination != NULL ? destination : source;
+	if (fs_file != NULL) {
+		info = g_file_query_filesystem_info (fs_file,
+						     G_FILE_ATTRIBUTE_FILESYSTEM_TYPE,
+						     NULL, NULL);
+		if (info != NULL) {
+			stats->fs_type = g_strdup (g_file_info_get_attribute_string (info,
+										     G_FILE_ATTRIBUTE_FILESYSTEM_TYPE));
+			g_object_unref (info);
+		}
+	}
+
+	g_get_current_time (&stats->start_wall_time);
+	stats->start_time = g_thread_gettime ();
+	stats->phase = NAUTILUS_FILE_OPERATION_PHASE_NONE;
+	stats->phase_start_time = stats->start_time;
+}
+
+/* Returns the previous phase, so that callers can restore it */
+NautilusFileOperationPhase
+nautilus_file_operation_stats_set_phase (NautilusFileOperationStats *stats,
+					 NautilusFileOperationPhase phase)
+{
+	NautilusFileOperationPhase old_phase;
+	guint64 now;
+
+	now = g_thread_gettime ();
+
+	old_phase = stats->phase;
+	stats->phase_time[old_phase] += now - stats->phase_start_time;
+	stats->phase = phase;
+	stats->phase_start_time = now;
+
+	return old_phase;
+}
+
+void
+nautilus_file_operation_stats_file_done (NautilusFileOperationStats *stats,
+					 NautilusFileOperationPath path,
+					 guint64 start_time,
+					 goffset size)
+{
+	guint64 usecs;
+	int bucket;
+
+	usecs = (g_thread_gettime () - start_time) / NSEC_PER_USEC;
+	bucket = 0;
+	while (usecs > 0 && bucket < N_LATENCY_BUCKETS - 1) {
+		usecs >>= 1;
+		bucket++;
+	}
+
+	stats->latency_histogram[bucket]++;
+	stats->path_files[path]++;
+	stats->num_files++;
+	if (size > 0) {
+		stats->num_bytes += size;
+	}
+}
+
+static char *
+stats_to_string (void)
+{
+	GKeyFile *key_file;
+	NautilusFileOperationStats *stats;
+	GList *l;
+	char *group, *time, *value;
+	double seconds;
+	int limits[N_LATENCY_BUCKETS - 1];
+	int i;
+	char *data;
+
+	key_file = g_key_file_new ();
+
+	for (i = 0; i < N_LATENCY_BUCKETS - 1; i++) {
+		limits[i] = 1 << i;
+	}
+	g_key_file_set_integer_list (key_file, KEY_FILE_GROUP,
+				     "latency-bucket-limits-usec",
+				     limits, N_LATENCY_BUCKETS - 1);
+
+	g_static_mutex_lock (&stats_mutex);
+
+	for (l = finished_operations != NULL ? finished_operations->head : NULL;
+	     l != NULL; l = l->next) {
+		stats = l->data;
+
+		group = g_strdup_printf ("operation %d", stats->serial);
+
+		g_key_file_set_string (key_file, group, "kind", stats->kind);
+		time = g_time_val_to_iso8601 (&stats->start_wall_time);
+		g_key_file_set_string (key_file, group, "started", time);
+		g_free (time);
+		if (stats->source_scheme != NULL) {
+			g_key_file_set_string (key_file, group, "source-scheme", stats->source_scheme);
+		}
+		if (stats->destination_scheme != NULL) {
+			g_key_file_set_string (key_file, group, "destination-scheme", stats->destination_scheme);
+		}
+		if (stats->fs_type != NULL) {
+			g_key_file_set_string (key_file, group, "filesystem-type", stats->fs_type);
+		}
+
+		g_key_file_set_double (key_file, group, "duration",
+				       (stats->end_time - stats->start_time) / NSEC_PER_SEC);
+		for (i = 1; i < NAUTILUS_FILE_OPERATION_N_PHASES; i++) {
+			g_key_file_set_double (key_file, group, phase_keys[i],
+					       stats->phase_time[i] / NSEC_PER_SEC);
+		}
+
+		g_key_file_set_integer (key_file, group, "files", stats->num_files);
+		value = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) stats->num_bytes);
+		g_key_file_set_value (key_file, group, "bytes", value);
+		g_free (value);
+
+		/* Rates only count the time spent actually moving data */
+		seconds = stats->phase_time[NAUTILUS_FILE_OPERATION_PHASE_TRANSFERRING] / NSEC_PER_SEC;
+		if (seconds > 0) {
+			g_key_file_set_double (key_file, group, "files-per-second",
+					       stats->num_files / seconds);
+			g_key_file_set_double (key_file, group, "bytes-per-second",
+					       stats->num_bytes / seconds);
+		}
+
+		for (i = 0; i < NAUTILUS_FILE_OPERATION_N_PATHS; i++) {
+			if (stats->path_files[i] != 0) {
+				g_key_file_set_integer (key_file, group, path_keys[i],
+							stats->path_files[i]);
+			}
+		}
+
+		g_key_file_set_integer_list (key_file, group, "latency-histogram",
+					     stats->latency_histogram, N_LATENCY_BUCKETS);
+
+		g_free (group);
+	}
+
+	g_static_mutex_unlock (&stats_mutex);
+
+	data = g_key_file_to_data (key_file, NULL, NULL);
+	g_key_file_free (key_file);
+
+	return data;
+}
+
+/* Called in the main loop once the job is done. Takes ownership of stats. */
+void
+nautilus_file_operation_stats_finish (NautilusFileOperationStats *stats)
+{
+	static gboolean added_section = FALSE;
+
+	if (stats->kind == NULL) {
+		/* Never started, nothing interesting to record */
+		stats_free (stats);
+		return;
+	}
+
+	nautilus_file_operation_stats_set_phase (stats, NAUTILUS_FILE_OPERATION_PHASE_NONE);
+	stats->end_time = stats->phase_start_time;
+
+	g_static_mutex_lock (&stats_mutex);
+
+	if (finished_operations == NULL) {
+		finished_operations = g_queue_new ();
+	}
+
+	stats->serial = next_serial++;
+	g_queue_push_tail (finished_operations, stats);
+	if (g_queue_get_length (finished_operations) > MAX_FINISHED_OPERATIONS) {
+		stats_free (g_queue_pop_head (finished_operations));
+	}
+
+	g_static_mutex_unlock (&stats_mutex);
+
+	if (!added_section) {
+		added_section = TRUE;
+		nautilus_debug_log_add_section ("FILE OPERATION STATS", stats_to_string);
+	}
+}
+
+gboolean
+nautilus_file_operation_stats_dump (const char *filename,
+				    GError **error)
+{
+	char *data;
+	gboolean success;
+
+	data = stats_to_string ();
+	success = g_file_set_contents (filename, data, -1, error);
+	g_free (data);
+
+	return success;
+}
@@ -0,0 +1,67 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-file-operation-stats.h: performance statistics for file operations.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_FILE_OPERATION_STATS_H
+#define NAUTILUS_FILE_OPERATION_STATS_H
+
+#include <gio/gio.h>
+
+typedef enum {
+	NAUTILUS_FILE_OPERATION_PHASE_NONE,
+	NAUTILUS_FILE_OPERATION_PHASE_SCANNING,
+	NAUTILUS_FILE_OPERATION_PHASE_TRANSFERRING,
+	NAUTILUS_FILE_OPERATION_PHASE_WAITING,	/* for the user to answer a dialog */
+	NAUTILUS_FILE_OPERATION_N_PHASES
+} NautilusFileOperationPhase;
+
+/* Which primitive handled a file */
+typedef enum {
+	NAUTILUS_FILE_OPERATION_PATH_COPY,	/* g_file_copy() */
+	NAUTILUS_FILE_OPERATION_PATH_MOVE,	/* g_file_move(), may copy and delete */
+	NAUTILUS_FILE_OPERATION_PATH_RENAME,	/* g_file_move() without fallback */
+	NAUTILUS_FILE_OPERATION_PATH_TRASH,
+	NAUTILUS_FILE_OPERATION_PATH_DELETE,
+	NAUTILUS_FILE_OPERATION_N_PATHS
+} NautilusFileOperationPath;
+
+typedef struct NautilusFileOperationStats NautilusFileOperationStats;
+
+/* A stats object belongs to a single job and is only touched by
+ * the thread running that job, until it is handed over to
+ * nautilus_file_operation_stats_finish() in the main loop.
+ */
+NautilusFileOperationStats *nautilus_file_operation_stats_new       (void);
+void                        nautilus_file_operation_stats_start     (NautilusFileOperationStats *stats,
+								     const char                 *kind,
+								     GFile                      *source,
+								     GFile                      *destination);
+NautilusFileOperationPhase  nautilus_file_operation_stats_set_phase (NautilusFileOperationStats *stats,
+								     NautilusFileOperationPhase  phase);
+void                        nautilus_file_operation_stats_file_done (NautilusFileOperationStats *stats,
+								     NautilusFileOperationPath   path,
+								     guint64                     start_time,
+								     goffset                     size);
+void                        nautilus_file_operation_stats_finish    (NautilusFileOperationStats *stats);
+
+/* Writes the statistics of recently finished operations as a key file */
+gboolean                    nautilus_file_operation_stats_dump      (const char                 *filename,
+								     GError                    **error);
+
+#endif /* NAUTILUS_FILE_OPERATION_STATS_H */
@@ -40,6 +40,7 @@
 
 #include "nautilus-debug-log.h"
 #include "nautilus-file-changes-queue.h"
+#include "nautilus-file-operation-stats.h"
 #include "nautilus-lib-self-check-functions.h"
 
 #include "nautilus-progress-info.h"
@@ -68,6 +69,7 @@
 #include "nautilus-file-utilities.h"
 
 static gboolean confirm_trash_auto_value;
+static int file_operations_per_device_auto_value;
 
 /* TODO: TESTING!!! */
 
@@ -77,6 +79,7 @@ typedef struct {
 	GtkWindow *parent_window;
 	int screen_num;
 	NautilusProgressInfo *progress;
+	NautilusFileOperationStats *stats;
 	GCancellable *cancellable;
 	GHashTable *skip_files;
 	GHashTable *skip_readdir_error;
@@ -85,6 +88,12 @@ typedef struct {
 	gboolean merge_all;
 	gboolean replace_all;
 	gboolean delete_all;
+	/* Scheduling state, see schedule_job() */
+	GIOSchedulerJobFunc job_func;
+	GCancellable *job_cancellable;
+	char *device_ids[2];
+	gboolean holds_devices;
+	gulong cancelled_id;
 } CommonJob;
 
 typedef struct {
@@ -899,6 +908,8 @@ f (const char *format, ...) {
 
 #define op_job_new(__type, parent_window) ((__type *)(init_common (sizeof(__type), parent_window)))
 
+static void unschedule_job (CommonJob *common);
+
 static gpointer
 init_common (gsize job_size,
 	     GtkWindow *parent_window)
@@ -914,6 +925,7 @@ init_common (gsize job_size,
 	}
 	common->progress = nautilus_progress_info_new ();
 	common->cancellable = nautilus_progress_info_get_cancellable (common->progress);
+	common->stats = nautilus_file_operation_stats_new ();
 	common->time = g_timer_new ();
 
 	common->screen_num = 0;
@@ -928,7 +940,10 @@ init_common (gsize job_size,
 static void
 finalize_common (CommonJob *common)
 {
+	unschedule_job (common);
+
 	nautilus_progress_info_finish (common->progress);
+	nautilus_file_operation_stats_finish (common->stats);
 
 	g_timer_destroy (common->time);
 
@@ -996,6 +1011,326 @@ setup_autos (void)
 		setup_autos = TRUE;
 		eel_preferences_add_auto_boolean (NAUTILUS_PREFERENCES_CONFIRM_TRASH,
 						  &confirm_trash_auto_value);
+		eel_preferences_add_auto_integer (NAUTILUS_PREFERENCES_FILE_OPERATIONS_PER_DEVICE,
+						  &file_operations_per_device_auto_value);
+	}
+}
+
+/* Job scheduling
+ *
+ * Jobs that move a lot of data are not pushed to the I/O scheduler
+ * directly. We first look up the filesystem ids of their source and
+ * destination, and only allow file_operations_per_device jobs to run
+ * on any one device at a time. Other jobs touching that device wait
+ * in queued_jobs (in the order they were started by the user) until
+ * a running one finishes, while jobs on unrelated devices start right
+ * away.
+ *
+ * All of this happens in the main thread.
+ */
+
+typedef struct {
+	CommonJob *common;
+	GFile *files[2];
+	char *device_ids[2];
+	int current;
+	gboolean same_device_is_cheap;
+} DeviceLookup;
+
+/* Filesystem id -> number of running jobs using that device */
+static GHashTable *running_device_jobs = NULL;
+static GList *queued_jobs = NULL;
+static guint start_cancelled_jobs_id = 0;
+
+static gboolean
+device_has_room (const char *device_id)
+{
+	int running;
+
+	if (file_operations_per_device_auto_value <= 0) {
+		return TRUE;
+	}
+
+	running = GPOINTER_TO_INT (g_hash_table_lookup (running_device_jobs, device_id));
+	return running < file_operations_per_device_auto_value;
+}
+
+static void
+add_running_device_job (const char *device_id,
+			int delta)
+{
+	int running;
+
+	running = GPOINTER_TO_INT (g_hash_table_lookup (running_device_jobs, device_id));
+	running += delta;
+
+	if (running > 0) {
+		g_hash_table_replace (running_device_jobs,
+				      g_strdup (device_id),
+				      GINT_TO_POINTER (running));
+	} else {
+		g_hash_table_remove (running_device_jobs, device_id);
+	}
+}
+
+static void
+start_job (CommonJob *common,
+	   gboolean hold_devices)
+{
+	int i;
+
+	if (common->cancelled_id != 0) {
+		g_signal_handler_disconnect (common->cancellable,
+					     common->cancelled_id);
+		common->cancelled_id = 0;
+	}
+
+	if (hold_devices) {
+		for (i = 0; i < 2 && common->device_ids[i] != NULL; i++) {
+			add_running_device_job (common->device_ids[i], 1);
+		}
+		common->holds_devices = TRUE;
+	}
+
+	g_io_scheduler_push_job (common->job_func,
+				 common,
+				 NULL, /* destroy notify */
+				 0,
+				 common->job_cancellable);
+}
+
+static void
+start_queued_jobs (void)
+{
+	GHashTable *blocked_devices;
+	GList *l, *next;
+	CommonJob *common;
+	gboolean can_start;
+	int i;
+
+	blocked_devices = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (l = queued_jobs; l != NULL; l = next) {
+		common = l->data;
+		next = l->next;
+
+		can_start = TRUE;
+		for (i = 0; i < 2 && common->device_ids[i] != NULL; i++) {
+			if (g_hash_table_lookup (blocked_devices, common->device_ids[i]) != NULL ||
+			    !device_has_room (common->device_ids[i])) {
+				can_start = FALSE;
+			}
+		}
+
+		if (can_start) {
+			queued_jobs = g_list_delete_link (queued_jobs, l);
+			start_job (common, TRUE);
+			continue;
+		}
+
+		/* Don't let jobs queued later overtake this one on its devices */
+		for (i = 0; i < 2 && common->device_ids[i] != NULL; i++) {
+			g_hash_table_insert (blocked_devices,
+					     common->device_ids[i],
+					     common->device_ids[i]);
+		}
+
+		if (!nautilus_progress_info_get_is_queued (common->progress)) {
+			nautilus_progress_info_set_details (common->progress,
+							    _("Waiting for other operations on the same device to finish"));
+			nautilus_progress_info_queue (common->progress);
+		}
+	}
+
+	g_hash_table_destroy (blocked_devices);
+}
+
+static gboolean
+start_cancelled_jobs (gpointer data)
+{
+	GList *l, *next;
+	CommonJob *common;
+
+	start_cancelled_jobs_id = 0;
+
+	/* Cancelled jobs run right away without taking up a slot,
+	   they will notice the cancellation and clean up */
+	for (l = queued_jobs; l != NULL; l = next) {
+		common = l->data;
+		next = l->next;
+
+		if (g_cancellable_is_cancelled (common->cancellable)) {
+			queued_jobs = g_list_delete_link (queued_jobs, l);
+			start_job (common, FALSE);
+		}
+	}
+
+	/* The cancelled jobs may have been blocking others */
+	start_queued_jobs ();
+
+	return FALSE;
+}
+
+static void
+queued_job_cancelled (GCancellable *cancellable,
+		      CommonJob *common)
+{
+	/* This is called with the progress info lock held, so
+	   don't touch the queue until we get back to the mainloop */
+	if (start_cancelled_jobs_id == 0) {
+		start_cancelled_jobs_id = g_idle_add (start_cancelled_jobs, NULL);
+	}
+}
+
+static void
+device_lookup_done (DeviceLookup *lookup)
+{
+	CommonJob *common;
+	int i, n;
+
+	common = lookup->common;
+
+	if (lookup->same_device_is_cheap &&
+	    lookup->device_ids[0] != NULL &&
+	    eel_strcmp (lookup->device_ids[0], lookup->device_ids[1]) == 0) {
+		/* Just renames, no need to wait for anyone */
+		g_free (lookup->device_ids[0]);
+		g_free (lookup->device_ids[1]);
+	} else {
+		n = 0;
+		for (i = 0; i < 2; i++) {
+			if (lookup->device_ids[i] == NULL) {
+				continue;
+			}
+			if (n > 0 && strcmp (common->device_ids[0], lookup->device_ids[i]) == 0) {
+				g_free (lookup->device_ids[i]);
+				continue;
+			}
+			common->device_ids[n++] = lookup->device_ids[i];
+		}
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (lookup->files[i] != NULL) {
+			g_object_unref (lookup->files[i]);
+		}
+	}
+	g_free (lookup);
+
+	if (g_cancellable_is_cancelled (common->cancellable)) {
+		start_job (common, FALSE);
+		return;
+	}
+
+	common->cancelled_id = g_signal_connect (common->cancellable, "cancelled",
+						 G_CALLBACK (queued_job_cancelled), common);
+
+	queued_jobs = g_list_append (queued_jobs, common);
+	start_queued_jobs ();
+}
+
+static void device_lookup_next (DeviceLookup *lookup);
+
+static void
+device_lookup_callback (GObject *source_object,
+			GAsyncResult *res,
+			gpointer user_data)
+{
+	DeviceLookup *lookup;
+	GFileInfo *info;
+	const char *id;
+
+	lookup = user_data;
+
+	info = g_file_query_info_finish (G_FILE (source_object), res, NULL);
+	if (info != NULL) {
+		id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
+		lookup->device_ids[lookup->current] = g_strdup (id);
+		g_object_unref (info);
+	}
+
+	lookup->current++;
+	device_lookup_next (lookup);
+}
+
+static void
+device_lookup_next (DeviceLookup *lookup)
+{
+	while (lookup->current < 2 &&
+	       lookup->files[lookup->current] == NULL) {
+		lookup->current++;
+	}
+
+	if (lookup->current == 2) {
+		device_lookup_done (lookup);
+		return;
+	}
+
+	g_file_query_info_async (lookup->files[lookup->current],
+				 G_FILE_ATTRIBUTE_ID_FILESYSTEM,
+				 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+				 G_PRIORITY_DEFAULT,
+				 lookup->common->cancellable,
+				 device_lookup_callback,
+				 lookup);
+}
+
+/* Runs job_func in the I/O scheduler once the devices of source
+ * and destination (either may be NULL) have room for another job.
+ * If same_device_is_cheap is set, a job whose source and
+ * destination are on the same device is assumed to only rename
+ * files and is started right away.
+ */
+static void
+schedule_job (CommonJob *common,
+	      GIOSchedulerJobFunc job_func,
+	      GCancellable *cancellable,
+	      GFile *source,
+	      GFile *destination,
+	      gboolean same_device_is_cheap)
+{
+	DeviceLookup *lookup;
+
+	setup_autos ();
+
+	if (running_device_jobs == NULL) {
+		running_device_jobs = g_hash_table_new_full (g_str_hash, g_str_equal,
+							     g_free, NULL);
+	}
+
+	common->job_func = job_func;
+	common->job_cancellable = cancellable;
+
+	lookup = g_new0 (DeviceLookup, 1);
+	lookup->common = common;
+	lookup->same_device_is_cheap = same_device_is_cheap;
+	if (source != NULL) {
+		lookup->files[0] = g_object_ref (source);
+	}
+	if (destination != NULL) {
+		lookup->files[1] = g_object_ref (destination);
+	}
+
+	device_lookup_next (lookup);
+}
+
+static void
+unschedule_job (CommonJob *common)
+{
+	int i;
+
+	if (common->holds_devices) {
+		for (i = 0; i < 2 && common->device_ids[i] != NULL; i++) {
+			add_running_device_job (common->device_ids[i], -1);
+		}
+		common->holds_devices = FALSE;
+
+		start_queued_jobs ();
+	}
+
+	for (i = 0; i < 2; i++) {
+		g_free (common->device_ids[i]);
+		common->device_ids[i] = NULL;
 	}
 }
 
@@ -1106,8 +1441,11 @@ run_simple_dialog_va (CommonJob *job,
 	int res;
 	const char *button_title;
 	GPtrArray *ptr_array;
+	NautilusFileOperationPhase phase;
 
 	g_timer_stop (job->time);
+	phase = nautilus_file_operation_stats_set_phase (job->stats,
+							 NAUTILUS_FILE_OPERATION_PHASE_WAITING);
 	
 	data = g_new0 (RunSimpleDialogData, 1);
 	data->parent_window = &job->parent_window;
@@ -1136,6 +1474,7 @@ run_simple_dialog_va (CommonJob *job,
 	g_free (data->button_titles);
 	g_free (data);
 
+	nautilus_file_operation_stats_set_phase (job->stats, phase);
 	g_timer_continue (job->time);
 
 	g_free (primary_text);
@@ -1446,6 +1785,7 @@ delete_dir (CommonJob *job, GFile *dir,
 	int response;
 	gboolean skip_error;
 	gboolean local_skipped_file;
+	guint64 start_time;
 
 	local_skipped_file = FALSE;
 	
@@ -1543,6 +1883,7 @@ delete_dir (CommonJob *job, GFile *dir,
 	if (!job_aborted (job) &&
 	    /* Don't delete dir if there was a skipped file */
 	    !local_skipped_file) {
+		start_time = g_thread_gettime ();
 		if (!g_file_delete (dir, job->cancellable, &error)) {
 			if (job->skip_all_error) {
 				goto skip;
@@ -1573,6 +1914,9 @@ delete_dir (CommonJob *job, GFile *dir,
 		skip:
 			g_error_free (error);
 		} else {
+			nautilus_file_operation_stats_file_done (job->stats,
+								 NAUTILUS_FILE_OPERATION_PATH_DELETE,
+								 start_time, 0);
 			nautilus_file_changes_queue_file_removed (dir);
 			transfer_info->num_files ++;
 			report_delete_progress (job, source_info, transfer_info);
@@ -1595,6 +1939,7 @@ delete_file (CommonJob *job, GFile *file,
 	GError *error;
 	char *primary, *secondary, *details;
 	int response;
+	guint64 start_time;
 
 	if (should_skip_file (job, file)) {
 		*skipped_file = TRUE;
@@ -1602,7 +1947,11 @@ delete_file (CommonJob *job, GFile *file,
 	}
 	
 	error = NULL;
+	start_time = g_thread_gettime ();
 	if (g_file_delete (file, job->cancellable, &error)) {
+		nautilus_file_operation_stats_file_done (job->stats,
+							 NAUTILUS_FILE_OPERATION_PATH_DELETE,
+							 start_time, 0);
 		nautilus_file_changes_queue_file_removed (file);
 		transfer_info->num_files ++;
 		report_delete_progress (job, source_info, transfer_info);
@@ -1729,11 +2078,15 @@ trash_files (CommonJob *job, GList *files, int *files_skipped)
 	int total_files, files_trashed;
 	char *primary, *secondary, *details;
 	int response;
+	guint64 start_time;
 
 	if (job_aborted (job)) {
 		return;
 	}
 
+	nautilus_file_operation_stats_set_phase (job->stats,
+						 NAUTILUS_FILE_OPERATION_PHASE_TRANSFERRING);
+
 	total_files = g_list_length (files);
 	files_trashed = 0;
 
@@ -1746,6 +2099,7 @@ trash_files (CommonJob *job, GList *files, int *files_skipped)
 		file = l->data;
 
 		error = NULL;
+		start_time = g_thread_gettime ();
 		if (!g_file_trash (file, job->cancellable, &error)) {
 			if (job->skip_all_error) {
 				(*files_skipped)++;
@@ -1791,6 +2145,9 @@ trash_files (CommonJob *job, GList *files, int *files_skipped)
 			g_error_free (error);
 			total_files--;
 		} else {
+			nautilus_file_operation_stats_file_done (job->stats,
+								 NAUTILUS_FILE_OPERATION_PATH_TRASH,
+								 start_time, 0);
 			nautilus_file_changes_queue_file_removed (file);
 			
 			files_trashed++;
@@ -1848,6 +2205,10 @@ delete_job (GIOSchedulerJob *io_job,
 	common->io_job = io_job;
 
 	nautilus_progress_info_start (job->common.progress);
+	nautilus_file_operation_stats_start (common->stats,
+					     job->try_trash ? "trash" : "delete",
+					     job->files != NULL ? job->files->data : NULL,
+					     NULL);
 	
 	to_trash_files = NULL;
 	to_delete_files = NULL;
@@ -1932,11 +2293,12 @@ trash_or_delete_internal (GList                  *files,
 	job->done_callback = done_callback;
 	job->done_callback_data = done_callback_data;
 	
-	g_io_scheduler_push_job (delete_job,
-			   job,
-			   NULL,
-			   0,
-			   NULL);
+	schedule_job ((CommonJob *)job,
+		      delete_job,
+		      NULL,
+		      files != NULL ? files->data : NULL,
+		      NULL,
+		      FALSE);
 }
 
 void
@@ -2606,6 +2968,9 @@ scan_sources (GList *files,
 	memset (source_info, 0, sizeof (SourceInfo));
 	source_info->op = kind;
 
+	nautilus_file_operation_stats_set_phase (job->stats,
+						 NAUTILUS_FILE_OPERATION_PHASE_SCANNING);
+
 	report_count_progress (job, source_info);
 	
 	for (l = files; l != NULL && !job_aborted (job); l = l->next) {
@@ -2618,6 +2983,9 @@ scan_sources (GList *files,
 
 	/* Make sure we report the final count */
 	report_count_progress (job, source_info);
+
+	nautilus_file_operation_stats_set_phase (job->stats,
+						 NAUTILUS_FILE_OPERATION_PHASE_TRANSFERRING);
 }
 
 static void
@@ -3652,6 +4020,7 @@ remove_target_recursively (CommonJob *job,
 typedef struct {
 	CopyMoveJob *job;
 	goffset last_size;
+	goffset total_size;
 	SourceInfo *source_info;
 	TransferInfo *transfer_info;
 } ProgressData;
@@ -3665,6 +4034,7 @@ copy_file_progress_callback (goffset current_num_bytes,
 	goffset new_size;
 
 	pdata = user_data;
+	pdata->total_size = total_num_bytes;
 	
 	new_size = current_num_bytes - pdata->last_size;
 
@@ -3798,6 +4168,7 @@ copy_move_file (CopyMoveJob *copy_job,
 	gboolean res;
 	int unique_name_nr;
 	gboolean handled_invalid_filename;
+	guint64 start_time;
 
 	job = (CommonJob *)copy_job;
 	
@@ -3903,9 +4274,11 @@ copy_move_file (CopyMoveJob *copy_job,
 
 	pdata.job = copy_job;
 	pdata.last_size = 0;
+	pdata.total_size = 0;
 	pdata.source_info = source_info;
 	pdata.transfer_info = transfer_info;
 
+	start_time = g_thread_gettime ();
 	if (copy_job->is_move) {
 		res = g_file_move (src, dest,
 				   flags,
@@ -3923,6 +4296,11 @@ copy_move_file (CopyMoveJob *copy_job,
 	}
 	
 	if (res) {
+		nautilus_file_operation_stats_file_done (job->stats,
+							 copy_job->is_move ?
+							 NAUTILUS_FILE_OPERATION_PATH_MOVE :
+							 NAUTILUS_FILE_OPERATION_PATH_COPY,
+							 start_time, pdata.total_size);
 		transfer_info->num_files ++;
 		report_copy_progress (copy_job, source_info, transfer_info);
 
@@ -4325,6 +4703,10 @@ copy_job (GIOSchedulerJob *io_job,
 	dest_fs_id = NULL;
 	
 	nautilus_progress_info_start (job->common.progress);
+	nautilus_file_operation_stats_start (common->stats,
+					     job->destination != NULL ? "copy" : "duplicate",
+					     job->files != NULL ? job->files->data : NULL,
+					     job->destination);
 	
 	scan_sources (job->files,
 		      &source_info,
@@ -4396,11 +4778,12 @@ nautilus_file_operations_copy (GList *files,
 	}
 	job->debuting_files = g_hash_table_new_full (g_file_hash, (GEqualFunc)g_file_equal, g_object_unref, NULL);
 
-	g_io_scheduler_push_job (copy_job,
-			   job,
-			   NULL, /* destroy notify */
-			   0,
-			   job->common.cancellable);
+	schedule_job (&job->common,
+		      copy_job,
+		      job->common.cancellable,
+		      files != NULL ? files->data : NULL,
+		      target_dir,
+		      FALSE);
 }
 
 static void
@@ -4483,6 +4866,7 @@ move_file_prepare (CopyMoveJob *move_job,
 	GFileCopyFlags flags;
 	MoveFileCopyFallback *fallback;
 	gboolean handled_invalid_filename;
+	guint64 start_time;
 
 	overwrite = FALSE;
 	handled_invalid_filename = *dest_fs_type != NULL;
@@ -4535,12 +4919,16 @@ move_file_prepare (CopyMoveJob *move_job,
 	}
 	
 	error = NULL;
+	start_time = g_thread_gettime ();
 	if (g_file_move (src, dest,
 			 flags,
 			 job->cancellable,
 			 NULL,
 			 NULL,
 			 &error)) {
+		nautilus_file_operation_stats_file_done (job->stats,
+							 NAUTILUS_FILE_OPERATION_PATH_RENAME,
+							 start_time, 0);
 		
 		if (debuting_files) {
 			g_hash_table_replace (debuting_files, g_object_ref (dest), GINT_TO_POINTER (TRUE));
@@ -4853,6 +5241,10 @@ move_job (GIOSchedulerJob *io_job,
 	fallbacks = NULL;
 	
 	nautilus_progress_info_start (job->common.progress);
+	nautilus_file_operation_stats_start (common->stats,
+					     "move",
+					     job->files != NULL ? job->files->data : NULL,
+					     job->destination);
 	
 	verify_destination (&job->common,
 			    job->destination,
@@ -4863,6 +5255,8 @@ move_job (GIOSchedulerJob *io_job,
 	}
 
 	/* This moves all files that we can do without copy + delete */
+	nautilus_file_operation_stats_set_phase (common->stats,
+						 NAUTILUS_FILE_OPERATION_PHASE_TRANSFERRING);
 	move_files_prepare (job, dest_fs_id, &dest_fs_type, &fallbacks);
 	if (job_aborted (common)) {
 		goto aborted;
@@ -4936,11 +5330,12 @@ nautilus_file_operations_move (GList *files,
 	}
 	job->debuting_files = g_hash_table_new_full (g_file_hash, (GEqualFunc)g_file_equal, g_object_unref, NULL);
 
-	g_io_scheduler_push_job (move_job,
-				 job,
-				 NULL, /* destroy notify */
-				 0,
-				 job->common.cancellable);
+	schedule_job (&job->common,
+		      move_job,
+		      job->common.cancellable,
+		      files != NULL ? files->data : NULL,
+		      target_dir,
+		      TRUE);
 }
 
 static void
@@ -5270,11 +5665,12 @@ nautilus_file_operations_duplicate (GList *files,
 	}
 	job->debuting_files = g_hash_table_new_full (g_file_hash, (GEqualFunc)g_file_equal, g_object_unref, NULL);
 
-	g_io_scheduler_push_job (copy_job,
-			   job,
-			   NULL, /* destroy notify */
-			   0,
-			   job->common.cancellable);
+	schedule_job (&job->common,
+		      copy_job,
+		      job->common.cancellable,
+		      files != NULL ? files->data : NULL,
+		      NULL,
+		      FALSE);
 }
 
 static gboolean
@@ -55,6 +55,38 @@ typedef struct {
 	char emblem_keywords[1];
 } NautilusFileSortByEmblemCache;
 
+/* Fields that most files never use. They are kept out of
+ * NautilusFileDetails, and the block holding them is only allocated
+ * the first time one of them is set, since there can be a very large
+ * number of NautilusFile objects.
+ */
+typedef struct {
+	GList *mime_list; /* If this is a directory, the list of MIME types in it. */
+	char *top_left_text;
+
+	guint deep_directory_count;
+	guint deep_file_count;
+	guint deep_unreadable_count;
+	goffset deep_size;
+
+	/* Info you might get from a link (.desktop, .directory or nautilus link) */
+	char *custom_icon;
+	char *activation_uri;
+
+	char *trash_orig_path;
+
+	/* The following is for file operations in progress. */
+	GList *operations_in_progress;
+
+	/* Emblems provided by extensions */
+	GList *extension_emblems;
+	GList *pending_extension_emblems;
+
+	/* Attributes provided by extensions */
+	GHashTable *extension_attributes;
+	GHashTable *pending_extension_attributes;
+} NautilusFileRareDetails;
+
 struct NautilusFileDetails
 {
 	NautilusDirectory *directory;
@@ -88,44 +120,28 @@ struct NautilusFileDetails
 	
 	eel_ref_str mime_type;
 	
-	char *selinux_context;
-	char *description;
+	/* Usually shared by many files, so these are interned */
+	eel_ref_str selinux_context;
+	eel_ref_str description;
 	
 	GError *get_info_error;
 	
 	guint directory_count;
 
-	guint deep_directory_count;
-	guint deep_file_count;
-	guint deep_unreadable_count;
-	goffset deep_size;
-
 	GIcon *icon;
 	
 	char *thumbnail_path;
 	GdkPixbuf *thumbnail;
 	time_t thumbnail_mtime;
+	guint thumbnail_generation; /* see nautilus-file-icon-cache.h */
 	
-	GList *mime_list; /* If this is a directory, the list of MIME types in it. */
-	char *top_left_text;
-
-	/* Info you might get from a link (.desktop, .directory or nautilus link) */
-	char *custom_icon;
-	char *activation_uri;
-
 	/* used during DND, for checking whether source and destination are on
 	 * the same file system.
 	 */
 	eel_ref_str filesystem_id;
 
-	char *trash_orig_path;
-
-	/* The following is for file operations in progress. Since
-	 * there are normally only a few of these, we can move them to
-	 * a separate hash table or something if required to keep the
-	 * file objects small.
-	 */
-	GList *operations_in_progress;
+	/* NULL until one of the rarely used fields is set */
+	NautilusFileRareDetails *rare;
 
 	/* We use this to cache automatic emblems and emblem keywords
 	   to speed up compare_by_emblems. */
@@ -134,14 +150,6 @@ struct NautilusFileDetails
 	/* NautilusInfoProviders that need to be run for this file */
 	GList *pending_info_providers;
 
-	/* Emblems provided by extensions */
-	GList *extension_emblems;
-	GList *pending_extension_emblems;
-
-	/* Attributes provided by extensions */
-	GHashTable *extension_attributes;
-	GHashTable *pending_extension_attributes;
-
 	GHashTable *metadata;
 
 	/* Mount for mountpoint or the references GMount for a "mountable" */
@@ -228,6 +236,10 @@ struct NautilusFileDetails
 	eel_boolean_bit filesystem_info_is_up_to_date : 1;
 };
 
+/* Reads a rarely used field, which is 0 or NULL if it was never set */
+#define NAUTILUS_FILE_RARE_DETAIL(file, field) \
+	((file)->details->rare != NULL ? (file)->details->rare->field : 0)
+
 typedef struct {
 	NautilusFile *file;
 	GCancellable *cancellable;
@@ -243,6 +255,8 @@ typedef struct {
 NautilusFile *nautilus_file_new_from_info                  (NautilusDirectory      *directory,
 							    GFileInfo              *info);
 void          nautilus_file_emit_changed                   (NautilusFile           *file);
+NautilusFileRareDetails *
+              nautilus_file_ensure_rare_details            (NautilusFile           *file);
 void          nautilus_file_mark_gone                      (NautilusFile           *file);
 char *        nautilus_extract_top_left_text               (const char             *text,
 							    gboolean                large,
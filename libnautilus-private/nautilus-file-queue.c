@@ -82,6 +82,25 @@ nautilus_file_queue_dequeue (NautilusFileQueue *queue)
 	return file;
 }
 
+void
+nautilus_file_queue_move_to_head (NautilusFileQueue *queue,
+				  NautilusFile      *file)
+{
+	GList *link;
+
+	link = g_hash_table_lookup (queue->item_to_link_map, file);
+
+	if (link == NULL || link == queue->head) {
+		return;
+	}
+
+	if (link == queue->tail) {
+		queue->tail = queue->tail->prev;
+	}
+
+	queue->head = g_list_remove_link (queue->head, link);
+	queue->head = g_list_concat (link, queue->head);
+}
 
 void
 nautilus_file_queue_remove (NautilusFileQueue *queue,
@@ -123,3 +142,9 @@ nautilus_file_queue_is_empty (NautilusFileQueue *queue)
 {
 	return (queue->head == NULL);
 }
+
+GList *
+nautilus_file_queue_peek_head_link (NautilusFileQueue *queue)
+{
+	return queue->head;
+}
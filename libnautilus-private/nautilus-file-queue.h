@@ -40,6 +40,10 @@ void               nautilus_file_queue_enqueue  (NautilusFileQueue *queue,
  */
 NautilusFile *     nautilus_file_queue_dequeue  (NautilusFileQueue *queue);
 
+/* Move a file to the head of the queue, if it is in the queue */
+void               nautilus_file_queue_move_to_head (NautilusFileQueue *queue,
+						     NautilusFile      *file);
+
 /* Remove a file from an arbitrary point in the queue in constant time. */
 void               nautilus_file_queue_remove   (NautilusFileQueue *queue,
 						 NautilusFile      *file);
@@ -49,4 +53,9 @@ NautilusFile *     nautilus_file_queue_head     (NautilusFileQueue *queue);
 
 gboolean           nautilus_file_queue_is_empty (NautilusFileQueue *queue);
 
+/* Get the queued files, head first, without copying them. The list
+ * must not be kept across changes to the queue.
+ */
+GList *            nautilus_file_queue_peek_head_link (NautilusFileQueue *queue);
+
 #endif /* NAUTILUS_FILE_CHANGES_QUEUE_H */
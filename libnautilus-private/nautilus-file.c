@@ -32,12 +32,14 @@
 #include "nautilus-desktop-directory-file.h"
 #include "nautilus-desktop-icon-file.h"
 #include "nautilus-file-attributes.h"
+#include "nautilus-file-icon-cache.h"
 #include "nautilus-file-private.h"
 #include "nautilus-file-operations.h"
 #include "nautilus-file-utilities.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-lib-self-check-functions.h"
 #include "nautilus-link.h"
+#include "nautilus-merge-sort.h"
 #include "nautilus-metadata.h"
 #include "nautilus-module.h"
 #include "nautilus-search-directory.h"
@@ -420,9 +422,9 @@ nautilus_file_clear_info (NautilusFile *file)
 	}
 
 	if (!file->details->got_custom_activation_uri &&
-	    file->details->activation_uri != NULL) {
-		g_free (file->details->activation_uri);
-		file->details->activation_uri = NULL;
+	    NAUTILUS_FILE_RARE_DETAIL (file, activation_uri) != NULL) {
+		g_free (file->details->rare->activation_uri);
+		file->details->rare->activation_uri = NULL;
 	}
 	
 	if (file->details->icon != NULL) {
@@ -469,9 +471,9 @@ nautilus_file_clear_info (NautilusFile *file)
 	file->details->symlink_name = NULL;
 	eel_ref_str_unref (file->details->mime_type);
 	file->details->mime_type = NULL;
-	g_free (file->details->selinux_context);
+	eel_ref_str_unref (file->details->selinux_context);
 	file->details->selinux_context = NULL;
-	g_free (file->details->description);
+	eel_ref_str_unref (file->details->description);
 	file->details->description = NULL;
 	eel_ref_str_unref (file->details->owner);
 	file->details->owner = NULL;
@@ -745,6 +747,39 @@ nautilus_file_is_self_owned (NautilusFile *file)
 	return file->details->directory->details->as_file == file;
 }
 
+NautilusFileRareDetails *
+nautilus_file_ensure_rare_details (NautilusFile *file)
+{
+	if (file->details->rare == NULL) {
+		file->details->rare = g_slice_new0 (NautilusFileRareDetails);
+	}
+
+	return file->details->rare;
+}
+
+static void
+rare_details_free (NautilusFileRareDetails *rare)
+{
+	eel_g_list_free_deep (rare->mime_list);
+	g_free (rare->top_left_text);
+	g_free (rare->custom_icon);
+	g_free (rare->activation_uri);
+	g_free (rare->trash_orig_path);
+
+	eel_g_list_free_deep (rare->pending_extension_emblems);
+	eel_g_list_free_deep (rare->extension_emblems);	
+
+	if (rare->pending_extension_attributes) {
+		g_hash_table_destroy (rare->pending_extension_attributes);
+	}
+	
+	if (rare->extension_attributes) {
+		g_hash_table_destroy (rare->extension_attributes);
+	}
+
+	g_slice_free (NautilusFileRareDetails, rare);
+}
+
 static void
 finalize (GObject *object)
 {
@@ -754,7 +789,7 @@ finalize (GObject *object)
 
 	file = NAUTILUS_FILE (object);
 
-	g_assert (file->details->operations_in_progress == NULL);
+	g_assert (NAUTILUS_FILE_RARE_DETAIL (file, operations_in_progress) == NULL);
 
 	if (file->details->is_thumbnailing) {
 		uri = nautilus_file_get_uri (file);
@@ -794,11 +829,8 @@ finalize (GObject *object)
 	eel_ref_str_unref (file->details->owner);
 	eel_ref_str_unref (file->details->owner_real);
 	eel_ref_str_unref (file->details->group);
-	g_free (file->details->selinux_context);
-	g_free (file->details->description);
-	g_free (file->details->top_left_text);
-	g_free (file->details->custom_icon);
-	g_free (file->details->activation_uri);
+	eel_ref_str_unref (file->details->selinux_context);
+	eel_ref_str_unref (file->details->description);
 	g_free (file->details->compare_by_emblem_cache);
 
 	if (file->details->thumbnail) {
@@ -811,18 +843,10 @@ finalize (GObject *object)
 
 	eel_ref_str_unref (file->details->filesystem_id);
 	
-	eel_g_list_free_deep (file->details->mime_list);
-
-	eel_g_list_free_deep (file->details->pending_extension_emblems);
-	eel_g_list_free_deep (file->details->extension_emblems);	
 	eel_g_object_list_free (file->details->pending_info_providers);
 
-	if (file->details->pending_extension_attributes) {
-		g_hash_table_destroy (file->details->pending_extension_attributes);
-	}
-	
-	if (file->details->extension_attributes) {
-		g_hash_table_destroy (file->details->extension_attributes);
+	if (file->details->rare != NULL) {
+		rare_details_free (file->details->rare);
 	}
 
 	G_OBJECT_CLASS (nautilus_file_parent_class)->finalize (object);
@@ -1586,6 +1610,7 @@ nautilus_file_operation_new (NautilusFile *file,
 			     gpointer callback_data)
 {
 	NautilusFileOperation *op;
+	NautilusFileRareDetails *rare;
 
 	op = g_new0 (NautilusFileOperation, 1);
 	op->file = nautilus_file_ref (file);
@@ -1593,8 +1618,9 @@ nautilus_file_operation_new (NautilusFile *file,
 	op->callback_data = callback_data;
 	op->cancellable = g_cancellable_new ();
 
-	op->file->details->operations_in_progress = g_list_prepend
-		(op->file->details->operations_in_progress, op);
+	rare = nautilus_file_ensure_rare_details (op->file);
+	rare->operations_in_progress = g_list_prepend
+		(rare->operations_in_progress, op);
 
 	return op;
 }
@@ -1602,8 +1628,8 @@ nautilus_file_operation_new (NautilusFile *file,
 static void
 nautilus_file_operation_remove (NautilusFileOperation *op)
 {
-	op->file->details->operations_in_progress = g_list_remove
-		(op->file->details->operations_in_progress, op);
+	op->file->details->rare->operations_in_progress = g_list_remove
+		(op->file->details->rare->operations_in_progress, op);
 }
 
 void
@@ -1899,7 +1925,7 @@ nautilus_file_rename_in_progress (NautilusFile *file)
 	GList *node;
 	NautilusFileOperation *op;
 
-	for (node = file->details->operations_in_progress; node != NULL; node = node->next) {
+	for (node = NAUTILUS_FILE_RARE_DETAIL (file, operations_in_progress); node != NULL; node = node->next) {
 		op = node->data;
 		if (op->is_rename) {
 			return TRUE;
@@ -1916,7 +1942,7 @@ nautilus_file_cancel (NautilusFile *file,
 	GList *node, *next;
 	NautilusFileOperation *op;
 
-	for (node = file->details->operations_in_progress; node != NULL; node = next) {
+	for (node = NAUTILUS_FILE_RARE_DETAIL (file, operations_in_progress); node != NULL; node = next) {
 		next = node->next;
 		op = node->data;
 
@@ -2023,6 +2049,7 @@ update_info_internal (NautilusFile *file,
 	const char *trash_orig_path;
 	const char *group, *owner, *owner_real;
 	gboolean free_owner, free_group;
+	NautilusFileRareDetails *rare;
 	
 	if (file->details->is_gone) {
 		return FALSE;
@@ -2062,18 +2089,19 @@ update_info_internal (NautilusFile *file,
 	if (!file->details->got_custom_activation_uri) {
 		activation_uri = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_TARGET_URI);
 		if (activation_uri == NULL) {
-			if (file->details->activation_uri) {
-				g_free (file->details->activation_uri);
-				file->details->activation_uri = NULL;
+			if (NAUTILUS_FILE_RARE_DETAIL (file, activation_uri)) {
+				g_free (file->details->rare->activation_uri);
+				file->details->rare->activation_uri = NULL;
 				changed = TRUE;
 			}
 		} else {
-			old_activation_uri = file->details->activation_uri;
-			file->details->activation_uri = g_strdup (activation_uri);
+			rare = nautilus_file_ensure_rare_details (file);
+			old_activation_uri = rare->activation_uri;
+			rare->activation_uri = g_strdup (activation_uri);
 			
 			if (old_activation_uri) {
 				if (strcmp (old_activation_uri,
-					    file->details->activation_uri) != 0) {
+					    rare->activation_uri) != 0) {
 					changed = TRUE;
 				}
 				g_free (old_activation_uri);
@@ -2356,17 +2384,17 @@ update_info_internal (NautilusFile *file,
 	}
 	
 	selinux_context = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_SELINUX_CONTEXT);
-	if (eel_strcmp (file->details->selinux_context, selinux_context) != 0) {
+	if (eel_strcmp (eel_ref_str_peek (file->details->selinux_context), selinux_context) != 0) {
 		changed = TRUE;
-		g_free (file->details->selinux_context);
-		file->details->selinux_context = g_strdup (selinux_context);
+		eel_ref_str_unref (file->details->selinux_context);
+		file->details->selinux_context = eel_ref_str_get_unique (selinux_context);
 	}
 	
 	description = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_DESCRIPTION);
-	if (eel_strcmp (file->details->description, description) != 0) {
+	if (eel_strcmp (eel_ref_str_peek (file->details->description), description) != 0) {
 		changed = TRUE;
-		g_free (file->details->description);
-		file->details->description = g_strdup (description);
+		eel_ref_str_unref (file->details->description);
+		file->details->description = eel_ref_str_get_unique (description);
 	}
 
 	filesystem_id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
@@ -2377,10 +2405,11 @@ update_info_internal (NautilusFile *file,
 	}
 
 	trash_orig_path = g_file_info_get_attribute_byte_string (info, "trash::orig-path");
-	if (eel_strcmp (file->details->trash_orig_path, trash_orig_path) != 0) {
+	if (eel_strcmp (NAUTILUS_FILE_RARE_DETAIL (file, trash_orig_path), trash_orig_path) != 0) {
 		changed = TRUE;
-		g_free (file->details->trash_orig_path);
-		file->details->trash_orig_path = g_strdup (trash_orig_path);
+		rare = nautilus_file_ensure_rare_details (file);
+		g_free (rare->trash_orig_path);
+		rare->trash_orig_path = g_strdup (trash_orig_path);
 	}
 
 	changed |=
@@ -2464,7 +2493,11 @@ update_name_internal (NautilusFile *file,
 	}
 	
 	eel_ref_str_unref (file->details->name);
-	file->details->name = eel_ref_str_new (name);
+	if (eel_strcmp (eel_ref_str_peek (file->details->display_name), name) == 0) {
+		file->details->name = eel_ref_str_ref (file->details->display_name);
+	} else {
+		file->details->name = eel_ref_str_new (name);
+	}
 
 	if (!file->details->got_custom_display_name) {
 		nautilus_file_clear_display_name (file);
@@ -3165,6 +3198,206 @@ nautilus_file_compare_for_sort (NautilusFile *file_1,
 	return result;
 }
 
+/* What is computed for each file when sorting, see
+ * nautilus_file_sort_keys_new().
+ */
+typedef enum {
+	SORT_KEY_NONE,		/* nautilus_file_compare_for_sort() is cheap enough */
+	SORT_KEY_TYPE,		/* collation key of the type string */
+	SORT_KEY_DATE,		/* a date that isn't a sort type */
+	SORT_KEY_STRING		/* collation key of the attribute string */
+} SortKeyKind;
+
+typedef struct {
+	char *collation_key;	/* NULL if there is no string to compare */
+	time_t time;
+	gboolean time_known;
+} SortKey;
+
+struct NautilusFileSortKeys {
+	SortKeyKind kind;
+	NautilusFileSortType sort_type;
+	GQuark attribute;
+	NautilusDateType date_type;
+	gboolean directories_first;
+	gboolean reversed;
+	GHashTable *keys;	/* NautilusFile -> SortKey */
+};
+
+static SortKeyKind
+get_sort_key_kind (NautilusFileSortType sort_type)
+{
+	return sort_type == NAUTILUS_FILE_SORT_BY_TYPE ? SORT_KEY_TYPE : SORT_KEY_NONE;
+}
+
+static void
+sort_keys_init (NautilusFileSortKeys *keys,
+		GQuark attribute,
+		gboolean directories_first,
+		gboolean reversed)
+{
+	keys->attribute = attribute;
+	keys->directories_first = directories_first;
+	keys->reversed = reversed;
+	keys->keys = NULL;
+
+	/* Convert certain attributes into NautilusFileSortTypes and use
+	 * nautilus_file_compare_for_sort()
+	 */
+	keys->sort_type = NAUTILUS_FILE_SORT_NONE;
+	if (attribute == 0 || attribute == attribute_name_q) {
+		keys->sort_type = NAUTILUS_FILE_SORT_BY_DISPLAY_NAME;
+	} else if (attribute == attribute_size_q) {
+		keys->sort_type = NAUTILUS_FILE_SORT_BY_SIZE;
+	} else if (attribute == attribute_type_q) {
+		keys->sort_type = NAUTILUS_FILE_SORT_BY_TYPE;
+	} else if (attribute == attribute_modification_date_q || attribute == attribute_date_modified_q) {
+		keys->sort_type = NAUTILUS_FILE_SORT_BY_MTIME;
+	} else if (attribute == attribute_accessed_date_q || attribute == attribute_date_accessed_q) {
+		keys->sort_type = NAUTILUS_FILE_SORT_BY_ATIME;
+	} else if (attribute == attribute_emblems_q) {
+		keys->sort_type = NAUTILUS_FILE_SORT_BY_EMBLEMS;
+	}
+
+	if (keys->sort_type != NAUTILUS_FILE_SORT_NONE) {
+		keys->kind = get_sort_key_kind (keys->sort_type);
+	} else if (attribute == attribute_date_changed_q) {
+		keys->kind = SORT_KEY_DATE;
+		keys->date_type = NAUTILUS_DATE_TYPE_CHANGED;
+	} else if (attribute == attribute_date_permissions_q) {
+		keys->kind = SORT_KEY_DATE;
+		keys->date_type = NAUTILUS_DATE_TYPE_PERMISSIONS_CHANGED;
+	} else {
+		/* it is a normal attribute, compare by strings */
+		keys->kind = SORT_KEY_STRING;
+	}
+}
+
+static void
+sort_key_fill (NautilusFileSortKeys *keys,
+	       NautilusFile *file,
+	       SortKey *key)
+{
+	char *value;
+
+	key->collation_key = NULL;
+	key->time = 0;
+	key->time_known = FALSE;
+
+	switch (keys->kind) {
+	case SORT_KEY_TYPE:
+		/* Directories are sorted without their type string */
+		if (!nautilus_file_is_directory (file)) {
+			value = nautilus_file_get_type_as_string (file);
+			key->collation_key = g_utf8_collate_key (value != NULL ? value : "", -1);
+			g_free (value);
+		}
+		break;
+	case SORT_KEY_DATE:
+		key->time_known = nautilus_file_get_date (file, keys->date_type, &key->time);
+		break;
+	case SORT_KEY_STRING:
+		value = nautilus_file_get_string_attribute_q (file, keys->attribute);
+		if (value != NULL) {
+			key->collation_key = g_utf8_collate_key (value, -1);
+			g_free (value);
+		}
+		break;
+	case SORT_KEY_NONE:
+		break;
+	}
+}
+
+static void
+sort_key_clear (SortKey *key)
+{
+	g_free (key->collation_key);
+}
+
+static void
+sort_key_free (gpointer data)
+{
+	SortKey *key;
+
+	key = data;
+	sort_key_clear (key);
+	g_slice_free (SortKey, key);
+}
+
+/* Same order as compare_by_type() */
+static int
+compare_type_keys (NautilusFile *file_1, const SortKey *key_1,
+		   NautilusFile *file_2, const SortKey *key_2)
+{
+	gboolean is_directory_1;
+	gboolean is_directory_2;
+
+	is_directory_1 = nautilus_file_is_directory (file_1);
+	is_directory_2 = nautilus_file_is_directory (file_2);
+
+	if (is_directory_1 && is_directory_2) {
+		return 0;
+	}
+
+	if (is_directory_1) {
+		return -1;
+	}
+
+	if (is_directory_2) {
+		return +1;
+	}
+
+	return strcmp (key_1->collation_key, key_2->collation_key);
+}
+
+static int
+compare_sort_keys (NautilusFileSortKeys *keys,
+		   NautilusFile *file_1, const SortKey *key_1,
+		   NautilusFile *file_2, const SortKey *key_2)
+{
+	int result;
+
+	result = nautilus_file_compare_for_sort_internal (file_1, file_2,
+							  keys->directories_first,
+							  keys->reversed);
+	if (result != 0) {
+		return result;
+	}
+
+	switch (keys->kind) {
+	case SORT_KEY_TYPE:
+		result = compare_type_keys (file_1, key_1, file_2, key_2);
+		if (result == 0) {
+			result = compare_by_full_path (file_1, file_2);
+		}
+		break;
+	case SORT_KEY_DATE:
+		/* Files without the date go first */
+		if (key_1->time_known != key_2->time_known) {
+			result = key_1->time_known ? +1 : -1;
+		} else if (key_1->time < key_2->time) {
+			result = -1;
+		} else if (key_1->time > key_2->time) {
+			result = +1;
+		}
+		break;
+	case SORT_KEY_STRING:
+		if (key_1->collation_key != NULL && key_2->collation_key != NULL) {
+			result = strcmp (key_1->collation_key, key_2->collation_key);
+		}
+		break;
+	case SORT_KEY_NONE:
+		g_assert_not_reached ();
+		break;
+	}
+
+	if (keys->reversed) {
+		result = -result;
+	}
+
+	return result;
+}
+
 int
 nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile                   *file_1,
 						 NautilusFile                   *file_2,
@@ -3172,72 +3405,64 @@ nautilus_file_compare_for_sort_by_attribute_q   (NautilusFile
 						 gboolean                        directories_first,
 						 gboolean                        reversed)
 {
+	NautilusFileSortKeys keys;
+	SortKey key_1, key_2;
 	int result;
 
 	if (file_1 == file_2) {
 		return 0;
 	}
 
-	/* Convert certain attributes into NautilusFileSortTypes and use
-	 * nautilus_file_compare_for_sort()
-	 */
-	if (attribute == 0 || attribute == attribute_name_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_DISPLAY_NAME,
-						       directories_first,
-						       reversed);
-	} else if (attribute == attribute_size_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_SIZE,
-						       directories_first,
-						       reversed);
-	} else if (attribute == attribute_type_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_TYPE,
-						       directories_first,
-						       reversed);
-	} else if (attribute == attribute_modification_date_q || attribute == attribute_date_modified_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_MTIME,
-						       directories_first,
-						       reversed);
-        } else if (attribute == attribute_accessed_date_q || attribute == attribute_date_accessed_q) {
-		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_ATIME,
-						       directories_first,
-						       reversed);
-	} else if (attribute == attribute_emblems_q) {
+	sort_keys_init (&keys, attribute, directories_first, reversed);
+
+	if (keys.sort_type != NAUTILUS_FILE_SORT_NONE) {
 		return nautilus_file_compare_for_sort (file_1, file_2,
-						       NAUTILUS_FILE_SORT_BY_EMBLEMS,
+						       keys.sort_type,
 						       directories_first,
 						       reversed);
 	}
-	
-	/* it is a normal attribute, compare by strings */
 
-	result = nautilus_file_compare_for_sort_internal (file_1, file_2, directories_first, reversed);
-	
-	if (result == 0) {
-		char *value_1;
-		char *value_2;
-		
-		value_1 = nautilus_file_get_string_attribute_q (file_1, 
-								attribute);
-		value_2 = nautilus_file_get_string_attribute_q (file_2, 
-								attribute);
-
-		if (value_1 != NULL && value_2 != NULL) {
-			result = strcmp (value_1, value_2);
-		}
+	if (keys.kind == SORT_KEY_STRING) {
+		/* Collation keys only pay off when a file is compared
+		 * many times, as in nautilus_file_sort_keys_sort().
+		 * g_utf8_collate() gives the same order.
+		 */
+		result = nautilus_file_compare_for_sort_internal (file_1, file_2,
+								  directories_first,
+								  reversed);
+		if (result == 0) {
+			char *value_1;
+			char *value_2;
+
+			value_1 = nautilus_file_get_string_attribute_q (file_1,
+									attribute);
+			value_2 = nautilus_file_get_string_attribute_q (file_2,
+									attribute);
+
+			if (value_1 != NULL && value_2 != NULL) {
+				result = g_utf8_collate (value_1, value_2);
+			}
 
-		g_free (value_1);
-		g_free (value_2);
+			g_free (value_1);
+			g_free (value_2);
 
-		if (reversed) {
-			result = -result;
+			if (reversed) {
+				result = -result;
+			}
 		}
+
+		return result;
 	}
-	
+
+	/* Dates are cheap to get */
+	sort_key_fill (&keys, file_1, &key_1);
+	sort_key_fill (&keys, file_2, &key_2);
+
+	result = compare_sort_keys (&keys, file_1, &key_1, file_2, &key_2);
+
+	sort_key_clear (&key_1);
+	sort_key_clear (&key_2);
+
 	return result;
 }
 
@@ -3254,6 +3479,226 @@ nautilus_file_compare_for_sort_by_attribute     (NautilusFile
 							      reversed);
 }
 
+/**
+ * nautilus_file_sort_keys_new:
+ * @attribute: The attribute to sort by, as for
+ * nautilus_file_compare_for_sort_by_attribute_q().
+ * @directories_first: Put all directories before any non-directories
+ * @reversed: Reverse the order of the items, except that
+ * the directories_first flag is still respected.
+ * 
+ * Sorting many files by an attribute with
+ * nautilus_file_compare_for_sort_by_attribute_q() gets and formats
+ * the attribute of both files for every comparison. The keys instead
+ * remember what is compared for each file the first time they see
+ * it, so nautilus_file_sort_keys_compare() gives the same order with
+ * one computation per file.
+ *
+ * The keys don't notice changes to the files, so use them for one
+ * sort and free them again. The files must outlive the keys.
+ *
+ * Return value: keys to be freed with nautilus_file_sort_keys_free().
+ **/
+NautilusFileSortKeys *
+nautilus_file_sort_keys_new (GQuark attribute,
+			     gboolean directories_first,
+			     gboolean reversed)
+{
+	NautilusFileSortKeys *keys;
+
+	keys = g_new (NautilusFileSortKeys, 1);
+	sort_keys_init (keys, attribute, directories_first, reversed);
+	if (keys->kind != SORT_KEY_NONE) {
+		keys->keys = g_hash_table_new_full (NULL, NULL, NULL, sort_key_free);
+	}
+
+	return keys;
+}
+
+/**
+ * nautilus_file_sort_keys_new_for_sort_type:
+ * 
+ * Like nautilus_file_sort_keys_new(), for the order of
+ * nautilus_file_compare_for_sort().
+ **/
+NautilusFileSortKeys *
+nautilus_file_sort_keys_new_for_sort_type (NautilusFileSortType sort_type,
+					   gboolean directories_first,
+					   gboolean reversed)
+{
+	NautilusFileSortKeys *keys;
+
+	keys = nautilus_file_sort_keys_new (0, directories_first, reversed);
+	keys->sort_type = sort_type;
+	keys->kind = get_sort_key_kind (sort_type);
+	if (keys->kind != SORT_KEY_NONE) {
+		keys->keys = g_hash_table_new_full (NULL, NULL, NULL, sort_key_free);
+	}
+
+	return keys;
+}
+
+void
+nautilus_file_sort_keys_free (NautilusFileSortKeys *keys)
+{
+	if (keys->keys != NULL) {
+		g_hash_table_destroy (keys->keys);
+	}
+	g_free (keys);
+}
+
+static const SortKey *
+sort_keys_lookup (NautilusFileSortKeys *keys, NautilusFile *file)
+{
+	SortKey *key;
+
+	key = g_hash_table_lookup (keys->keys, file);
+	if (key == NULL) {
+		key = g_slice_new (SortKey);
+		sort_key_fill (keys, file, key);
+		g_hash_table_insert (keys->keys, file, key);
+	}
+
+	return key;
+}
+
+int
+nautilus_file_sort_keys_compare (NautilusFileSortKeys *keys,
+				 NautilusFile *file_1,
+				 NautilusFile *file_2)
+{
+	if (file_1 == file_2) {
+		return 0;
+	}
+
+	if (keys->kind == SORT_KEY_NONE) {
+		return nautilus_file_compare_for_sort (file_1, file_2,
+						       keys->sort_type,
+						       keys->directories_first,
+						       keys->reversed);
+	}
+
+	return compare_sort_keys (keys,
+				  file_1, sort_keys_lookup (keys, file_1),
+				  file_2, sort_keys_lookup (keys, file_2));
+}
+
+typedef struct {
+	SortKey key;
+	NautilusFile *file;
+	gpointer item;
+} SortItem;
+
+/* Computes what comparing the file needs, including what the
+ * comparisons would otherwise compute the first time they need it.
+ */
+static void
+sort_item_prepare (NautilusFileSortKeys *keys, SortItem *sort_item)
+{
+	sort_key_fill (keys, sort_item->file, &sort_item->key);
+
+	nautilus_file_peek_display_name (sort_item->file);
+	if (keys->kind == SORT_KEY_NONE &&
+	    keys->sort_type == NAUTILUS_FILE_SORT_BY_EMBLEMS) {
+		fill_emblem_cache_if_needed (sort_item->file);
+	}
+}
+
+/* Whether comparing prepared files in the same directory only reads
+ * from them, so the comparisons can run on several threads.
+ */
+static gboolean
+sort_keys_compare_only_reads (NautilusFileSortKeys *keys)
+{
+	/* Directory item counts come from a class method */
+	return keys->kind != SORT_KEY_NONE ||
+		keys->sort_type != NAUTILUS_FILE_SORT_BY_SIZE;
+}
+
+static int
+compare_sort_items (gconstpointer a, gconstpointer b, gpointer callback_data)
+{
+	NautilusFileSortKeys *keys;
+	const SortItem *sort_item_1, *sort_item_2;
+
+	keys = callback_data;
+	sort_item_1 = a;
+	sort_item_2 = b;
+
+	if (keys->kind == SORT_KEY_NONE) {
+		return nautilus_file_compare_for_sort (sort_item_1->file, sort_item_2->file,
+						       keys->sort_type,
+						       keys->directories_first,
+						       keys->reversed);
+	}
+
+	if (sort_item_1->file == sort_item_2->file) {
+		return 0;
+	}
+
+	return compare_sort_keys (keys,
+				  sort_item_1->file, &sort_item_1->key,
+				  sort_item_2->file, &sort_item_2->key);
+}
+
+/**
+ * nautilus_file_sort_keys_sort:
+ * @keys: The order to sort in.
+ * @items: The items to sort, replaced by the sorted items.
+ * @n_items: The number of items.
+ * @get_file: Gives the file of an item.
+ * 
+ * Sorts the items by their files, in the order of
+ * nautilus_file_sort_keys_compare(). Items with the same file keep
+ * their order. Everything the comparisons need is computed for each
+ * file up front, so when all the files are in the same directory
+ * large arrays are sorted on several threads.
+ **/
+void
+nautilus_file_sort_keys_sort (NautilusFileSortKeys *keys,
+			      gpointer *items,
+			      guint n_items,
+			      NautilusFileSortGetFile get_file)
+{
+	SortItem *sort_items;
+	gpointer *sorted;
+	gboolean use_threads;
+	guint i;
+
+	if (n_items < 2) {
+		return;
+	}
+
+	sort_items = g_new (SortItem, n_items);
+	sorted = g_new (gpointer, n_items);
+	use_threads = sort_keys_compare_only_reads (keys);
+
+	for (i = 0; i < n_items; i++) {
+		sort_items[i].item = items[i];
+		sort_items[i].file = get_file (items[i]);
+		sort_item_prepare (keys, &sort_items[i]);
+		sorted[i] = &sort_items[i];
+
+		/* Ties are broken by directory name, which is only
+		 * read from the files when the directories are the same.
+		 */
+		if (sort_items[i].file->details->directory !=
+		    sort_items[0].file->details->directory) {
+			use_threads = FALSE;
+		}
+	}
+
+	nautilus_merge_sort (sorted, n_items, compare_sort_items, keys, use_threads);
+
+	for (i = 0; i < n_items; i++) {
+		items[i] = ((SortItem *) sorted[i])->item;
+		sort_key_clear (&sort_items[i].key);
+	}
+
+	g_free (sorted);
+	g_free (sort_items);
+}
+
 
 /**
  * nautilus_file_compare_name:
@@ -3741,7 +4186,7 @@ nautilus_file_get_name (NautilusFile *file)
 char *
 nautilus_file_get_description (NautilusFile *file)
 {
-	return g_strdup (file->details->description);
+	return g_strdup (eel_ref_str_peek (file->details->description));
 }
    
 void             
@@ -3790,7 +4235,7 @@ nautilus_file_is_trusted_link (NautilusFile *file)
 gboolean
 nautilus_file_has_activation_uri (NautilusFile *file)
 {
-	return file->details->activation_uri != NULL;
+	return NAUTILUS_FILE_RARE_DETAIL (file, activation_uri) != NULL;
 }
 
 
@@ -3803,8 +4248,8 @@ nautilus_file_get_activation_uri (NautilusFile *file)
 {
 	g_return_val_if_fail (NAUTILUS_IS_FILE (file), NULL);
 
-	if (file->details->activation_uri != NULL) {
-		return g_strdup (file->details->activation_uri);
+	if (NAUTILUS_FILE_RARE_DETAIL (file, activation_uri) != NULL) {
+		return g_strdup (file->details->rare->activation_uri);
 	}
 	
 	return nautilus_file_get_uri (file);
@@ -3815,8 +4260,8 @@ nautilus_file_get_activation_location (NautilusFile *file)
 {
 	g_return_val_if_fail (NAUTILUS_IS_FILE (file), NULL);
 
-	if (file->details->activation_uri != NULL) {
-		return g_file_new_for_uri (file->details->activation_uri);
+	if (NAUTILUS_FILE_RARE_DETAIL (file, activation_uri) != NULL) {
+		return g_file_new_for_uri (file->details->rare->activation_uri);
 	}
 	
 	return nautilus_file_get_location (file);
@@ -3921,13 +4366,14 @@ get_custom_icon (NautilusFile *file)
 		g_free (custom_icon_uri);
 	}
  
-	if (icon == NULL && file->details->got_link_info && file->details->custom_icon != NULL) {
-		if (g_path_is_absolute (file->details->custom_icon)) {
-			icon_file = g_file_new_for_path (file->details->custom_icon);
+	if (icon == NULL && file->details->got_link_info &&
+	    NAUTILUS_FILE_RARE_DETAIL (file, custom_icon) != NULL) {
+		if (g_path_is_absolute (file->details->rare->custom_icon)) {
+			icon_file = g_file_new_for_path (file->details->rare->custom_icon);
 			icon = g_file_icon_new (icon_file);
 			g_object_unref (icon_file);
 		} else {
-			icon = g_themed_icon_new (file->details->custom_icon);
+			icon = g_themed_icon_new (file->details->rare->custom_icon);
 		}
  	}
  
@@ -4143,6 +4589,23 @@ nautilus_file_get_icon (NautilusFile *file,
 			int w, h, s;
 			double scale;
 
+			/* Don't scale up if more than 25%, then read the original
+			   image instead. We don't want to compare to exactly 100%,
+			   since the zoom level 150% gives thumbnails at 144, which is
+			   ok to scale up from 128. */
+			if (modified_size > 128*1.25 &&
+			    !file->details->thumbnail_wants_original) {
+				/* Invalidate if we resize upward */
+				file->details->thumbnail_wants_original = TRUE;
+				nautilus_file_invalidate_attributes (file, NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL);
+			}
+
+			/* Scaled already, maybe for another view */
+			icon = nautilus_file_icon_cache_lookup (file, size, flags);
+			if (icon != NULL) {
+				return icon;
+			}
+
 			raw_pixbuf = g_object_ref (file->details->thumbnail);
 
 			w = gdk_pixbuf_get_width (raw_pixbuf);
@@ -4171,19 +4634,9 @@ nautilus_file_get_icon (NautilusFile *file,
 			}
 			g_object_unref (raw_pixbuf);
 
-			/* Don't scale up if more than 25%, then read the original
-			   image instead. We don't want to compare to exactly 100%,
-			   since the zoom level 150% gives thumbnails at 144, which is
-			   ok to scale up from 128. */
-			if (modified_size > 128*1.25 &&
-			    !file->details->thumbnail_wants_original) {
-				/* Invalidate if we resize upward */
-				file->details->thumbnail_wants_original = TRUE;
-				nautilus_file_invalidate_attributes (file, NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL);
-			}
-			
 			icon = nautilus_icon_info_new_for_pixbuf (scaled_pixbuf);
 			g_object_unref (scaled_pixbuf);
+			nautilus_file_icon_cache_insert (file, size, flags, icon);
 			return icon;
 		} else if (file->details->thumbnail_path == NULL &&
 			   file->details->can_read &&				
@@ -4225,7 +4678,11 @@ nautilus_file_get_icon_pixbuf (NautilusFile *file,
 
 	info = nautilus_file_get_icon (file, size, flags);
 	if (force_size) {
-		pixbuf =  nautilus_icon_info_get_pixbuf_at_size (info, size);
+		/* Thumbnails are only scaled once for all views */
+		pixbuf = nautilus_file_icon_cache_get_pixbuf_at_size (info, size);
+		if (pixbuf == NULL) {
+			pixbuf =  nautilus_icon_info_get_pixbuf_at_size (info, size);
+		}
 	} else {
 		pixbuf = nautilus_icon_info_get_pixbuf (info);
 	}
@@ -4247,7 +4704,7 @@ nautilus_file_get_custom_icon (NautilusFile *file)
 	custom_icon = get_custom_icon_metadata_uri (file);
  
 	if (custom_icon == NULL && file->details->got_link_info) {
-		custom_icon = g_strdup (file->details->custom_icon);
+		custom_icon = g_strdup (NAUTILUS_FILE_RARE_DETAIL (file, custom_icon));
  	}
  
 	return custom_icon;
@@ -4373,49 +4830,186 @@ static const char *CURRENT_WEEK_TIME_FORMATS [] = {
 	NULL
 };
 
+/* Dates are formatted relative to today, so the start of today and of
+ * the days around it are worked out once a day rather than per date.
+ */
+static time_t date_context_today;
+static time_t date_context_yesterday;
+static time_t date_context_tomorrow;
+
+/* Formatted dates are kept for reuse, keyed on the format and the time
+ * rounded to what the format shows.
+ */
+#define DATE_STRING_CACHE_SIZE 512
+
+typedef struct {
+	const char *format;
+	time_t time;
+	GList *lru_link;
+	char *string;
+} DateStringCacheEntry;
+
+static GHashTable *date_string_cache;
+static GQueue *date_string_lru;
+
+static guint
+date_string_cache_entry_hash (gconstpointer key)
+{
+	const DateStringCacheEntry *entry;
+
+	entry = key;
+	return g_direct_hash (entry->format) ^ (guint) entry->time;
+}
+
+static gboolean
+date_string_cache_entry_equal (gconstpointer a, gconstpointer b)
+{
+	const DateStringCacheEntry *entry_a, *entry_b;
+
+	entry_a = a;
+	entry_b = b;
+	return entry_a->format == entry_b->format && entry_a->time == entry_b->time;
+}
+
+static void
+date_string_cache_entry_free (DateStringCacheEntry *entry)
+{
+	g_free (entry->string);
+	g_free (entry);
+}
+
+static void
+free_date_string_cache (void)
+{
+	g_hash_table_destroy (date_string_cache);
+	date_string_cache = NULL;
+	g_queue_free (date_string_lru);
+	date_string_lru = NULL;
+}
+
+static void
+update_date_context (void)
+{
+	time_t now;
+	struct tm day;
+
+	now = time (NULL);
+	if (now >= date_context_today && now < date_context_tomorrow) {
+		return;
+	}
+
+	day = *localtime (&now);
+	day.tm_hour = 0;
+	day.tm_min = 0;
+	day.tm_sec = 0;
+	day.tm_isdst = -1;
+	date_context_today = mktime (&day);
+
+	day.tm_mday--;
+	day.tm_isdst = -1;
+	date_context_yesterday = mktime (&day);
+
+	day.tm_mday += 2;
+	day.tm_isdst = -1;
+	date_context_tomorrow = mktime (&day);
+
+	/* Also picks up time zone changes */
+	if (date_string_cache != NULL) {
+		g_hash_table_remove_all (date_string_cache);
+		g_queue_clear (date_string_lru);
+	}
+}
+
+/* Whether the strftime format shows seconds, see eel_strdup_strftime() */
+static gboolean
+date_format_shows_seconds (const char *format)
+{
+	const char *p;
+
+	for (p = strchr (format, '%'); p != NULL; p = strchr (p, '%')) {
+		p++;
+		while (*p == '-' || *p == '_' || *p == 'E' || *p == 'O') {
+			p++;
+		}
+		if (*p == '\0') {
+			break;
+		}
+		if (strchr ("crsSTX+", *p) != NULL) {
+			return TRUE;
+		}
+		p++;
+	}
+
+	return FALSE;
+}
+
+/* Like eel_strdup_strftime() on the local time, for formats that live
+ * forever, like literals and translations.
+ */
 static char *
-nautilus_file_fit_date_as_string (NautilusFile *file,
-				  NautilusDateType date_type,
-				  int width,
-				  NautilusWidthMeasureCallback measure_callback,
-				  NautilusTruncateCallback truncate_callback,
-				  void *measure_context)
+format_date (const char *format, time_t date)
+{
+	DateStringCacheEntry key, *entry;
+
+	if (date_string_cache == NULL) {
+		date_string_cache = g_hash_table_new_full (date_string_cache_entry_hash,
+							   date_string_cache_entry_equal,
+							   (GDestroyNotify) date_string_cache_entry_free,
+							   NULL);
+		date_string_lru = g_queue_new ();
+		eel_debug_call_at_shutdown (free_date_string_cache);
+	}
+
+	key.format = format;
+	key.time = date;
+	if (!date_format_shows_seconds (format)) {
+		/* Time zones are whole minutes off UTC */
+		key.time -= ((date % 60) + 60) % 60;
+	}
+
+	entry = g_hash_table_lookup (date_string_cache, &key);
+	if (entry != NULL) {
+		g_queue_unlink (date_string_lru, entry->lru_link);
+		g_queue_push_head_link (date_string_lru, entry->lru_link);
+		return g_strdup (entry->string);
+	}
+
+	if (g_hash_table_size (date_string_cache) >= DATE_STRING_CACHE_SIZE) {
+		entry = g_queue_pop_tail (date_string_lru);
+		g_hash_table_remove (date_string_cache, entry);
+	}
+
+	entry = g_new (DateStringCacheEntry, 1);
+	entry->format = format;
+	entry->time = key.time;
+	entry->string = eel_strdup_strftime (format, localtime (&key.time));
+	g_queue_push_head (date_string_lru, entry);
+	entry->lru_link = date_string_lru->head;
+	g_hash_table_insert (date_string_cache, entry, entry);
+
+	return g_strdup (entry->string);
+}
+
+/* Call update_date_context() first */
+static char *
+fit_time_as_string (time_t file_time_raw,
+		    int width,
+		    NautilusWidthMeasureCallback measure_callback,
+		    NautilusTruncateCallback truncate_callback,
+		    void *measure_context)
 {
-	time_t file_time_raw;
-	struct tm *file_time;
 	const char **formats;
 	const char *width_template;
 	const char *format;
 	char *date_string;
 	char *result;
-	GDate *today;
-	GDate *file_date;
-	guint32 file_date_age;
 	int i;
 
-	if (!nautilus_file_get_date (file, date_type, &file_time_raw)) {
-		return NULL;
-	}
-
-	file_time = localtime (&file_time_raw);
-
 	if (date_format_pref == NAUTILUS_DATE_FORMAT_LOCALE) {
-		return eel_strdup_strftime ("%c", file_time);
+		return format_date ("%c", file_time_raw);
 	} else if (date_format_pref == NAUTILUS_DATE_FORMAT_ISO) {
-		return eel_strdup_strftime ("%Y-%m-%d %H:%M:%S", file_time);
+		return format_date ("%Y-%m-%d %H:%M:%S", file_time_raw);
 	}
-	
-	file_date = eel_g_date_new_tm (file_time);
-	
-	today = g_date_new ();
-	g_date_set_time_t (today, time (NULL));
-
-	/* Overflow results in a large number; fine for our purposes. */
-	file_date_age = (g_date_get_julian (today) -
-			 g_date_get_julian (file_date));
-
-	g_date_free (file_date);
-	g_date_free (today);
 
 	/* Format varies depending on how old the date is. This minimizes
 	 * the length (and thus clutter & complication) of typical dates
@@ -4425,12 +5019,12 @@ nautilus_file_fit_date_as_string (NautilusFile *file,
 	 * internationalization's sake.
 	 */
 
-	if (file_date_age == 0)	{
+	if (file_time_raw >= date_context_today &&
+	    file_time_raw < date_context_tomorrow) {
 		formats = TODAY_TIME_FORMATS;
-	} else if (file_date_age == 1) {
+	} else if (file_time_raw >= date_context_yesterday &&
+		   file_time_raw < date_context_today) {
 		formats = YESTERDAY_TIME_FORMATS;
-	} else if (file_date_age < 7) {
-		formats = CURRENT_WEEK_TIME_FORMATS;
 	} else {
 		formats = CURRENT_WEEK_TIME_FORMATS;
 	}
@@ -4452,7 +5046,7 @@ nautilus_file_fit_date_as_string (NautilusFile *file,
 			 * shortest format
 			 */
 			
-			date_string = eel_strdup_strftime (format, file_time);
+			date_string = format_date (format, file_time_raw);
 
 			if (truncate_callback == NULL) {
 				return date_string;
@@ -4476,8 +5070,28 @@ nautilus_file_fit_date_as_string (NautilusFile *file,
 		}
 	}
 	
-	return eel_strdup_strftime (format, file_time);
+	return format_date (format, file_time_raw);
+}
 
+static char *
+nautilus_file_fit_date_as_string (NautilusFile *file,
+				  NautilusDateType date_type,
+				  int width,
+				  NautilusWidthMeasureCallback measure_callback,
+				  NautilusTruncateCallback truncate_callback,
+				  void *measure_context)
+{
+	time_t file_time_raw;
+
+	if (!nautilus_file_get_date (file, date_type, &file_time_raw)) {
+		return NULL;
+	}
+
+	update_date_context ();
+
+	return fit_time_as_string (file_time_raw, width,
+				   measure_callback, truncate_callback,
+				   measure_context);
 }
 
 /**
@@ -4777,7 +5391,7 @@ nautilus_file_get_directory_item_mime_types (NautilusFile *file,
 		return FALSE;
 	}
 
-	*mime_list = eel_g_str_list_copy (file->details->mime_list);
+	*mime_list = eel_g_str_list_copy (NAUTILUS_FILE_RARE_DETAIL (file, mime_list));
 	return TRUE;
 }
 
@@ -6021,13 +6635,13 @@ nautilus_file_get_string_attribute_q (NautilusFile *file, GQuark attribute_q)
 
 	extension_attribute = NULL;
 	
-	if (file->details->pending_extension_attributes) {
-		extension_attribute = g_hash_table_lookup (file->details->pending_extension_attributes,
+	if (NAUTILUS_FILE_RARE_DETAIL (file, pending_extension_attributes)) {
+		extension_attribute = g_hash_table_lookup (file->details->rare->pending_extension_attributes,
 							   GINT_TO_POINTER (attribute_q));
 	} 
 
-	if (extension_attribute == NULL && file->details->extension_attributes) {
-		extension_attribute = g_hash_table_lookup (file->details->extension_attributes,
+	if (extension_attribute == NULL && NAUTILUS_FILE_RARE_DETAIL (file, extension_attributes)) {
+		extension_attribute = g_hash_table_lookup (file->details->rare->extension_attributes,
 							   GINT_TO_POINTER (attribute_q));
 	}
 		
@@ -6116,6 +6730,55 @@ nautilus_file_get_string_attribute_with_default_q (NautilusFile *file, GQuark at
 	return g_strdup (_("unknown"));
 }
 
+/**
+ * nautilus_file_get_string_attributes_with_default_q:
+ * 
+ * Gets nautilus_file_get_string_attribute_with_default_q() for many
+ * files at once. Date attributes share the work of finding out what
+ * day it is, and files with dates in the same minute usually share
+ * the formatting too.
+ * @files: The files.
+ * @n_files: The number of files.
+ * @attribute_q: The attribute, as for nautilus_file_get_string_attribute_q().
+ * @strings: Filled with a newly allocated string for each file.
+ * 
+ **/
+void
+nautilus_file_get_string_attributes_with_default_q (NautilusFile **files,
+						     int n_files,
+						     GQuark attribute_q,
+						     char **strings)
+{
+	NautilusDateType date_type;
+	time_t date;
+	int i;
+
+	if (attribute_q == attribute_date_modified_q) {
+		date_type = NAUTILUS_DATE_TYPE_MODIFIED;
+	} else if (attribute_q == attribute_date_changed_q) {
+		date_type = NAUTILUS_DATE_TYPE_CHANGED;
+	} else if (attribute_q == attribute_date_accessed_q) {
+		date_type = NAUTILUS_DATE_TYPE_ACCESSED;
+	} else if (attribute_q == attribute_date_permissions_q) {
+		date_type = NAUTILUS_DATE_TYPE_PERMISSIONS_CHANGED;
+	} else {
+		for (i = 0; i < n_files; i++) {
+			strings[i] = nautilus_file_get_string_attribute_with_default_q (files[i], attribute_q);
+		}
+		return;
+	}
+
+	update_date_context ();
+
+	for (i = 0; i < n_files; i++) {
+		if (nautilus_file_get_date (files[i], date_type, &date)) {
+			strings[i] = fit_time_as_string (date, 0, NULL, NULL, NULL);
+		} else {
+			strings[i] = g_strdup (_("unknown"));
+		}
+	}
+}
+
 char *
 nautilus_file_get_string_attribute_with_default (NautilusFile *file, const char *attribute_name)
 {
@@ -6454,8 +7117,8 @@ nautilus_file_get_keywords (NautilusFile *file)
 	keywords = nautilus_file_get_metadata_list
 		(file, NAUTILUS_METADATA_KEY_EMBLEMS);
 
-	keywords = g_list_concat (keywords, eel_g_str_list_copy (file->details->extension_emblems));
-	keywords = g_list_concat (keywords, eel_g_str_list_copy (file->details->pending_extension_emblems));
+	keywords = g_list_concat (keywords, eel_g_str_list_copy (NAUTILUS_FILE_RARE_DETAIL (file, extension_emblems)));
+	keywords = g_list_concat (keywords, eel_g_str_list_copy (NAUTILUS_FILE_RARE_DETAIL (file, pending_extension_emblems)));
 
 	return sort_keyword_list_and_remove_duplicates (keywords);
 }
@@ -6911,7 +7574,7 @@ nautilus_file_peek_top_left_text (NautilusFile *file,
 	}
 	
 	/* Show what we read in. */
-	return file->details->top_left_text;
+	return NAUTILUS_FILE_RARE_DETAIL (file, top_left_text);
 }
 
 /**
@@ -6944,9 +7607,9 @@ nautilus_file_get_trash_original_file (NautilusFile *file)
 
 	original_file = NULL;
 
-	if (file->details->trash_orig_path != NULL) {
+	if (NAUTILUS_FILE_RARE_DETAIL (file, trash_orig_path) != NULL) {
 		/* file name is stored in URL encoding */
-		filename = g_uri_unescape_string (file->details->trash_orig_path, "");
+		filename = g_uri_unescape_string (file->details->rare->trash_orig_path, "");
 		location = g_file_new_for_path (filename);
 		original_file = nautilus_file_get (location);
 		g_object_unref (G_OBJECT (location));
@@ -7312,6 +7975,48 @@ nautilus_file_is_thumbnailing (NautilusFile *file)
 	return file->details->is_thumbnailing;
 }
 
+/* Starts making or loading the thumbnail nautilus_file_get_icon() would
+ * show, before the icon is needed. Returns TRUE if it started making
+ * one, which nautilus_thumbnail_remove_from_queue() can cancel.
+ */
+gboolean
+nautilus_file_prefetch_thumbnail (NautilusFile *file)
+{
+	GIcon *gicon;
+
+	g_return_val_if_fail (NAUTILUS_IS_FILE (file), FALSE);
+
+	if (file->details->thumbnail != NULL ||
+	    file->details->is_thumbnailing ||
+	    !nautilus_file_should_show_thumbnail (file)) {
+		return FALSE;
+	}
+
+	gicon = get_custom_icon (file);
+	if (gicon != NULL) {
+		g_object_unref (gicon);
+		return FALSE;
+	}
+
+	if (file->details->thumbnail_path != NULL) {
+		/* Made already, only needs to be read */
+		if (file->details->directory != NULL) {
+			nautilus_directory_prioritize_file_in_work_queue (file->details->directory,
+									  file);
+		}
+		return FALSE;
+	}
+
+	if (file->details->can_read &&
+	    !file->details->thumbnailing_failed &&
+	    nautilus_can_thumbnail (file)) {
+		nautilus_create_thumbnail (file);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 void
 nautilus_file_set_is_thumbnailing (NautilusFile *file,
 				   gboolean is_thumbnailing)
@@ -7384,7 +8089,7 @@ nautilus_file_invalidate_all_attributes (NautilusFile *file)
 void
 nautilus_file_dump (NautilusFile *file)
 {
-	long size = file->details->deep_size;
+	long size = NAUTILUS_FILE_RARE_DETAIL (file, deep_size);
 	char *uri;
 	const char *file_kind;
 
@@ -7775,6 +8480,9 @@ thumbnail_size_changed_callback (gpointer user_data)
 {
 	cached_thumbnail_size = eel_preferences_get_integer (NAUTILUS_PREFERENCES_ICON_VIEW_THUMBNAIL_SIZE);
 
+	/* Thumbnails are scaled to the new size */
+	nautilus_file_icon_cache_clear ();
+
 	/* Tell the world that icons might have changed. We could invent a narrower-scope
 	 * signal to mean only "thumbnails might have changed" if this ends up being slow
 	 * for some reason.
@@ -7810,6 +8518,7 @@ icon_theme_changed_callback (GtkIconTheme *icon_theme,
 {
 	/* Clear all pixmap caches as the icon => pixmap lookup changed */
 	nautilus_icon_info_clear_caches ();
+	nautilus_file_icon_cache_clear ();
 	
 	/* Tell the world that icons might have changed. We could invent a narrower-scope
 	 * signal to mean only "thumbnails might have changed" if this ends up being slow
@@ -7906,12 +8615,15 @@ static void
 nautilus_file_add_emblem (NautilusFile *file,
 			  const char *emblem_name)
 {
+	NautilusFileRareDetails *rare;
+
+	rare = nautilus_file_ensure_rare_details (file);
 	if (file->details->pending_info_providers) {
-		file->details->pending_extension_emblems = g_list_prepend (file->details->pending_extension_emblems,
-									   g_strdup (emblem_name));
+		rare->pending_extension_emblems = g_list_prepend (rare->pending_extension_emblems,
+								  g_strdup (emblem_name));
 	} else {
-		file->details->extension_emblems = g_list_prepend (file->details->extension_emblems,
-								   g_strdup (emblem_name));
+		rare->extension_emblems = g_list_prepend (rare->extension_emblems,
+							  g_strdup (emblem_name));
 	}
 
 	nautilus_file_changed (file);
@@ -7922,25 +8634,28 @@ nautilus_file_add_string_attribute (NautilusFile *file,
 				    const char *attribute_name,
 				    const char *value)
 {
+	NautilusFileRareDetails *rare;
+
+	rare = nautilus_file_ensure_rare_details (file);
 	if (file->details->pending_info_providers) {
 		/* Lazily create hashtable */
-		if (!file->details->pending_extension_attributes) {
-			file->details->pending_extension_attributes = 
+		if (!rare->pending_extension_attributes) {
+			rare->pending_extension_attributes = 
 				g_hash_table_new_full (g_direct_hash, g_direct_equal,
 						       NULL, 
 						       (GDestroyNotify)g_free);
 		}
-		g_hash_table_insert (file->details->pending_extension_attributes,
+		g_hash_table_insert (rare->pending_extension_attributes,
 				     GINT_TO_POINTER (g_quark_from_string (attribute_name)),
 				     g_strdup (value));
 	} else {
-		if (!file->details->extension_attributes) {
-			file->details->extension_attributes = 
+		if (!rare->extension_attributes) {
+			rare->extension_attributes = 
 				g_hash_table_new_full (g_direct_hash, g_direct_equal,
 						       NULL, 
 						       (GDestroyNotify)g_free);
 		}
-		g_hash_table_insert (file->details->extension_attributes,
+		g_hash_table_insert (rare->extension_attributes,
 				     GINT_TO_POINTER (g_quark_from_string (attribute_name)),
 				     g_strdup (value));
 	}
@@ -7957,16 +8672,21 @@ nautilus_file_invalidate_extension_info (NautilusFile *file)
 void
 nautilus_file_info_providers_done (NautilusFile *file)
 {
-	eel_g_list_free_deep (file->details->extension_emblems);
-	file->details->extension_emblems = file->details->pending_extension_emblems;
-	file->details->pending_extension_emblems = NULL;
+	NautilusFileRareDetails *rare;
 
-	if (file->details->extension_attributes) {
-		g_hash_table_destroy (file->details->extension_attributes);
-	}
+	rare = file->details->rare;
+	if (rare != NULL) {
+		eel_g_list_free_deep (rare->extension_emblems);
+		rare->extension_emblems = rare->pending_extension_emblems;
+		rare->pending_extension_emblems = NULL;
+
+		if (rare->extension_attributes) {
+			g_hash_table_destroy (rare->extension_attributes);
+		}
 	
-	file->details->extension_attributes = file->details->pending_extension_attributes;
-	file->details->pending_extension_attributes = NULL;
+		rare->extension_attributes = rare->pending_extension_attributes;
+		rare->pending_extension_attributes = NULL;
+	}
 
 	nautilus_file_changed (file);
 }
@@ -7997,11 +8717,34 @@ nautilus_file_info_iface_init (NautilusFileInfoIface *iface)
 
 #if !defined (NAUTILUS_OMIT_SELF_CHECK)
 
+static NautilusFile *
+check_sort_get_file (gpointer item)
+{
+	return item;
+}
+
+static gboolean
+check_same_date_string (const char *format, time_t time_1, time_t time_2)
+{
+	char *string_1, *string_2;
+	gboolean result;
+
+	string_1 = format_date (format, time_1);
+	string_2 = format_date (format, time_2);
+	result = eel_str_is_equal (string_1, string_2);
+	g_free (string_1);
+	g_free (string_2);
+
+	return result;
+}
+
 void
 nautilus_self_check_file (void)
 {
 	NautilusFile *file_1;
 	NautilusFile *file_2;
+	NautilusFileSortKeys *keys;
+	gpointer files[3];
 	GList *list;
 
         /* refcount checks */
@@ -8085,8 +8828,40 @@ nautilus_self_check_file (void)
 	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_compare_for_sort (file_1, file_1, NAUTILUS_FILE_SORT_BY_DISPLAY_NAME, FALSE, TRUE) == 0, TRUE);
 	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_compare_for_sort (file_1, file_1, NAUTILUS_FILE_SORT_BY_DISPLAY_NAME, TRUE, TRUE) == 0, TRUE);
 
+	/* sorting with keys, by a string attribute */
+	keys = nautilus_file_sort_keys_new (g_quark_from_static_string ("uri"), FALSE, FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_sort_keys_compare (keys, file_1, file_2) < 0, TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_sort_keys_compare (keys, file_2, file_1) > 0, TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_sort_keys_compare (keys, file_1, file_1) == 0, TRUE);
+	nautilus_file_sort_keys_free (keys);
+	keys = nautilus_file_sort_keys_new (g_quark_from_static_string ("uri"), FALSE, TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_sort_keys_compare (keys, file_1, file_2) > 0, TRUE);
+	nautilus_file_sort_keys_free (keys);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_compare_for_sort_by_attribute (file_1, file_2, "uri", FALSE, FALSE) < 0, TRUE);
+	keys = nautilus_file_sort_keys_new_for_sort_type (NAUTILUS_FILE_SORT_BY_DISPLAY_NAME, FALSE, FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_file_sort_keys_compare (keys, file_1, file_2) < 0, TRUE);
+	files[0] = file_2;
+	files[1] = file_1;
+	files[2] = file_2;
+	nautilus_file_sort_keys_sort (keys, files, G_N_ELEMENTS (files), check_sort_get_file);
+	EEL_CHECK_BOOLEAN_RESULT (files[0] == file_1 && files[1] == file_2 && files[2] == file_2, TRUE);
+	nautilus_file_sort_keys_free (keys);
+
 	nautilus_file_unref (file_1);
 	nautilus_file_unref (file_2);
+
+	/* date formatting */
+	EEL_CHECK_BOOLEAN_RESULT (date_format_shows_seconds ("%-I:%M %p"), FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (date_format_shows_seconds ("%m/%d/%y"), FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (date_format_shows_seconds ("100%% at %H:%M"), FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (date_format_shows_seconds ("%-I:%M:%S %p"), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (date_format_shows_seconds ("%-S"), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (date_format_shows_seconds ("%c"), TRUE);
+
+	/* 1234567860 is on a minute boundary */
+	EEL_CHECK_STRING_RESULT (format_date ("%S", 1234567860 + 59), "59");
+	EEL_CHECK_BOOLEAN_RESULT (check_same_date_string ("%H:%M", 1234567860, 1234567860 + 59), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check_same_date_string ("%H:%M:%S", 1234567860, 1234567860 + 59), FALSE);
 }
 
 #endif /* !NAUTILUS_OMIT_SELF_CHECK */
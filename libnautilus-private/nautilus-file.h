@@ -371,6 +371,10 @@ char *                  nautilus_file_get_string_attribute_with_default (Nautilu
 									 const char                     *attribute_name);
 char *                  nautilus_file_get_string_attribute_with_default_q (NautilusFile                  *file,
 									 GQuark                          attribute_q);
+void                    nautilus_file_get_string_attributes_with_default_q (NautilusFile               **files,
+									 int                             n_files,
+									 GQuark                          attribute_q,
+									 char                          **strings);
 char *			nautilus_file_fit_modified_date_as_string	(NautilusFile 			*file,
 									 int				 width,
 									 NautilusWidthMeasureCallback    measure_callback,
@@ -402,6 +406,27 @@ int                     nautilus_file_compare_for_sort_by_attribute_q   (Nautilu
 									 gboolean                        reversed);
 gboolean                nautilus_file_is_date_sort_attribute_q          (GQuark                          attribute);
 
+/* Keys for sorting many files, computed once for each file */
+typedef struct NautilusFileSortKeys NautilusFileSortKeys;
+
+NautilusFileSortKeys *  nautilus_file_sort_keys_new                     (GQuark                          attribute,
+									 gboolean                        directories_first,
+									 gboolean                        reversed);
+NautilusFileSortKeys *  nautilus_file_sort_keys_new_for_sort_type       (NautilusFileSortType            sort_type,
+									 gboolean                        directories_first,
+									 gboolean                        reversed);
+void                    nautilus_file_sort_keys_free                    (NautilusFileSortKeys           *keys);
+int                     nautilus_file_sort_keys_compare                 (NautilusFileSortKeys           *keys,
+									 NautilusFile                   *file_1,
+									 NautilusFile                   *file_2);
+
+typedef NautilusFile *(* NautilusFileSortGetFile) (gpointer item);
+
+void                    nautilus_file_sort_keys_sort                    (NautilusFileSortKeys           *keys,
+									 gpointer                       *items,
+									 guint                           n_items,
+									 NautilusFileSortGetFile         get_file);
+
 int                     nautilus_file_compare_display_name              (NautilusFile                   *file_1,
 									 const char                     *pattern);
 
@@ -449,6 +474,7 @@ void                    nautilus_file_set_has_open_window               (Nautilu
 
 /* Thumbnailing handling */
 gboolean                nautilus_file_is_thumbnailing                   (NautilusFile                   *file);
+gboolean                nautilus_file_prefetch_thumbnail                (NautilusFile                   *file);
 
 /* Convenience functions for dealing with a list of NautilusFile objects that each have a ref.
  * These are just convenient names for functions that work on lists of GtkObject *.
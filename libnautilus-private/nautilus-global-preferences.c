@@ -256,6 +256,10 @@ static const PreferenceDefault preference_defaults[] = {
 	  PREFERENCE_BOOLEAN,
 	  GINT_TO_POINTER (FALSE)
 	},
+	{ NAUTILUS_PREFERENCES_FILE_OPERATIONS_PER_DEVICE,
+	  PREFERENCE_INTEGER,
+	  GINT_TO_POINTER (1)
+	},
 	{ NAUTILUS_PREFERENCES_SHOW_TEXT_IN_ICONS,
 	  PREFERENCE_STRING,
 	  "local_only",
@@ -305,6 +309,10 @@ static const PreferenceDefault preference_defaults[] = {
 	  NULL, NULL,
 	  "file_size"
 	},
+	{ NAUTILUS_PREFERENCES_USE_THUMBNAIL_PACKS,
+	  PREFERENCE_BOOLEAN,
+	  GINT_TO_POINTER (FALSE)
+	},
 	{ NAUTILUS_PREFERENCES_PREVIEW_SOUND,
 	  PREFERENCE_STRING,
 	  "local_only",
@@ -1100,40 +1100,73 @@ prepare_pango_layout_for_measure_entire_text (NautilusIconCanvasItem *item,
 	}
 }
 
-static void
-prepare_pango_layout_for_draw (NautilusIconCanvasItem *item,
-			       PangoLayout *layout)
+static int
+get_pango_layout_height_for_draw (NautilusIconCanvasItem *item)
 {
 	NautilusIconCanvasItemDetails *details;
 	NautilusIconContainer *container;
 	gboolean needs_highlight;
 
-	prepare_pango_layout_width (item, layout);
-
 	container = NAUTILUS_ICON_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
 	details = item->details;
 
 	needs_highlight = details->is_highlighted_for_selection || details->is_highlighted_for_drop;
 
 	if (IS_COMPACT_VIEW (container)) {
-		pango_layout_set_height (layout, -1);
+		return -1;
 	} else if (needs_highlight ||
 		   details->is_prelit ||
 		   details->is_highlighted_as_keyboard_focus ||
 		   details->entire_text ||
 		   container->details->label_position == NAUTILUS_ICON_LABEL_POSITION_BESIDE) {
 		/* VOODOO-TODO, cf. compute_text_rectangle() */
-		pango_layout_set_height (layout, G_MININT);
+		return G_MININT;
 	} else {
 		/* TODO? we might save some resources, when the re-layout is not neccessary in case
 		 * the layout height already fits into max. layout lines. But pango should figure this
 		 * out itself (which it doesn't ATM).
 		 */
-		pango_layout_set_height (layout,
-					 nautilus_icon_container_get_max_layout_lines_for_pango (container));
+		return nautilus_icon_container_get_max_layout_lines_for_pango (container);
 	}
 }
 
+static void
+prepare_pango_layout_for_draw (NautilusIconCanvasItem *item,
+			       PangoLayout *layout)
+{
+	prepare_pango_layout_width (item, layout);
+	pango_layout_set_height (layout, get_pango_layout_height_for_draw (item));
+}
+
+/* Everything the measured label size depends on, apart from the font,
+ * which is per zoom level and flushes the cache when it changes.
+ */
+static char *
+get_label_size_cache_key (NautilusIconCanvasItem *item,
+			  int max_text_width)
+{
+	NautilusIconCanvasItemDetails *details;
+	NautilusIconContainer *container;
+	const char *editable_text, *additional_text;
+
+	container = NAUTILUS_ICON_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
+	details = item->details;
+
+	editable_text = details->editable_text != NULL ? details->editable_text : "";
+	additional_text = details->additional_text != NULL ? details->additional_text : "";
+
+	/* the length of the first text keeps the key unambiguous */
+	return g_strdup_printf ("%d %d %d %d %d %" G_GSIZE_FORMAT " %s%s",
+				container->details->zoom_level,
+				max_text_width,
+				IS_COMPACT_VIEW (container),
+				nautilus_icon_container_get_max_layout_lines (container),
+				get_pango_layout_height_for_draw (item),
+				strlen (editable_text),
+				editable_text,
+				additional_text);
+}
+
 static void
 measure_label_text (NautilusIconCanvasItem *item)
 {
@@ -1146,6 +1179,8 @@ measure_label_text (NautilusIconCanvasItem *item)
 	PangoLayout *additional_layout;
 	gboolean have_editable, have_additional, needs_highlight;
 	int max_text_width;
+	char *cache_key;
+	NautilusIconLabelSize size;
 
 	/* check to see if the cached values are still valid; if so, there's
 	 * no work necessary
@@ -1193,6 +1228,19 @@ measure_label_text (NautilusIconCanvasItem *item)
 	max_text_width = floor (nautilus_icon_canvas_item_get_max_text_width (item));
 
 	container = NAUTILUS_ICON_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);	
+
+	cache_key = get_label_size_cache_key (item, max_text_width);
+	if (nautilus_icon_container_lookup_label_size (container, cache_key, &size)) {
+		details->text_width = size.text_width;
+		details->text_dx = size.text_dx;
+		details->text_height = size.text_height;
+		details->text_height_for_layout = size.text_height_for_layout;
+		details->text_height_for_entire_text = size.text_height_for_entire_text;
+		details->editable_text_height = size.editable_text_height;
+		g_free (cache_key);
+		return;
+	}
+
 	editable_layout = NULL;
 	additional_layout = NULL;
 
@@ -1258,6 +1306,15 @@ measure_label_text (NautilusIconCanvasItem *item)
 	/* extra to make it look nicer */
 	details->text_width += TEXT_BACK_PADDING_X*2;
 
+	size.text_width = details->text_width;
+	size.text_dx = details->text_dx;
+	size.text_height = details->text_height;
+	size.text_height_for_layout = details->text_height_for_layout;
+	size.text_height_for_entire_text = details->text_height_for_entire_text;
+	size.editable_text_height = details->editable_text_height;
+	nautilus_icon_container_store_label_size (container, cache_key, &size);
+	g_free (cache_key);
+
 	if (editable_layout) {
 		g_object_unref (editable_layout);
 	}
@@ -2072,7 +2129,6 @@ create_label_layout (NautilusIconCanvasItem *item,
 {
 	PangoLayout *layout;
 	PangoContext *context;
-	PangoFontDescription *desc;
 	NautilusIconContainer *container;
 	EelCanvasItem *canvas_item;
 	GString *str;
@@ -2121,17 +2177,8 @@ create_label_layout (NautilusIconCanvasItem *item,
 	pango_layout_set_spacing (layout, LABEL_LINE_SPACING);
 	pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
 
-	/* Create a font description */
-	if (container->details->font) {
-		desc = pango_font_description_from_string (container->details->font);
-	} else {
-		desc = pango_font_description_copy (pango_context_get_font_description (context));
-		pango_font_description_set_size (desc,
-						 pango_font_description_get_size (desc) +
-						 container->details->font_size_table [container->details->zoom_level]);
-	}
-	pango_layout_set_font_description (layout, desc);
-	pango_font_description_free (desc);
+	pango_layout_set_font_description (layout,
+					   nautilus_icon_container_get_label_font_description (container));
 	g_free (zeroified_text);
 	
 	return layout;
@@ -52,6 +52,7 @@
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define TAB_NAVIGATION_DISABLED
@@ -224,6 +225,8 @@ static int compare_icons_vertical (NautilusIconContainer *container,
 
 static void store_layout_timestamps_now (NautilusIconContainer *container);
 
+static void neighbor_index_icon_moved (NautilusIconContainer *container);
+
 static gpointer accessible_parent_class;
 
 static GQuark accessible_private_data_quark = 0;
@@ -278,12 +281,36 @@ enum {
 	LAST_SIGNAL
 };
 
+/* Everything that decides which positions find_empty_location() tries */
+typedef struct {
+	int start_x, start_y;
+	int icon_width, icon_height;
+	int height_for_bound_check;
+	int column_start_y;
+	int canvas_width, canvas_height;
+} PlacementSearch;
+
 typedef struct {
-	int **icon_grid;
-	int *grid_memory;
+	/* One bit per grid cell, set once an icon covers it. Each
+	 * column takes words_per_column words, with row 0 in the
+	 * lowest bit of the first one.
+	 */
+	gulong *columns;
+	int words_per_column;
 	int num_rows;
 	int num_columns;
 	gboolean tight;
+
+	/* Scratch space for the columns an icon spans, OR'ed together */
+	gulong *column_span;
+
+	/* Cells are never cleared, so every position a search tried
+	 * before the one it found stays taken, and the next search with
+	 * the same parameters can start where the last one ended.
+	 */
+	gboolean has_last_search;
+	PlacementSearch last_search;
+	int last_x, last_y;
 } PlacementGrid;
 
 static guint signals[LAST_SIGNAL];
@@ -326,6 +353,8 @@ icon_set_position (NautilusIcon *icon,
 
 	container = NAUTILUS_ICON_CONTAINER (EEL_CANVAS_ITEM (icon->item)->canvas);
 
+	neighbor_index_icon_moved (container);
+
 	if (icon == get_icon_being_renamed (container)) {
 		end_renaming_mode (container, TRUE);
 	}
@@ -1154,15 +1183,42 @@ compare_icons (gconstpointer a, gconstpointer b, gpointer icon_container)
 	return klass->compare_icons (icon_container, icon_a->data, icon_b->data);
 }
 
+static NautilusIconData *
+icon_get_data (gpointer icon)
+{
+	return ((NautilusIcon *) icon)->data;
+}
+
 static void
 sort_icons (NautilusIconContainer *container,
 	    GList                **icons)
 {
 	NautilusIconContainerClass *klass;
+	gpointer *array;
+	guint n_icons, i;
+	GList *p;
 
 	klass = NAUTILUS_ICON_CONTAINER_GET_CLASS (container);
 	g_assert (klass->compare_icons != NULL);
 
+	if (klass->sort_icons != NULL) {
+		/* The sorted icons go back into the same list nodes */
+		n_icons = g_list_length (*icons);
+		array = g_new (gpointer, n_icons);
+		for (p = *icons, i = 0; p != NULL; p = p->next, i++) {
+			array[i] = p->data;
+		}
+
+		if (klass->sort_icons (container, array, n_icons, icon_get_data)) {
+			for (p = *icons, i = 0; p != NULL; p = p->next, i++) {
+				p->data = array[i];
+			}
+			g_free (array);
+			return;
+		}
+		g_free (array);
+	}
+
 	*icons = g_list_sort_with_data (*icons, compare_icons, container);
 }
 
@@ -1183,6 +1239,122 @@ get_grid_width (NautilusIconContainer *container)
 	}
 }
 #endif
+
+/* Keyboard navigation index.
+ *
+ * Automatic layout records the icons of each row, or of each column
+ * in vertical layouts, as it lays them down. The first arrow key press
+ * after that sorts them by position, so the neighbour in a direction
+ * is the next icon in the same line, or a binary search in the lines
+ * next to it, instead of a comparison with every icon in the container.
+ * Moving any icon drops the sorted positions, relayout and removing
+ * icons drop the whole index. Icons added since the layout make the
+ * index unusable until the next one.
+ */
+
+typedef struct {
+	NautilusIcon *icon;
+	int line;
+	/* Comparison point in canvas coordinates, see get_cmp_point_x() */
+	int x, y;
+} NeighborEntry;
+
+typedef struct {
+	NeighborEntry *entries; /* sorted along the line */
+	int n_entries;
+} NeighborLine;
+
+struct NautilusIconNeighborIndex {
+	gboolean lines_are_columns;
+	gboolean is_recording;
+	GPtrArray *recorded_lines; /* of GPtrArray of NautilusIcon */
+
+	/* Built from recorded_lines when first needed */
+	gboolean is_built;
+	NeighborLine *lines; /* sorted top to bottom or left to right */
+	int n_lines;
+	GHashTable *icon_to_entry;
+	NeighborEntry *first_in_rows;
+	NeighborEntry *last_in_rows;
+	NeighborEntry *last_in_columns;
+};
+
+static void
+neighbor_index_free_positions (NautilusIconNeighborIndex *index)
+{
+	int i;
+
+	for (i = 0; i < index->n_lines; i++) {
+		g_free (index->lines[i].entries);
+	}
+	g_free (index->lines);
+	index->lines = NULL;
+	index->n_lines = 0;
+
+	if (index->icon_to_entry != NULL) {
+		g_hash_table_destroy (index->icon_to_entry);
+		index->icon_to_entry = NULL;
+	}
+
+	index->first_in_rows = NULL;
+	index->last_in_rows = NULL;
+	index->last_in_columns = NULL;
+	index->is_built = FALSE;
+}
+
+static void
+invalidate_neighbor_index (NautilusIconContainer *container)
+{
+	NautilusIconNeighborIndex *index;
+	guint i;
+
+	index = container->details->neighbor_index;
+	if (index == NULL) {
+		return;
+	}
+
+	neighbor_index_free_positions (index);
+	for (i = 0; i < index->recorded_lines->len; i++) {
+		g_ptr_array_free (g_ptr_array_index (index->recorded_lines, i), TRUE);
+	}
+	g_ptr_array_free (index->recorded_lines, TRUE);
+	g_free (index);
+
+	container->details->neighbor_index = NULL;
+}
+
+static void
+neighbor_index_icon_moved (NautilusIconContainer *container)
+{
+	NautilusIconNeighborIndex *index;
+
+	index = container->details->neighbor_index;
+	if (index != NULL && index->is_built) {
+		neighbor_index_free_positions (index);
+	}
+}
+
+static void
+neighbor_index_record_line (NautilusIconContainer *container,
+			    GList *line_start,
+			    GList *line_end)
+{
+	NautilusIconNeighborIndex *index;
+	GPtrArray *line;
+	GList *p;
+
+	index = container->details->neighbor_index;
+	if (index == NULL || !index->is_recording) {
+		return;
+	}
+
+	line = g_ptr_array_new ();
+	for (p = line_start; p != line_end; p = p->next) {
+		g_ptr_array_add (line, p->data);
+	}
+	g_ptr_array_add (index->recorded_lines, line);
+}
+
 typedef struct {
 	double width;
 	double height;
@@ -1208,6 +1380,8 @@ lay_down_one_line (NautilusIconContainer *container,
 
 	is_rtl = nautilus_icon_container_is_layout_rtl (container);
 
+	neighbor_index_record_line (container, line_start, line_end);
+
 	/* Lay out the icons along the baseline. */
 	x = ICON_PAD_LEFT;
 	i = 0;
@@ -1252,6 +1426,8 @@ lay_down_one_column (NautilusIconContainer *container,
 
         is_rtl = nautilus_icon_container_is_layout_rtl (container);
 
+	neighbor_index_record_line (container, line_start, line_end);
+
 	/* Lay out the icons along the baseline. */
 	y = y_start;
 	i = 0;
@@ -1678,23 +1854,19 @@ compare_icons_by_position (gconstpointer a, gconstpointer b)
 		center_a - center_b;
 }
 
+#define BITS_PER_GRID_WORD ((int) (sizeof (gulong) * 8))
+
 static PlacementGrid *
-placement_grid_new (NautilusIconContainer *container, gboolean tight)
+placement_grid_new_for_size (int width, int height, gboolean tight)
 {
 	PlacementGrid *grid;
-	int width, height;
 	int num_columns;
 	int num_rows;
-	int i;
-
-	/* Get container dimensions */
-	width  = CANVAS_WIDTH(container);
-	height = CANVAS_HEIGHT(container);
 
 	num_columns = width / SNAP_SIZE_X;
 	num_rows = height / SNAP_SIZE_Y;
 	
-	if (num_columns == 0 || num_rows == 0) {
+	if (num_columns <= 0 || num_rows <= 0) {
 		return NULL;
 	}
 
@@ -1703,28 +1875,75 @@ placement_grid_new (NautilusIconContainer *container, gboolean tight)
 	grid->num_columns = num_columns;
 	grid->num_rows = num_rows;
 
-	grid->grid_memory = g_new0 (int, (num_rows * num_columns));
-	grid->icon_grid = g_new0 (int *, num_columns);
-	
-	for (i = 0; i < num_columns; i++) {
-		grid->icon_grid[i] = grid->grid_memory + (i * num_rows);
-	}
+	grid->words_per_column = (num_rows + BITS_PER_GRID_WORD - 1) / BITS_PER_GRID_WORD;
+	grid->columns = g_new0 (gulong, num_columns * grid->words_per_column);
+	grid->column_span = g_new0 (gulong, grid->words_per_column);
 	
 	return grid;
 }
 
+static PlacementGrid *
+placement_grid_new (NautilusIconContainer *container, gboolean tight)
+{
+	/* Get container dimensions */
+	return placement_grid_new_for_size (CANVAS_WIDTH(container),
+					    CANVAS_HEIGHT(container),
+					    tight);
+}
+
 static void
 placement_grid_free (PlacementGrid *grid)
 {
-	g_free (grid->icon_grid);
-	g_free (grid->grid_memory);
+	g_free (grid->columns);
+	g_free (grid->column_span);
 	g_free (grid);
 }
 
+static gulong *
+placement_grid_get_column (PlacementGrid *grid, int x)
+{
+	return grid->columns + x * grid->words_per_column;
+}
+
+/* The bits of rows first to last that fall into the given word */
+static gulong
+placement_grid_row_mask (int word, int first, int last)
+{
+	int low, high;
+	gulong mask;
+
+	low = MAX (first - word * BITS_PER_GRID_WORD, 0);
+	high = MIN (last - word * BITS_PER_GRID_WORD, BITS_PER_GRID_WORD - 1);
+
+	mask = ~0UL << low;
+	if (high < BITS_PER_GRID_WORD - 1) {
+		mask &= (1UL << (high + 1)) - 1;
+	}
+
+	return mask;
+}
+
+/* Returns the first taken row from first to last, or -1 if they are all free */
+static int
+placement_grid_find_taken_row (const gulong *column, int first, int last)
+{
+	int word;
+	gulong taken;
+
+	for (word = first / BITS_PER_GRID_WORD; word <= last / BITS_PER_GRID_WORD; word++) {
+		taken = column[word] & placement_grid_row_mask (word, first, last);
+		if (taken != 0) {
+			return word * BITS_PER_GRID_WORD + g_bit_nth_lsf (taken, -1);
+		}
+	}
+
+	return -1;
+}
+
 static gboolean
 placement_grid_position_is_free (PlacementGrid *grid, EelIRect pos)
 {
-	int x, y;
+	int x;
 	
 	g_assert (pos.x0 >= 0 && pos.x0 < grid->num_columns);
 	g_assert (pos.y0 >= 0 && pos.y0 < grid->num_rows);
@@ -1732,10 +1951,9 @@ placement_grid_position_is_free (PlacementGrid *grid, EelIRect pos)
 	g_assert (pos.y1 >= 0 && pos.y1 < grid->num_rows);
 
 	for (x = pos.x0; x <= pos.x1; x++) {
-		for (y = pos.y0; y <= pos.y1; y++) {
-			if (grid->icon_grid[x][y] != 0) {
-				return FALSE;
-			}
+		if (placement_grid_find_taken_row (placement_grid_get_column (grid, x),
+						   pos.y0, pos.y1) >= 0) {
+			return FALSE;
 		}
 	}
 
@@ -1745,7 +1963,8 @@ placement_grid_position_is_free (PlacementGrid *grid, EelIRect pos)
 static void
 placement_grid_mark (PlacementGrid *grid, EelIRect pos)
 {
-	int x, y;
+	gulong *column;
+	int x, word;
 	
 	g_assert (pos.x0 >= 0 && pos.x0 < grid->num_columns);
 	g_assert (pos.y0 >= 0 && pos.y0 < grid->num_rows);
@@ -1753,12 +1972,40 @@ placement_grid_mark (PlacementGrid *grid, EelIRect pos)
 	g_assert (pos.y1 >= 0 && pos.y1 < grid->num_rows);
 
 	for (x = pos.x0; x <= pos.x1; x++) {
-		for (y = pos.y0; y <= pos.y1; y++) {
-			grid->icon_grid[x][y] = 1;
+		column = placement_grid_get_column (grid, x);
+		for (word = pos.y0 / BITS_PER_GRID_WORD; word <= pos.y1 / BITS_PER_GRID_WORD; word++) {
+			column[word] |= placement_grid_row_mask (word, pos.y0, pos.y1);
 		}
 	}
 }
 
+/* ORs the columns from first to last into grid->column_span */
+static void
+placement_grid_span_columns (PlacementGrid *grid, int first, int last)
+{
+	const gulong *column;
+	int x, word;
+
+	memset (grid->column_span, 0, grid->words_per_column * sizeof (gulong));
+	for (x = first; x <= last; x++) {
+		column = placement_grid_get_column (grid, x);
+		for (word = 0; word < grid->words_per_column; word++) {
+			grid->column_span[word] |= column[word];
+		}
+	}
+}
+
+/* The grid row of an icon top at y, before clamping to the grid */
+static int
+placement_grid_get_top_row (PlacementGrid *grid, int y)
+{
+	if (grid->tight) {
+		return ceil ((double)(y - DESKTOP_PAD_VERTICAL) / SNAP_SIZE_Y);
+	} else {
+		return floor ((double)(y - DESKTOP_PAD_VERTICAL) / SNAP_SIZE_Y);
+	}
+}
+
 static void
 canvas_position_to_grid_position (PlacementGrid *grid,
 				  EelIRect canvas_position,
@@ -1802,6 +2049,111 @@ placement_grid_mark_icon (PlacementGrid *grid, NautilusIcon *icon)
 	placement_grid_mark (grid, grid_pos);
 }
 
+static gboolean
+placement_search_equal (const PlacementSearch *a, const PlacementSearch *b)
+{
+	return a->start_x == b->start_x &&
+		a->start_y == b->start_y &&
+		a->icon_width == b->icon_width &&
+		a->icon_height == b->icon_height &&
+		a->height_for_bound_check == b->height_for_bound_check &&
+		a->column_start_y == b->column_start_y &&
+		a->canvas_width == b->canvas_width &&
+		a->canvas_height == b->canvas_height;
+}
+
+/* Tries positions a SNAP_SIZE_Y step at a time down each column, and
+ * then the next column to the right, until one is free or the columns
+ * run out. Runs of taken rows are skipped in one go: a position whose
+ * top row isn't below a taken row also covers it.
+ */
+static void
+placement_grid_find_position (PlacementGrid *grid,
+			      const PlacementSearch *search,
+			      int *x,
+			      int *y)
+{
+	EelIRect icon_position;
+	EelIRect grid_position;
+	int last_y;
+	int taken_row;
+	int steps;
+
+	icon_position.x0 = search->start_x;
+	icon_position.y0 = search->start_y;
+	if (grid->has_last_search &&
+	    placement_search_equal (&grid->last_search, search)) {
+		icon_position.x0 = grid->last_x;
+		icon_position.y0 = grid->last_y;
+	}
+	icon_position.x1 = icon_position.x0 + search->icon_width;
+	icon_position.y1 = icon_position.y0 + search->icon_height;
+
+	/* The lowest top that leaves room for the whole item */
+	last_y = search->canvas_height - search->height_for_bound_check - DESKTOP_PAD_VERTICAL;
+
+	if (icon_position.x1 >= search->canvas_width) {
+		/* No room to the right, so only the first position is tried */
+		if (icon_position.y0 > last_y) {
+			*x = icon_position.x0 + SNAP_SIZE_X;
+			*y = search->column_start_y;
+			return;
+		}
+
+		canvas_position_to_grid_position (grid, icon_position, &grid_position);
+		*x = icon_position.x0;
+		*y = icon_position.y0;
+		if (!placement_grid_position_is_free (grid, grid_position)) {
+			*y += SNAP_SIZE_Y;
+		}
+		return;
+	}
+
+	for (;;) {
+		canvas_position_to_grid_position (grid, icon_position, &grid_position);
+		placement_grid_span_columns (grid, grid_position.x0, grid_position.x1);
+
+		while (icon_position.y0 <= last_y) {
+			icon_position.y1 = icon_position.y0 + search->icon_height;
+			canvas_position_to_grid_position (grid, icon_position, &grid_position);
+
+			taken_row = placement_grid_find_taken_row (grid->column_span,
+								   grid_position.y0,
+								   grid_position.y1);
+			if (taken_row < 0) {
+				grid->has_last_search = TRUE;
+				grid->last_search = *search;
+				grid->last_x = icon_position.x0;
+				grid->last_y = icon_position.y0;
+
+				*x = icon_position.x0;
+				*y = icon_position.y0;
+				return;
+			}
+
+			if (taken_row >= grid->num_rows - 1) {
+				/* Every position further down covers the last row */
+				break;
+			}
+
+			steps = taken_row + 1 - placement_grid_get_top_row (grid, icon_position.y0);
+			icon_position.y0 += MAX (steps, 1) * SNAP_SIZE_Y;
+		}
+
+		/* Move to the next column */
+		icon_position.y0 = search->column_start_y;
+		icon_position.y1 = icon_position.y0 + search->icon_height;
+		icon_position.x0 += SNAP_SIZE_X;
+		icon_position.x1 = icon_position.x0 + search->icon_width;
+
+		if (icon_position.x1 >= search->canvas_width) {
+			*x = icon_position.x0;
+			*y = icon_position.y0;
+			return;
+		}
+	}
+}
+
 static void
 find_empty_location (NautilusIconContainer *container,
 		     PlacementGrid *grid,
@@ -1811,76 +2163,41 @@ find_empty_location (NautilusIconContainer *container,
 		     int *x, 
 		     int *y)
 {
-	double icon_width, icon_height;
-	int canvas_width;
-	int canvas_height;
-	int height_for_bound_check;
+	PlacementSearch search;
 	EelIRect icon_position;
 	EelDRect pixbuf_rect;
-	gboolean collision;
 
 	/* Get container dimensions */
-	canvas_width  = CANVAS_WIDTH(container);
-	canvas_height = CANVAS_HEIGHT(container);
+	search.canvas_width  = CANVAS_WIDTH(container);
+	search.canvas_height = CANVAS_HEIGHT(container);
 
 	icon_get_bounding_box (icon,
 			       &icon_position.x0, &icon_position.y0,
 			       &icon_position.x1, &icon_position.y1,
 			       BOUNDS_USAGE_FOR_LAYOUT);
-	icon_width = icon_position.x1 - icon_position.x0;
-	icon_height = icon_position.y1 - icon_position.y0;
+	search.icon_width = icon_position.x1 - icon_position.x0;
+	search.icon_height = icon_position.y1 - icon_position.y0;
 
 	icon_get_bounding_box (icon,
 			       NULL, &icon_position.y0,
 			       NULL, &icon_position.y1,
 			       BOUNDS_USAGE_FOR_ENTIRE_ITEM);
-	height_for_bound_check = icon_position.y1 - icon_position.y0;
+	search.height_for_bound_check = icon_position.y1 - icon_position.y0;
 
 	pixbuf_rect = nautilus_icon_canvas_item_get_icon_rectangle (icon->item);
+
+	/* New columns start with the icon on the first baseline */
+	search.column_start_y = DESKTOP_PAD_VERTICAL + SNAP_SIZE_Y - (pixbuf_rect.y1 - pixbuf_rect.y0);
+	while (search.column_start_y < DESKTOP_PAD_VERTICAL) {
+		search.column_start_y += SNAP_SIZE_Y;
+	}
 	
 	/* Start the icon on a grid location */
 	snap_position (container, icon, &start_x, &start_y);
+	search.start_x = start_x;
+	search.start_y = start_y;
 
-	icon_position.x0 = start_x;
-	icon_position.y0 = start_y;
-	icon_position.x1 = icon_position.x0 + icon_width;
-	icon_position.y1 = icon_position.y0 + icon_height;
-
-	do {
-		EelIRect grid_position;
-		gboolean need_new_column;
-
-		collision = FALSE;
-		
-		canvas_position_to_grid_position (grid,
-						  icon_position,
-						  &grid_position);
-
-		need_new_column = icon_position.y0 + height_for_bound_check + DESKTOP_PAD_VERTICAL > canvas_height;
-
-		if (need_new_column ||
-		    !placement_grid_position_is_free (grid, grid_position)) {
-			icon_position.y0 += SNAP_SIZE_Y;
-			icon_position.y1 = icon_position.y0 + icon_height;
-			
-			if (need_new_column) {
-				/* Move to the next column */
-				icon_position.y0 = DESKTOP_PAD_VERTICAL + SNAP_SIZE_Y - (pixbuf_rect.y1 - pixbuf_rect.y0);
-				while (icon_position.y0 < DESKTOP_PAD_VERTICAL) {
-					icon_position.y0 += SNAP_SIZE_Y;
-				}
-				icon_position.y1 = icon_position.y0 + icon_height;
-				
-				icon_position.x0 += SNAP_SIZE_X;
-				icon_position.x1 = icon_position.x0 + icon_width;
-			}
-				
-			collision = TRUE;
-		}
-	} while (collision && (icon_position.x1 < canvas_width));
-
-	*x = icon_position.x0;
-	*y = icon_position.y0;
+	placement_grid_find_position (grid, &search, x, y);
 }
 
 static void
@@ -2171,10 +2488,21 @@ redo_layout_internal (NautilusIconContainer *container)
 	 * the stretched icon, but if we do it we want it to be fast
 	 * and only re-lay-out when it's really needed.
 	 */
+	invalidate_neighbor_index (container);
+
 	if (container->details->auto_layout
 	    && container->details->drag_state != DRAG_STATE_STRETCH) {
 		resort (container);
+
+		container->details->neighbor_index = g_new0 (NautilusIconNeighborIndex, 1);
+		container->details->neighbor_index->lines_are_columns =
+			nautilus_icon_container_is_layout_vertical (container);
+		container->details->neighbor_index->recorded_lines = g_ptr_array_new ();
+		container->details->neighbor_index->is_recording = TRUE;
+
 		lay_down_icons (container, container->details->icons, 0);
+
+		container->details->neighbor_index->is_recording = FALSE;
 	}
 
 	if (nautilus_icon_container_is_layout_rtl (container)) {
@@ -2304,6 +2632,124 @@ invalidate_label_sizes (NautilusIconContainer *container)
 	}
 }
 
+/* Label sizes only depend on the text, the font and a few layout
+ * parameters, so icons with the same name (and the same icon after a
+ * zoom or relayout) can reuse an earlier measurement.
+ */
+#define LABEL_SIZE_CACHE_SIZE 4096
+
+typedef struct {
+	char *key;
+	GList *lru_link;
+	NautilusIconLabelSize size;
+} LabelSizeCacheEntry;
+
+static void
+label_size_cache_entry_free (LabelSizeCacheEntry *entry)
+{
+	g_free (entry->key);
+	g_free (entry);
+}
+
+gboolean
+nautilus_icon_container_lookup_label_size (NautilusIconContainer *container,
+					   const char *key,
+					   NautilusIconLabelSize *size)
+{
+	NautilusIconContainerDetails *details;
+	LabelSizeCacheEntry *entry;
+
+	details = container->details;
+
+	entry = g_hash_table_lookup (details->label_size_cache, key);
+	if (entry == NULL) {
+		return FALSE;
+	}
+
+	g_queue_unlink (details->label_size_lru, entry->lru_link);
+	g_queue_push_head_link (details->label_size_lru, entry->lru_link);
+
+	*size = entry->size;
+	return TRUE;
+}
+
+void
+nautilus_icon_container_store_label_size (NautilusIconContainer *container,
+					  const char *key,
+					  const NautilusIconLabelSize *size)
+{
+	NautilusIconContainerDetails *details;
+	LabelSizeCacheEntry *entry;
+
+	details = container->details;
+
+	entry = g_hash_table_lookup (details->label_size_cache, key);
+	if (entry != NULL) {
+		entry->size = *size;
+		return;
+	}
+
+	if (g_hash_table_size (details->label_size_cache) >= LABEL_SIZE_CACHE_SIZE) {
+		entry = g_queue_pop_tail (details->label_size_lru);
+		g_hash_table_remove (details->label_size_cache, entry->key);
+	}
+
+	entry = g_new (LabelSizeCacheEntry, 1);
+	entry->key = g_strdup (key);
+	entry->size = *size;
+	g_queue_push_head (details->label_size_lru, entry);
+	entry->lru_link = details->label_size_lru->head;
+	g_hash_table_insert (details->label_size_cache, entry->key, entry);
+}
+
+PangoFontDescription *
+nautilus_icon_container_get_label_font_description (NautilusIconContainer *container)
+{
+	NautilusIconContainerDetails *details;
+	PangoContext *context;
+	PangoFontDescription *desc;
+
+	details = container->details;
+
+	desc = details->label_font_descriptions[details->zoom_level];
+	if (desc != NULL) {
+		return desc;
+	}
+
+	if (details->font) {
+		desc = pango_font_description_from_string (details->font);
+	} else {
+		context = gtk_widget_get_pango_context (GTK_WIDGET (container));
+		desc = pango_font_description_copy (pango_context_get_font_description (context));
+		pango_font_description_set_size (desc,
+						 pango_font_description_get_size (desc) +
+						 details->font_size_table [details->zoom_level]);
+	}
+	details->label_font_descriptions[details->zoom_level] = desc;
+
+	return desc;
+}
+
+/* forget the label fonts, and the sizes measured with them */
+static void
+invalidate_label_fonts (NautilusIconContainer *container)
+{
+	NautilusIconContainerDetails *details;
+	int i;
+
+	details = container->details;
+
+	for (i = 0; i <= NAUTILUS_ZOOM_LEVEL_LARGEST; i++) {
+		if (details->label_font_descriptions[i] != NULL) {
+			pango_font_description_free (details->label_font_descriptions[i]);
+			details->label_font_descriptions[i] = NULL;
+		}
+	}
+
+	g_hash_table_remove_all (details->label_size_cache);
+	g_queue_clear (details->label_size_lru);
+}
+
 /* invalidate the entire labels (i.e. their attributes) for all the icons */
 static void
 invalidate_labels (NautilusIconContainer *container)
@@ -2748,6 +3194,11 @@ typedef gboolean (* IsBetterIconFunction) (NautilusIconContainer *container,
 					   NautilusIcon *candidate,
 					   void *data);
 
+static gboolean find_neighbor_icon (NautilusIconContainer *container,
+				    NautilusIcon *start_icon,
+				    IsBetterIconFunction function,
+				    NautilusIcon **neighbor);
+
 static NautilusIcon *
 find_best_icon (NautilusIconContainer *container,
 		NautilusIcon *start_icon,
@@ -2757,6 +3208,10 @@ find_best_icon (NautilusIconContainer *container,
 	GList *p;
 	NautilusIcon *best, *candidate;
 
+	if (find_neighbor_icon (container, start_icon, function, &best)) {
+		return best;
+	}
+
 	best = NULL;
 	for (p = container->details->icons; p != NULL; p = p->next) {
 		candidate = p->data;
@@ -3368,110 +3823,436 @@ previous_column_lowest (NautilusIconContainer *container,
 			NautilusIcon *candidate,
 			void *data)
 {
-	/* sort out icons that are not before the current column */
-	if (compare_with_start_column (container, candidate) <= 0) {
-		return FALSE;
+	/* sort out icons that are not before the current column */
+	if (compare_with_start_column (container, candidate) <= 0) {
+		return FALSE;
+	}
+
+	if (best_so_far != NULL) {
+		if (compare_icons_horizontal_first (container,
+						    best_so_far,
+						    candidate) < 0) {
+			/* candidate is right of the best choice, but left of the current column */
+			return TRUE;
+		}
+
+		if (compare_icons_vertical_first (container,
+						  best_so_far,
+						  candidate) < 0) {
+			return TRUE;
+		}
+	}
+
+	return best_so_far == NULL;
+}
+
+static gboolean
+last_column_lowest (NautilusIconContainer *container,
+		    NautilusIcon *start_icon,
+		    NautilusIcon *best_so_far,
+		    NautilusIcon *candidate,
+		    void *data)
+{
+	if (best_so_far == NULL) {
+		return TRUE;
+	}
+	return compare_icons_horizontal_first (container, best_so_far, candidate) < 0;
+}
+
+static gboolean
+closest_in_90_degrees (NautilusIconContainer *container,
+		       NautilusIcon *start_icon,
+		       NautilusIcon *best_so_far,
+		       NautilusIcon *candidate,
+		       void *data)
+{
+	EelDRect world_rect;
+	int x, y;
+	int dx, dy;
+	int dist;
+	int *best_dist;
+
+
+	world_rect = nautilus_icon_canvas_item_get_icon_rectangle (candidate->item);
+	eel_canvas_w2c
+		(EEL_CANVAS (container),
+		 get_cmp_point_x (container, world_rect),
+		 get_cmp_point_y (container, world_rect),
+		 &x,
+		 &y);
+
+	dx = x - container->details->arrow_key_start_x;
+	dy = y - container->details->arrow_key_start_y;
+	
+	switch (container->details->arrow_key_direction) {
+	case GTK_DIR_UP:
+		if (dy > 0 ||
+		    ABS(dx) > ABS(dy)) {
+			return FALSE;
+		}
+		break;
+	case GTK_DIR_DOWN:
+		if (dy < 0 ||
+		    ABS(dx) > ABS(dy)) {
+			return FALSE;
+		}
+		break;
+	case GTK_DIR_LEFT:
+		if (dx > 0 ||
+		    ABS(dy) > ABS(dx)) {
+			return FALSE;
+		}
+		break;
+	case GTK_DIR_RIGHT:
+		if (dx < 0 ||
+		    ABS(dy) > ABS(dx)) {
+			return FALSE;
+		}
+		break;
+	default:
+		g_assert_not_reached();
+	}
+
+	dist = dx*dx + dy*dy;
+	best_dist = data;
+	
+	if (best_so_far == NULL) {
+		*best_dist = dist;
+		return TRUE;
+	}
+
+	if (dist < *best_dist) {
+		*best_dist = dist;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static int
+compare_neighbor_entries_horizontal_first (gconstpointer a,
+					   gconstpointer b)
+{
+	const NeighborEntry *entry_a, *entry_b;
+
+	entry_a = a;
+	entry_b = b;
+
+	if (entry_a->x != entry_b->x) {
+		return entry_a->x < entry_b->x ? -1 : +1;
+	}
+	if (entry_a->y != entry_b->y) {
+		return entry_a->y < entry_b->y ? -1 : +1;
+	}
+	return 0;
+}
+
+static int
+compare_neighbor_entries_vertical_first (gconstpointer a,
+					 gconstpointer b)
+{
+	const NeighborEntry *entry_a, *entry_b;
+
+	entry_a = a;
+	entry_b = b;
+
+	if (entry_a->y != entry_b->y) {
+		return entry_a->y < entry_b->y ? -1 : +1;
+	}
+	if (entry_a->x != entry_b->x) {
+		return entry_a->x < entry_b->x ? -1 : +1;
+	}
+	return 0;
+}
+
+/* Lines never overlap, so their first icons are enough to order them */
+static int
+compare_neighbor_rows (gconstpointer a,
+		       gconstpointer b)
+{
+	return compare_neighbor_entries_vertical_first
+		(((const NeighborLine *) a)->entries,
+		 ((const NeighborLine *) b)->entries);
+}
+
+static int
+compare_neighbor_columns (gconstpointer a,
+			  gconstpointer b)
+{
+	return compare_neighbor_entries_horizontal_first
+		(((const NeighborLine *) a)->entries,
+		 ((const NeighborLine *) b)->entries);
+}
+
+static void
+build_neighbor_index (NautilusIconContainer *container,
+		      NautilusIconNeighborIndex *index)
+{
+	GPtrArray *icons;
+	NautilusIcon *icon;
+	NeighborLine *line;
+	NeighborEntry *entry;
+	EelDRect world_rect;
+	guint i, j;
+
+	index->lines = g_new (NeighborLine, index->recorded_lines->len);
+	index->n_lines = 0;
+	index->icon_to_entry = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (i = 0; i < index->recorded_lines->len; i++) {
+		icons = g_ptr_array_index (index->recorded_lines, i);
+		if (icons->len == 0) {
+			continue;
+		}
+
+		line = &index->lines[index->n_lines++];
+		line->entries = g_new (NeighborEntry, icons->len);
+		line->n_entries = icons->len;
+
+		for (j = 0; j < icons->len; j++) {
+			icon = g_ptr_array_index (icons, j);
+			entry = &line->entries[j];
+
+			entry->icon = icon;
+			world_rect = nautilus_icon_canvas_item_get_icon_rectangle (icon->item);
+			eel_canvas_w2c
+				(EEL_CANVAS (container),
+				 get_cmp_point_x (container, world_rect),
+				 get_cmp_point_y (container, world_rect),
+				 &entry->x,
+				 &entry->y);
+		}
+
+		/* Right to left layouts are mirrored after they are laid
+		 * down, so the recorded order isn't necessarily the visual one.
+		 */
+		qsort (line->entries, line->n_entries, sizeof (NeighborEntry),
+		       index->lines_are_columns ?
+		       compare_neighbor_entries_vertical_first :
+		       compare_neighbor_entries_horizontal_first);
+	}
+
+	qsort (index->lines, index->n_lines, sizeof (NeighborLine),
+	       index->lines_are_columns ?
+	       compare_neighbor_columns :
+	       compare_neighbor_rows);
+
+	for (i = 0; i < (guint) index->n_lines; i++) {
+		line = &index->lines[i];
+		for (j = 0; j < (guint) line->n_entries; j++) {
+			entry = &line->entries[j];
+			entry->line = i;
+			g_hash_table_insert (index->icon_to_entry, entry->icon, entry);
+
+			if (index->first_in_rows == NULL ||
+			    compare_neighbor_entries_vertical_first (entry, index->first_in_rows) < 0) {
+				index->first_in_rows = entry;
+			}
+			if (index->last_in_rows == NULL ||
+			    compare_neighbor_entries_vertical_first (entry, index->last_in_rows) > 0) {
+				index->last_in_rows = entry;
+			}
+			if (index->last_in_columns == NULL ||
+			    compare_neighbor_entries_horizontal_first (entry, index->last_in_columns) > 0) {
+				index->last_in_columns = entry;
+			}
+		}
+	}
+
+	index->is_built = TRUE;
+}
+
+static NautilusIconNeighborIndex *
+get_neighbor_index (NautilusIconContainer *container)
+{
+	NautilusIconNeighborIndex *index;
+
+	index = container->details->neighbor_index;
+	if (index == NULL || index->is_recording) {
+		return NULL;
+	}
+
+	if (!index->is_built) {
+		build_neighbor_index (container, index);
+	}
+
+	/* Icons added since the layout aren't in it yet, and the
+	 * desktop layout doesn't record any lines.
+	 */
+	if (g_hash_table_size (index->icon_to_entry) !=
+	    g_hash_table_size (container->details->icon_set)) {
+		return NULL;
+	}
+
+	return index;
+}
+
+static NeighborEntry *
+neighbor_in_line (NautilusIconNeighborIndex *index,
+		  NeighborEntry *start,
+		  int step)
+{
+	NeighborLine *line;
+	int position;
+
+	line = &index->lines[start->line];
+	position = (start - line->entries) + step;
+	if (position < 0 || position >= line->n_entries) {
+		return NULL;
+	}
+
+	return &line->entries[position];
+}
+
+static NeighborEntry *
+neighbor_line_end (NautilusIconNeighborIndex *index,
+		   NeighborEntry *start,
+		   int step,
+		   gboolean last)
+{
+	NeighborLine *line;
+	int line_number;
+
+	line_number = start->line + step;
+	if (line_number < 0 || line_number >= index->n_lines) {
+		return NULL;
+	}
+
+	line = &index->lines[line_number];
+	return &line->entries[last ? line->n_entries - 1 : 0];
+}
+
+/* Finds the icon in the line whose bounds across the line include
+ * position, like compare_with_start_column() for rows and
+ * compare_with_start_row() for columns do.
+ */
+static NeighborEntry *
+find_neighbor_across_line (NautilusIconNeighborIndex *index,
+			   NeighborLine *line,
+			   int position)
+{
+	EelCanvasItem *item;
+	int low, high, middle;
+
+	low = 0;
+	high = line->n_entries;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		item = EEL_CANVAS_ITEM (line->entries[middle].icon->item);
+		if ((index->lines_are_columns ? item->y2 : item->x2) < position) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
 	}
 
-	if (best_so_far != NULL) {
-		if (compare_icons_horizontal_first (container,
-						    best_so_far,
-						    candidate) < 0) {
-			/* candidate is right of the best choice, but left of the current column */
-			return TRUE;
-		}
+	if (low == line->n_entries) {
+		return NULL;
+	}
 
-		if (compare_icons_vertical_first (container,
-						  best_so_far,
-						  candidate) < 0) {
-			return TRUE;
-		}
+	item = EEL_CANVAS_ITEM (line->entries[low].icon->item);
+	if ((index->lines_are_columns ? item->y1 : item->x1) > position) {
+		return NULL;
 	}
 
-	return best_so_far == NULL;
+	return &line->entries[low];
 }
 
-static gboolean
-last_column_lowest (NautilusIconContainer *container,
-		    NautilusIcon *start_icon,
-		    NautilusIcon *best_so_far,
-		    NautilusIcon *candidate,
-		    void *data)
+/* Searches the following (step 1) or preceding (step -1) lines,
+ * nearest first.
+ */
+static NeighborEntry *
+find_neighbor_across_lines (NautilusIconNeighborIndex *index,
+			    NeighborEntry *start,
+			    int step,
+			    int position)
 {
-	if (best_so_far == NULL) {
-		return TRUE;
+	NeighborEntry *entry;
+	int i;
+
+	for (i = start->line + step; i >= 0 && i < index->n_lines; i += step) {
+		entry = find_neighbor_across_line (index, &index->lines[i], position);
+		if (entry != NULL) {
+			return entry;
+		}
 	}
-	return compare_icons_horizontal_first (container, best_so_far, candidate) < 0;
+
+	return NULL;
 }
 
+/* Answers find_best_icon() from the neighbor index for the functions
+ * the automatic layout can answer for, with the same result the
+ * function would pick. Returns FALSE if the icons have to be searched.
+ */
 static gboolean
-closest_in_90_degrees (NautilusIconContainer *container,
-		       NautilusIcon *start_icon,
-		       NautilusIcon *best_so_far,
-		       NautilusIcon *candidate,
-		       void *data)
+find_neighbor_icon (NautilusIconContainer *container,
+		    NautilusIcon *start_icon,
+		    IsBetterIconFunction function,
+		    NautilusIcon **neighbor)
 {
-	EelDRect world_rect;
-	int x, y;
-	int dx, dy;
-	int dist;
-	int *best_dist;
-
+	NautilusIconNeighborIndex *index;
+	NeighborEntry *start, *found;
+	gboolean rows;
 
-	world_rect = nautilus_icon_canvas_item_get_icon_rectangle (candidate->item);
-	eel_canvas_w2c
-		(EEL_CANVAS (container),
-		 get_cmp_point_x (container, world_rect),
-		 get_cmp_point_y (container, world_rect),
-		 &x,
-		 &y);
+	index = get_neighbor_index (container);
+	if (index == NULL) {
+		return FALSE;
+	}
+	rows = !index->lines_are_columns;
 
-	dx = x - container->details->arrow_key_start_x;
-	dy = y - container->details->arrow_key_start_y;
-	
-	switch (container->details->arrow_key_direction) {
-	case GTK_DIR_UP:
-		if (dy > 0 ||
-		    ABS(dx) > ABS(dy)) {
-			return FALSE;
-		}
-		break;
-	case GTK_DIR_DOWN:
-		if (dy < 0 ||
-		    ABS(dx) > ABS(dy)) {
+	if (start_icon == NULL) {
+		if (function == leftmost_in_top_row) {
+			found = index->first_in_rows;
+		} else if (function == rightmost_in_bottom_row) {
+			found = index->last_in_rows;
+		} else if (function == last_column_lowest) {
+			found = index->last_in_columns;
+		} else {
 			return FALSE;
 		}
-		break;
-	case GTK_DIR_LEFT:
-		if (dx > 0 ||
-		    ABS(dy) > ABS(dx)) {
+	} else {
+		start = g_hash_table_lookup (index->icon_to_entry, start_icon);
+		if (start == NULL) {
 			return FALSE;
 		}
-		break;
-	case GTK_DIR_RIGHT:
-		if (dx < 0 ||
-		    ABS(dy) > ABS(dx)) {
+
+		if (function == same_row_right_side_leftmost) {
+			found = rows ?
+				neighbor_in_line (index, start, +1) :
+				find_neighbor_across_lines (index, start, +1, start->y);
+		} else if (function == same_row_left_side_rightmost) {
+			found = rows ?
+				neighbor_in_line (index, start, -1) :
+				find_neighbor_across_lines (index, start, -1, start->y);
+		} else if (function == same_column_below_highest) {
+			found = rows ?
+				find_neighbor_across_lines (index, start, +1, start->x) :
+				neighbor_in_line (index, start, +1);
+		} else if (function == same_column_above_lowest) {
+			found = rows ?
+				find_neighbor_across_lines (index, start, -1, start->x) :
+				neighbor_in_line (index, start, -1);
+		} else if (rows && function == next_row_leftmost) {
+			found = neighbor_line_end (index, start, +1, FALSE);
+		} else if (rows && function == next_row_rightmost) {
+			found = neighbor_line_end (index, start, +1, TRUE);
+		} else if (rows && function == previous_row_rightmost) {
+			found = neighbor_line_end (index, start, -1, TRUE);
+		} else if (!rows && function == next_column_highest) {
+			found = neighbor_line_end (index, start, +1, FALSE);
+		} else if (!rows && function == next_column_bottommost) {
+			found = neighbor_line_end (index, start, +1, TRUE);
+		} else if (!rows && function == previous_column_highest) {
+			found = neighbor_line_end (index, start, -1, FALSE);
+		} else if (!rows && function == previous_column_lowest) {
+			found = neighbor_line_end (index, start, -1, TRUE);
+		} else {
 			return FALSE;
 		}
-		break;
-	default:
-		g_assert_not_reached();
-	}
-
-	dist = dx*dx + dy*dy;
-	best_dist = data;
-	
-	if (best_so_far == NULL) {
-		*best_dist = dist;
-		return TRUE;
-	}
-
-	if (dist < *best_dist) {
-		*best_dist = dist;
-		return TRUE;
 	}
 
-	return FALSE;
+	*neighbor = found != NULL ? found->icon : NULL;
+	return TRUE;
 }
 
 static EelDRect 
@@ -4035,8 +4816,14 @@ finalize (GObject *object)
 	g_hash_table_destroy (details->icon_set);
 	details->icon_set = NULL;
 
+	invalidate_neighbor_index (NAUTILUS_ICON_CONTAINER (object));
+
 	g_free (details->font);
 
+	invalidate_label_fonts (NAUTILUS_ICON_CONTAINER (object));
+	g_hash_table_destroy (details->label_size_cache);
+	g_queue_free (details->label_size_lru);
+
 	if (details->a11y_item_action_queue != NULL) {
 		while (!g_queue_is_empty (details->a11y_item_action_queue)) {
 			g_free (g_queue_pop_head (details->a11y_item_action_queue));
@@ -4207,6 +4994,9 @@ style_set (GtkWidget *widget,
 
 	nautilus_icon_container_theme_changed (NAUTILUS_ICON_CONTAINER (widget));	
 
+	/* the default font may have changed */
+	invalidate_label_fonts (container);
+
 	if (GTK_WIDGET_REALIZED (widget)) {
 		invalidate_label_sizes (container);
 		nautilus_icon_container_request_update_all (container);
@@ -4962,69 +5752,67 @@ nautilus_icon_container_get_icon_text (NautilusIconContainer *container,
 	klass->get_icon_text (container, data, editable_text, additional_text, include_invisible);
 }
 
+static void
+search_index_add_icon (NautilusIconContainer *container,
+		       NautilusIcon *icon)
+{
+	char *name;
+
+	name = NULL;
+	nautilus_icon_container_get_icon_text (container, icon->data, &name,
+					       NULL, TRUE);
+
+	/* This can happen if a key event is handled really early while
+	 * loading the icon container, before the items have all been
+	 * updated once.
+	 */
+	if (name == NULL) {
+		nautilus_prefix_index_remove (container->details->search_index, icon);
+		return;
+	}
+
+	nautilus_prefix_index_add (container->details->search_index, icon, name);
+	g_free (name);
+}
+
+static void
+ensure_search_index (NautilusIconContainer *container)
+{
+	GList *p;
+
+	if (container->details->search_index != NULL) {
+		return;
+	}
+
+	container->details->search_index = nautilus_prefix_index_new ();
+	for (p = container->details->icons; p != NULL; p = p->next) {
+		search_index_add_icon (container, p->data);
+	}
+}
+
+/* Selects the nth icon, in name order, that starts with key */
 static gboolean
 nautilus_icon_container_search_iter (NautilusIconContainer *container,
 				     const char *key, gint n)
 {
-	GList *p;
 	NautilusIcon *icon;
-	char *name;
-	int count;
-	char *normalized_key, *case_normalized_key;
-	char *normalized_name, *case_normalized_name;
+	char *case_normalized_key;
 	
 	g_assert (key != NULL);
 	g_assert (n >= 1);
 	
-	normalized_key = g_utf8_normalize (key, -1, G_NORMALIZE_ALL);
-	if (!normalized_key) {
-		return FALSE;
-	}
-	case_normalized_key = g_utf8_casefold (normalized_key, -1);
-	g_free (normalized_key);
+	case_normalized_key = nautilus_prefix_index_make_key (key);
 	if (!case_normalized_key) {
 		return FALSE;
 	}
-	
-	icon = NULL;
-	name = NULL;
-	count = 0;
-	for (p = container->details->icons; p != NULL && count != n; p = p->next) {
-		icon = p->data;
-		nautilus_icon_container_get_icon_text (container, icon->data, &name,
-						       NULL, TRUE);
-		
-		/* This can happen if a key event is handled really early while
-		 * loading the icon container, before the items have all been
-		 * updated once.
-		 */
-		if (!name) {
-			continue;
-		}
-			
-		normalized_name = g_utf8_normalize (name, -1, G_NORMALIZE_ALL);
-		if (!normalized_name) {
-			continue;
-		}
-		case_normalized_name = g_utf8_casefold (normalized_name, -1);
-		g_free (normalized_name);
-		if (!case_normalized_name) {
-			continue;
-		}
-		
-		if (strncmp (case_normalized_key, case_normalized_name,
-			     strlen (case_normalized_key)) == 0) {
-			count++;
-		}
 
-		g_free (case_normalized_name);
-		g_free (name);
-		name = NULL;
-	}
+	ensure_search_index (container);
+	icon = nautilus_prefix_index_lookup_nth (container->details->search_index,
+						 case_normalized_key, n);
 
 	g_free (case_normalized_key);
 
-	if (count == n) {
+	if (icon != NULL) {
 		if (select_one_unselect_others (container, icon)) {
 			g_signal_emit (container, signals[SELECTION_CHANGED], 0);
 		}
@@ -6254,6 +7042,11 @@ nautilus_icon_container_init (NautilusIconContainer *container)
 	details->icon_set = g_hash_table_new (g_direct_hash, g_direct_equal);
 	details->layout_timestamp = UNDEFINED_TIME;
 
+	details->label_size_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+							   NULL,
+							   (GDestroyNotify) label_size_cache_entry_free);
+	details->label_size_lru = g_queue_new ();
+
         details->zoom_level = NAUTILUS_ZOOM_LEVEL_STANDARD;
 
 	details->font_size_table[NAUTILUS_ZOOM_LEVEL_SMALLEST] = -2 * PANGO_SCALE;
@@ -6492,6 +7285,10 @@ nautilus_icon_container_clear (NautilusIconContainer *container)
 	details->layout_timestamp = UNDEFINED_TIME;
 	details->store_layout_timestamps_when_finishing_new_icons = FALSE;
 
+	nautilus_prefix_index_free (details->search_index);
+	details->search_index = NULL;
+	invalidate_neighbor_index (container);
+
 	if (details->icons == NULL) {
 		return;
 	}
@@ -6719,6 +7516,10 @@ icon_destroy (NautilusIconContainer *container,
 	details->icons = g_list_remove (details->icons, icon);
 	details->new_icons = g_list_remove (details->new_icons, icon);
 	g_hash_table_remove (details->icon_set, icon->data);
+	if (details->search_index != NULL) {
+		nautilus_prefix_index_remove (details->search_index, icon);
+	}
+	invalidate_neighbor_index (container);
 
 	was_selected = icon->is_selected;
 
@@ -6903,6 +7704,35 @@ nautilus_icon_container_prioritize_thumbnailing (NautilusIconContainer *containe
 	klass->prioritize_thumbnailing (container, icon->data);
 }
 
+static int
+nautilus_icon_container_report_scroll_position (NautilusIconContainer *container,
+						double position,
+						double page_size)
+{
+	NautilusIconContainerClass *klass;
+
+	klass = NAUTILUS_ICON_CONTAINER_GET_CLASS (container);
+	if (klass->report_scroll_position == NULL ||
+	    klass->prefetch_thumbnails == NULL) {
+		return 0;
+	}
+
+	return klass->report_scroll_position (container, position, page_size);
+}
+
+static void
+nautilus_icon_container_prefetch_thumbnails (NautilusIconContainer *container,
+					     GList *visible_data,
+					     GList *ahead_data)
+{
+	NautilusIconContainerClass *klass;
+
+	klass = NAUTILUS_ICON_CONTAINER_GET_CLASS (container);
+	g_assert (klass->prefetch_thumbnails != NULL);
+
+	klass->prefetch_thumbnails (container, visible_data, ahead_data);
+}
+
 static void
 nautilus_icon_container_update_visible_icons (NautilusIconContainer *container)
 {
@@ -6910,12 +7740,15 @@ nautilus_icon_container_update_visible_icons (NautilusIconContainer *container)
 	double min_y, max_y;
 	double min_x, max_x;
 	double x0, y0, x1, y1;
-	GList *node;
+	double position, page_size, ahead_min, ahead_max, unused;
+	int prefetch_pages;
+	GList *node, *visible_data, *ahead_data;
 	NautilusIcon *icon;
-	gboolean visible;
+	gboolean vertical, visible;
 
 	hadj = gtk_layout_get_hadjustment (GTK_LAYOUT (container));
 	vadj = gtk_layout_get_vadjustment (GTK_LAYOUT (container));
+	vertical = nautilus_icon_container_is_layout_vertical (container);
 
 	min_x = hadj->value;
 	max_x = min_x + GTK_WIDGET (container)->allocation.width;
@@ -6927,6 +7760,36 @@ nautilus_icon_container_update_visible_icons (NautilusIconContainer *container)
 			min_x, min_y, &min_x, &min_y);
 	eel_canvas_c2w (EEL_CANVAS (container),
 			max_x, max_y, &max_x, &max_y);
+
+	/* Thumbnails for the pages being scrolled towards are made
+	 * ahead of time, beyond the visible area.
+	 */
+	if (vertical) {
+		position = hadj->value;
+		page_size = GTK_WIDGET (container)->allocation.width;
+	} else {
+		position = vadj->value;
+		page_size = GTK_WIDGET (container)->allocation.height;
+	}
+	prefetch_pages = nautilus_icon_container_report_scroll_position (container,
+									 position,
+									 page_size);
+	if (prefetch_pages > 0) {
+		ahead_min = position + page_size;
+		ahead_max = ahead_min + prefetch_pages * page_size;
+	} else {
+		ahead_max = position;
+		ahead_min = ahead_max + prefetch_pages * page_size;
+	}
+	if (vertical) {
+		eel_canvas_c2w (EEL_CANVAS (container), ahead_min, 0, &ahead_min, &unused);
+		eel_canvas_c2w (EEL_CANVAS (container), ahead_max, 0, &ahead_max, &unused);
+	} else {
+		eel_canvas_c2w (EEL_CANVAS (container), 0, ahead_min, &unused, &ahead_min);
+		eel_canvas_c2w (EEL_CANVAS (container), 0, ahead_max, &unused, &ahead_max);
+	}
+	visible_data = NULL;
+	ahead_data = NULL;
 	
 	/* Do the iteration in reverse to get the render-order from top to
 	 * bottom for the prioritized thumbnails.
@@ -6947,12 +7810,22 @@ nautilus_icon_container_update_visible_icons (NautilusIconContainer *container)
 					     &x1,
 					     &y1);
 
-			if (nautilus_icon_container_is_layout_vertical (container)) {
+			if (vertical) {
 				visible = x1 >= min_x && x0 <= max_x;
 			} else {
 				visible = y1 >= min_y && y0 <= max_y;
 			}
 
+			if (prefetch_pages != 0) {
+				if (visible) {
+					visible_data = g_list_prepend (visible_data, icon->data);
+				} else if (vertical ?
+					   x1 >= ahead_min && x0 <= ahead_max :
+					   y1 >= ahead_min && y0 <= ahead_max) {
+					ahead_data = g_list_prepend (ahead_data, icon->data);
+				}
+			}
+
 			if (visible) {
 				nautilus_icon_canvas_item_set_is_visible (icon->item, TRUE);
 				nautilus_icon_container_prioritize_thumbnailing (container,
@@ -6962,6 +7835,18 @@ nautilus_icon_container_update_visible_icons (NautilusIconContainer *container)
 			}
 		}
 	}
+
+	if (prefetch_pages != 0) {
+		/* Nearest first */
+		if (prefetch_pages < 0) {
+			ahead_data = g_list_reverse (ahead_data);
+		}
+		nautilus_icon_container_prefetch_thumbnails (container,
+							     visible_data,
+							     ahead_data);
+		g_list_free (visible_data);
+		g_list_free (ahead_data);
+	}
 }
 
 static void
@@ -7304,6 +8189,9 @@ nautilus_icon_container_add (NautilusIconContainer *container,
 	details->new_icons = g_list_prepend (details->new_icons, icon);
 
 	g_hash_table_insert (details->icon_set, data, icon);
+	if (details->search_index != NULL) {
+		search_index_add_icon (container, icon);
+	}
 
 	/* Run an idle function to add the icons. */
 	schedule_redo_layout (container);
@@ -7377,6 +8265,12 @@ nautilus_icon_container_request_update (NautilusIconContainer *container,
 
 	if (icon != NULL) {
 		nautilus_icon_container_update_icon (container, icon);
+		if (container->details->search_index != NULL) {
+			/* The name may have changed, the index is only
+			 * touched if it did.
+			 */
+			search_index_add_icon (container, icon);
+		}
 		schedule_redo_layout (container);
 	}
 }
@@ -7436,6 +8330,10 @@ nautilus_icon_container_request_update_all (NautilusIconContainer *container)
 
 	g_return_if_fail (NAUTILUS_IS_ICON_CONTAINER (container));
 
+	/* Rebuilt on the next search, in case the names changed */
+	nautilus_prefix_index_free (container->details->search_index);
+	container->details->search_index = NULL;
+
 	for (node = container->details->icons; node != NULL; node = node->next) {
 		icon = node->data;
 		nautilus_icon_container_update_icon (container, icon);
@@ -8269,8 +9167,6 @@ nautilus_icon_container_start_renaming_selected_item (NautilusIconContainer *con
 	NautilusIcon *icon;
 	EelDRect icon_rect;
 	EelDRect text_rect;
-	PangoContext *context;
-	PangoFontDescription *desc;
 	const char *editable_text;
 	int x, y, width;
 	int start_offset, end_offset;
@@ -8330,18 +9226,8 @@ nautilus_icon_container_start_renaming_selected_item (NautilusIconContainer *con
 	} 
 
 	/* Set the right font */
-	if (details->font) {
-		desc = pango_font_description_from_string (details->font);
-	} else {
-		context = gtk_widget_get_pango_context (GTK_WIDGET (container));
-		desc = pango_font_description_copy (pango_context_get_font_description (context));
-		pango_font_description_set_size (desc,
-						 pango_font_description_get_size (desc) +
-						 container->details->font_size_table [container->details->zoom_level]);
-	}
 	eel_editable_label_set_font_description (EEL_EDITABLE_LABEL (details->rename_widget),
-						 desc);
-	pango_font_description_free (desc);
+						 nautilus_icon_container_get_label_font_description (container));
 	
 	icon_rect = nautilus_icon_canvas_item_get_icon_rectangle (icon->item);
 	text_rect = nautilus_icon_canvas_item_get_text_rectangle (icon->item, TRUE);
@@ -8829,6 +9715,7 @@ nautilus_icon_container_set_font (NautilusIconContainer *container,
 	g_free (container->details->font);
 	container->details->font = g_strdup (font);
 
+	invalidate_label_fonts (container);
 	invalidate_labels (container);
 	nautilus_icon_container_request_update_all (container);
 	gtk_widget_queue_draw (GTK_WIDGET (container));
@@ -8852,6 +9739,8 @@ nautilus_icon_container_set_font_size_table (NautilusIconContainer *container,
 		}
 	}
 
+	invalidate_label_fonts (container);
+
 	if (old_font_size != container->details->font_size_table[container->details->zoom_level]) {
 		invalidate_labels (container);
 		nautilus_icon_container_request_update_all (container);
@@ -9527,6 +10416,150 @@ check_compute_stretch (int icon_x, int icon_y, int icon_size,
 				current.icon_size);
 }
 
+/* The placement search as it was before the grid became a bitmap:
+ * one step at a time, testing every cell the icon covers, on a plain
+ * array of cells.
+ */
+static void
+find_position_cell_by_cell (PlacementGrid *grid,
+			    const gboolean *cells,
+			    const PlacementSearch *search,
+			    int *x,
+			    int *y)
+{
+	EelIRect icon_position;
+	EelIRect grid_position;
+	gboolean collision;
+	int cell_x, cell_y;
+
+	icon_position.x0 = search->start_x;
+	icon_position.y0 = search->start_y;
+	icon_position.x1 = icon_position.x0 + search->icon_width;
+	icon_position.y1 = icon_position.y0 + search->icon_height;
+
+	do {
+		gboolean need_new_column;
+
+		collision = FALSE;
+		
+		canvas_position_to_grid_position (grid,
+						  icon_position,
+						  &grid_position);
+
+		need_new_column = icon_position.y0 + search->height_for_bound_check + DESKTOP_PAD_VERTICAL > search->canvas_height;
+
+		for (cell_x = grid_position.x0; cell_x <= grid_position.x1; cell_x++) {
+			for (cell_y = grid_position.y0; cell_y <= grid_position.y1; cell_y++) {
+				if (cells[cell_x * grid->num_rows + cell_y]) {
+					collision = TRUE;
+				}
+			}
+		}
+
+		if (need_new_column || collision) {
+			icon_position.y0 += SNAP_SIZE_Y;
+			icon_position.y1 = icon_position.y0 + search->icon_height;
+			
+			if (need_new_column) {
+				/* Move to the next column */
+				icon_position.y0 = search->column_start_y;
+				icon_position.y1 = icon_position.y0 + search->icon_height;
+				
+				icon_position.x0 += SNAP_SIZE_X;
+				icon_position.x1 = icon_position.x0 + search->icon_width;
+			}
+				
+			collision = TRUE;
+		}
+	} while (collision && (icon_position.x1 < search->canvas_width));
+
+	*x = icon_position.x0;
+	*y = icon_position.y0;
+}
+
+static void
+check_mark_position (PlacementGrid *grid,
+		     gboolean *cells,
+		     int x, int y,
+		     int width, int height)
+{
+	EelIRect icon_position;
+	EelIRect grid_position;
+	int cell_x, cell_y;
+
+	icon_position.x0 = x;
+	icon_position.y0 = y;
+	icon_position.x1 = x + width;
+	icon_position.y1 = y + height;
+	canvas_position_to_grid_position (grid, icon_position, &grid_position);
+
+	placement_grid_mark (grid, grid_position);
+	for (cell_x = grid_position.x0; cell_x <= grid_position.x1; cell_x++) {
+		for (cell_y = grid_position.y0; cell_y <= grid_position.y1; cell_y++) {
+			cells[cell_x * grid->num_rows + cell_y] = TRUE;
+		}
+	}
+}
+
+/* Places icons the way the desktop does, runs of them with the same
+ * size and start, and returns how many ended up somewhere else than
+ * the cell by cell search puts them.
+ */
+static int
+check_placement (int canvas_width, int canvas_height, gboolean tight, guint32 seed)
+{
+	PlacementGrid *grid;
+	PlacementSearch search;
+	gboolean *cells;
+	GRand *rand;
+	int i, run, x, y, expected_x, expected_y;
+	int mismatches;
+
+	grid = placement_grid_new_for_size (canvas_width, canvas_height, tight);
+	cells = g_new0 (gboolean, grid->num_columns * grid->num_rows);
+	rand = g_rand_new_with_seed (seed);
+	mismatches = 0;
+
+	/* Icons the user has placed already */
+	for (i = 0; i < 30; i++) {
+		check_mark_position (grid, cells,
+				     g_rand_int_range (rand, -50, canvas_width),
+				     g_rand_int_range (rand, -50, canvas_height),
+				     g_rand_int_range (rand, 1, 150),
+				     g_rand_int_range (rand, 1, 100));
+	}
+
+	search.canvas_width = canvas_width;
+	search.canvas_height = canvas_height;
+
+	for (run = 0; run < 40; run++) {
+		search.icon_width = g_rand_int_range (rand, 10, 120);
+		search.icon_height = g_rand_int_range (rand, 10, 90);
+		search.height_for_bound_check = search.icon_height + g_rand_int_range (rand, 0, 20);
+		search.column_start_y = DESKTOP_PAD_VERTICAL + g_rand_int_range (rand, 0, SNAP_SIZE_Y);
+		search.start_x = g_rand_int_range (rand, -20, canvas_width);
+		search.start_y = g_rand_int_range (rand, -20, canvas_height);
+
+		for (i = g_rand_int_range (rand, 1, 60); i > 0; i--) {
+			find_position_cell_by_cell (grid, cells, &search, &expected_x, &expected_y);
+			placement_grid_find_position (grid, &search, &x, &y);
+			if (x != expected_x || y != expected_y) {
+				mismatches++;
+			}
+
+			check_mark_position (grid, cells,
+					     expected_x, expected_y,
+					     search.icon_width, search.icon_height);
+		}
+	}
+
+	g_rand_free (rand);
+	g_free (cells);
+	placement_grid_free (grid);
+
+	return mismatches;
+}
+
 void
 nautilus_self_check_icon_container (void)
 {
@@ -9534,6 +10567,13 @@ nautilus_self_check_icon_container (void)
 	EEL_CHECK_STRING_RESULT (check_compute_stretch (0, 0, 16, 16, 16, 17, 17), "0,0:17");
 	EEL_CHECK_STRING_RESULT (check_compute_stretch (0, 0, 16, 16, 16, 17, 16), "0,0:16");
 	EEL_CHECK_STRING_RESULT (check_compute_stretch (100, 100, 64, 105, 105, 40, 40), "35,35:129");
+
+	EEL_CHECK_INTEGER_RESULT (check_placement (1024, 768, FALSE, 1), 0);
+	EEL_CHECK_INTEGER_RESULT (check_placement (1024, 768, TRUE, 2), 0);
+	EEL_CHECK_INTEGER_RESULT (check_placement (2560, 1600, FALSE, 3), 0);
+	/* More than one word of rows */
+	EEL_CHECK_INTEGER_RESULT (check_placement (800, 3000, FALSE, 4), 0);
+	EEL_CHECK_INTEGER_RESULT (check_placement (800, 3000, TRUE, 5), 0);
 }
 
 gboolean
@@ -29,6 +29,7 @@
 #include <libnautilus-private/nautilus-icon-canvas-item.h>
 #include <libnautilus-private/nautilus-icon-container.h>
 #include <libnautilus-private/nautilus-icon-dnd.h>
+#include <libnautilus-private/nautilus-prefix-index.h>
 
 /* An Icon. */
 
@@ -68,6 +69,11 @@ typedef struct {
 	eel_boolean_bit has_lazy_position : 1;
 } NautilusIcon;
 
+/* Rows or columns of the last automatic layout, see
+ * nautilus-icon-container.c.
+ */
+typedef struct NautilusIconNeighborIndex NautilusIconNeighborIndex;
+
 
 /* Private NautilusIconContainer members. */
 
@@ -203,6 +209,13 @@ struct NautilusIconContainerDetails {
 	/* font sizes used to draw labels */
 	int font_size_table[NAUTILUS_ZOOM_LEVEL_LARGEST + 1];
 
+	/* label fonts for each zoom level, created on demand */
+	PangoFontDescription *label_font_descriptions[NAUTILUS_ZOOM_LEVEL_LARGEST + 1];
+
+	/* label sizes measured with the fonts above, most recent first */
+	GHashTable *label_size_cache;
+	GQueue *label_size_lru;
+
 	/* pixbuf and color for label highlighting */
 	guint32    highlight_color_rgba;
 	guint32    active_color_rgba;
@@ -220,6 +233,10 @@ struct NautilusIconContainerDetails {
 	int arrow_key_start_x;
 	int arrow_key_start_y;
 	GtkDirectionType arrow_key_direction;
+	/* Where the arrow keys go next, NULL unless the icons were
+	 * laid out automatically.
+	 */
+	NautilusIconNeighborIndex *neighbor_index;
 
 	/* Mode settings. */
 	gboolean single_click_mode;
@@ -289,8 +306,22 @@ struct NautilusIconContainerDetails {
 	GtkWidget *search_entry;
 	guint search_entry_changed_id;
 	guint typeselect_flush_timeout;
+	/* Names of all icons, built on the first search and kept up
+	 * to date after that.
+	 */
+	NautilusPrefixIndex *search_index;
 };
 
+/* Measured size of an icon label, see measure_label_text() */
+typedef struct {
+	int text_width;
+	int text_dx;
+	int text_height;
+	int text_height_for_layout;
+	int text_height_for_entire_text;
+	int editable_text_height;
+} NautilusIconLabelSize;
+
 /* Private functions shared by mutiple files. */
 NautilusIcon *nautilus_icon_container_get_icon_by_uri             (NautilusIconContainer *container,
 								   const char            *uri);
@@ -319,6 +350,15 @@ gboolean      nautilus_icon_container_scroll                      (NautilusIconC
 								   int                    delta_y);
 void          nautilus_icon_container_update_scroll_region        (NautilusIconContainer *container);
 
+/* label fonts and sizes for items */
+PangoFontDescription *nautilus_icon_container_get_label_font_description (NautilusIconContainer *container);
+gboolean      nautilus_icon_container_lookup_label_size           (NautilusIconContainer *container,
+								   const char            *key,
+								   NautilusIconLabelSize *size);
+void          nautilus_icon_container_store_label_size            (NautilusIconContainer *container,
+								   const char            *key,
+								   const NautilusIconLabelSize *size);
+
 /* label color for items */
 GdkGC        *nautilus_icon_container_get_label_color_and_gc      (NautilusIconContainer *container,
 								   GdkColor             **color,
@@ -43,7 +43,11 @@ void nautilus_run_lib_self_checks (void);
 	macro (nautilus_self_check_file_operations) \
 	macro (nautilus_self_check_directory) \
 	macro (nautilus_self_check_file) \
+	macro (nautilus_self_check_file_icon_cache) \
 	macro (nautilus_self_check_icon_container) \
+	macro (nautilus_self_check_prefix_index) \
+	macro (nautilus_self_check_merge_sort) \
+	macro (nautilus_self_check_thumbnail_pack) \
 /* Add new self-check functions to the list above this line. */
 
 /* Generate prototypes for all the functions. */
@@ -0,0 +1,263 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-merge-sort.c: stable sorting of pointer arrays.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-merge-sort.h"
+
+#include "nautilus-lib-self-check-functions.h"
+#include <string.h>
+#include <unistd.h>
+
+/* Runs shorter than this are sorted by insertion */
+#define INSERTION_SORT_ITEMS 16
+
+/* Fewer items aren't worth starting a thread for */
+#define MIN_ITEMS_PER_THREAD 8192
+
+#define MAX_THREADS 8
+
+typedef struct {
+	gpointer *items;
+	gpointer *scratch;	/* as long as items, for merging */
+	guint n_items;
+	GCompareDataFunc compare;
+	gpointer data;
+	int n_threads;
+} SortTask;
+
+static void
+insertion_sort (gpointer *items, guint n_items,
+		GCompareDataFunc compare, gpointer data)
+{
+	gpointer item;
+	guint i, j;
+
+	for (i = 1; i < n_items; i++) {
+		item = items[i];
+		for (j = i; j > 0 && compare (items[j - 1], item, data) > 0; j--) {
+			items[j] = items[j - 1];
+		}
+		items[j] = item;
+	}
+}
+
+/* Merges the sorted runs items[0, middle) and items[middle, n_items) */
+static void
+merge (gpointer *items, gpointer *scratch, guint middle, guint n_items,
+       GCompareDataFunc compare, gpointer data)
+{
+	guint left, right, out;
+
+	/* Already in order, common when resorting */
+	if (compare (items[middle - 1], items[middle], data) <= 0) {
+		return;
+	}
+
+	memcpy (scratch, items, middle * sizeof (gpointer));
+
+	left = 0;
+	right = middle;
+	out = 0;
+	while (left < middle && right < n_items) {
+		/* Taking the left one on ties keeps the sort stable */
+		if (compare (scratch[left], items[right], data) <= 0) {
+			items[out++] = scratch[left++];
+		} else {
+			items[out++] = items[right++];
+		}
+	}
+	while (left < middle) {
+		items[out++] = scratch[left++];
+	}
+}
+
+static void
+merge_sort (gpointer *items, gpointer *scratch, guint n_items,
+	    GCompareDataFunc compare, gpointer data)
+{
+	guint middle;
+
+	if (n_items <= INSERTION_SORT_ITEMS) {
+		insertion_sort (items, n_items, compare, data);
+		return;
+	}
+
+	middle = n_items / 2;
+	merge_sort (items, scratch, middle, compare, data);
+	merge_sort (items + middle, scratch + middle, n_items - middle, compare, data);
+	merge (items, scratch, middle, n_items, compare, data);
+}
+
+static gpointer
+sort_task_run (gpointer callback_data)
+{
+	SortTask *task, left, right;
+	GThread *thread;
+
+	task = callback_data;
+
+	if (task->n_threads < 2 || task->n_items < 2 * MIN_ITEMS_PER_THREAD) {
+		merge_sort (task->items, task->scratch, task->n_items,
+			    task->compare, task->data);
+		return NULL;
+	}
+
+	left = *task;
+	left.n_items = task->n_items / 2;
+	left.n_threads = task->n_threads / 2;
+
+	right = *task;
+	right.items += left.n_items;
+	right.scratch += left.n_items;
+	right.n_items -= left.n_items;
+	right.n_threads -= left.n_threads;
+
+	thread = g_thread_create (sort_task_run, &left, TRUE, NULL);
+	if (thread == NULL) {
+		sort_task_run (&left);
+	}
+	sort_task_run (&right);
+	if (thread != NULL) {
+		g_thread_join (thread);
+	}
+
+	merge (task->items, task->scratch, left.n_items, task->n_items,
+	       task->compare, task->data);
+
+	return NULL;
+}
+
+static int
+get_n_threads (guint n_items)
+{
+	long n_processors;
+
+	if (!g_thread_supported ()) {
+		return 1;
+	}
+
+	n_processors = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+	n_processors = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+	return CLAMP (MIN (n_processors, (long) (n_items / MIN_ITEMS_PER_THREAD)),
+		      1, MAX_THREADS);
+}
+
+void
+nautilus_merge_sort (gpointer *items,
+		     guint n_items,
+		     GCompareDataFunc compare,
+		     gpointer data,
+		     gboolean use_threads)
+{
+	SortTask task;
+
+	if (n_items < 2) {
+		return;
+	}
+
+	task.items = items;
+	task.scratch = g_new (gpointer, n_items);
+	task.n_items = n_items;
+	task.compare = compare;
+	task.data = data;
+	task.n_threads = use_threads ? get_n_threads (n_items) : 1;
+
+	sort_task_run (&task);
+
+	g_free (task.scratch);
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+/* Items are numbers, only the tens are compared */
+static int
+compare_tens (gconstpointer a, gconstpointer b, gpointer data)
+{
+	return GPOINTER_TO_INT (a) / 10 - GPOINTER_TO_INT (b) / 10;
+}
+
+static gboolean
+check_sort (guint n_items, gboolean use_threads)
+{
+	gpointer *items;
+	gboolean sorted;
+	guint i;
+
+	/* Every number of tens appears several times, in decreasing
+	 * order, and the ones are the original order.
+	 */
+	items = g_new (gpointer, n_items);
+	for (i = 0; i < n_items; i++) {
+		items[i] = GINT_TO_POINTER ((int) ((n_items - i) / 7 % 1000 * 10 + i % 10));
+	}
+
+	nautilus_merge_sort (items, n_items, compare_tens, NULL, use_threads);
+
+	sorted = TRUE;
+	for (i = 1; i < n_items; i++) {
+		if (compare_tens (items[i - 1], items[i], NULL) > 0) {
+			sorted = FALSE;
+		}
+	}
+	g_free (items);
+
+	return sorted;
+}
+
+static char *
+check_stable (void)
+{
+	gpointer items[6];
+	GString *result;
+	int i;
+
+	items[0] = GINT_TO_POINTER (21);
+	items[1] = GINT_TO_POINTER (12);
+	items[2] = GINT_TO_POINTER (23);
+	items[3] = GINT_TO_POINTER (14);
+	items[4] = GINT_TO_POINTER (5);
+	items[5] = GINT_TO_POINTER (16);
+
+	nautilus_merge_sort (items, G_N_ELEMENTS (items), compare_tens, NULL, FALSE);
+
+	result = g_string_new (NULL);
+	for (i = 0; i < (int) G_N_ELEMENTS (items); i++) {
+		g_string_append_printf (result, "%s%d", i == 0 ? "" : " ",
+					GPOINTER_TO_INT (items[i]));
+	}
+
+	return g_string_free (result, FALSE);
+}
+
+void
+nautilus_self_check_merge_sort (void)
+{
+	EEL_CHECK_STRING_RESULT (check_stable (), "5 12 14 16 21 23");
+	EEL_CHECK_BOOLEAN_RESULT (check_sort (0, FALSE), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check_sort (1, FALSE), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check_sort (17, FALSE), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check_sort (1000, FALSE), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check_sort (100000, TRUE), TRUE);
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
@@ -0,0 +1,39 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-merge-sort.h: stable sorting of pointer arrays.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_MERGE_SORT_H
+#define NAUTILUS_MERGE_SORT_H
+
+#include <glib.h>
+
+/* Sorts the pointers in items, equal items keep their order.
+ *
+ * With use_threads, large arrays are split up and the parts sorted
+ * on one thread per processor before they are merged, so compare
+ * must be safe to call from several threads at once. It is only
+ * ever called from this thread if threads aren't initialized.
+ */
+void nautilus_merge_sort (gpointer         *items,
+			  guint             n_items,
+			  GCompareDataFunc  compare,
+			  gpointer          data,
+			  gboolean          use_threads);
+
+#endif /* NAUTILUS_MERGE_SORT_H */
@@ -0,0 +1,299 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-prefix-index.c: finding items by the start of their names.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-prefix-index.h"
+
+#include "nautilus-lib-self-check-functions.h"
+#include <string.h>
+
+typedef struct {
+	char *key;
+	gpointer item; /* NULL once removed */
+} IndexEntry;
+
+struct NautilusPrefixIndex {
+	GPtrArray *entries; /* of IndexEntry, sorted unless is_dirty */
+	GHashTable *item_to_entry;
+	gboolean is_dirty;
+	gboolean has_removed_entries;
+};
+
+NautilusPrefixIndex *
+nautilus_prefix_index_new (void)
+{
+	NautilusPrefixIndex *index;
+
+	index = g_new0 (NautilusPrefixIndex, 1);
+	index->entries = g_ptr_array_new ();
+	index->item_to_entry = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	return index;
+}
+
+static void
+entry_free (IndexEntry *entry)
+{
+	g_free (entry->key);
+	g_slice_free (IndexEntry, entry);
+}
+
+void
+nautilus_prefix_index_free (NautilusPrefixIndex *index)
+{
+	guint i;
+
+	if (index == NULL) {
+		return;
+	}
+
+	for (i = 0; i < index->entries->len; i++) {
+		entry_free (g_ptr_array_index (index->entries, i));
+	}
+	g_ptr_array_free (index->entries, TRUE);
+	g_hash_table_destroy (index->item_to_entry);
+	g_free (index);
+}
+
+char *
+nautilus_prefix_index_make_key (const char *string)
+{
+	char *normalized, *key;
+
+	normalized = g_utf8_normalize (string, -1, G_NORMALIZE_ALL);
+	if (normalized == NULL) {
+		return NULL;
+	}
+	key = g_utf8_casefold (normalized, -1);
+	g_free (normalized);
+
+	return key;
+}
+
+void
+nautilus_prefix_index_add (NautilusPrefixIndex *index,
+			   gpointer item,
+			   const char *name)
+{
+	IndexEntry *entry;
+	char *key;
+
+	key = nautilus_prefix_index_make_key (name);
+
+	/* Most updates are for other attributes, keep the order if the
+	 * name is the same.
+	 */
+	entry = g_hash_table_lookup (index->item_to_entry, item);
+	if (entry != NULL && key != NULL && strcmp (entry->key, key) == 0) {
+		g_free (key);
+		return;
+	}
+
+	nautilus_prefix_index_remove (index, item);
+
+	if (key == NULL) {
+		return;
+	}
+
+	entry = g_slice_new (IndexEntry);
+	entry->key = key;
+	entry->item = item;
+	g_ptr_array_add (index->entries, entry);
+	g_hash_table_insert (index->item_to_entry, item, entry);
+
+	index->is_dirty = TRUE;
+}
+
+void
+nautilus_prefix_index_remove (NautilusPrefixIndex *index,
+			      gpointer item)
+{
+	IndexEntry *entry;
+
+	entry = g_hash_table_lookup (index->item_to_entry, item);
+	if (entry == NULL) {
+		return;
+	}
+
+	/* Taken out of the array on the next lookup, so removing
+	 * many items doesn't move the rest each time.
+	 */
+	g_hash_table_remove (index->item_to_entry, item);
+	entry->item = NULL;
+	index->has_removed_entries = TRUE;
+}
+
+static int
+compare_entries (gconstpointer a, gconstpointer b)
+{
+	const IndexEntry *entry_a, *entry_b;
+
+	entry_a = *(const IndexEntry **) a;
+	entry_b = *(const IndexEntry **) b;
+
+	return strcmp (entry_a->key, entry_b->key);
+}
+
+static void
+ensure_sorted (NautilusPrefixIndex *index)
+{
+	IndexEntry *entry;
+	guint i, kept;
+
+	if (index->has_removed_entries) {
+		kept = 0;
+		for (i = 0; i < index->entries->len; i++) {
+			entry = g_ptr_array_index (index->entries, i);
+			if (entry->item == NULL) {
+				entry_free (entry);
+			} else {
+				g_ptr_array_index (index->entries, kept++) = entry;
+			}
+		}
+		g_ptr_array_set_size (index->entries, kept);
+		index->has_removed_entries = FALSE;
+	}
+
+	if (index->is_dirty) {
+		g_ptr_array_sort (index->entries, compare_entries);
+		index->is_dirty = FALSE;
+	}
+}
+
+/* Index of the first entry whose key is not less than key */
+static guint
+lower_bound (NautilusPrefixIndex *index, const char *key)
+{
+	IndexEntry *entry;
+	guint low, high, middle;
+
+	low = 0;
+	high = index->entries->len;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		entry = g_ptr_array_index (index->entries, middle);
+		if (strcmp (entry->key, key) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+gpointer
+nautilus_prefix_index_lookup_nth (NautilusPrefixIndex *index,
+				  const char *key,
+				  int n)
+{
+	IndexEntry *entry;
+	guint position;
+
+	g_return_val_if_fail (n >= 1, NULL);
+
+	ensure_sorted (index);
+
+	/* All keys with the prefix sort right after the prefix itself */
+	position = lower_bound (index, key) + n - 1;
+	if (position >= index->entries->len) {
+		return NULL;
+	}
+
+	entry = g_ptr_array_index (index->entries, position);
+	if (strncmp (entry->key, key, strlen (key)) != 0) {
+		return NULL;
+	}
+
+	return entry->item;
+}
+
+gboolean
+nautilus_prefix_index_has_prefix (NautilusPrefixIndex *index,
+				  gpointer item,
+				  const char *key)
+{
+	IndexEntry *entry;
+
+	entry = g_hash_table_lookup (index->item_to_entry, item);
+
+	return entry != NULL && strncmp (entry->key, key, strlen (key)) == 0;
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+static char *
+check_lookup (NautilusPrefixIndex *index, const char *prefix, int n)
+{
+	char *key;
+	const char *item;
+
+	key = nautilus_prefix_index_make_key (prefix);
+	item = nautilus_prefix_index_lookup_nth (index, key, n);
+	g_free (key);
+
+	return g_strdup (item != NULL ? item : "");
+}
+
+void
+nautilus_self_check_prefix_index (void)
+{
+	static const char banana[] = "banana";
+	static const char apple[] = "Apple";
+	static const char apricot[] = "apricot";
+	static const char aerger[] = "\xc3\x84rger";
+	NautilusPrefixIndex *index;
+	char *key;
+
+	/* The names double as the items */
+	index = nautilus_prefix_index_new ();
+	nautilus_prefix_index_add (index, (gpointer) banana, banana);
+	nautilus_prefix_index_add (index, (gpointer) apple, apple);
+	nautilus_prefix_index_add (index, (gpointer) apricot, apricot);
+	nautilus_prefix_index_add (index, (gpointer) aerger, aerger);
+
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "a", 1), "Apple");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "A", 2), "apricot");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "a", 3), "\xc3\x84rger");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "a", 4), "");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "AP", 2), "apricot");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "apx", 1), "");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "b", 1), "banana");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "\xc3\xa4", 1), "\xc3\x84rger");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "z", 1), "");
+
+	nautilus_prefix_index_remove (index, (gpointer) apple);
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "a", 1), "apricot");
+
+	/* Renaming */
+	nautilus_prefix_index_add (index, (gpointer) banana, "cherry");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "b", 1), "");
+	EEL_CHECK_STRING_RESULT (check_lookup (index, "ch", 1), "banana");
+
+	key = nautilus_prefix_index_make_key ("APR");
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_prefix_index_has_prefix (index, (gpointer) apricot, key), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_prefix_index_has_prefix (index, (gpointer) banana, key), FALSE);
+	EEL_CHECK_BOOLEAN_RESULT (nautilus_prefix_index_has_prefix (index, (gpointer) apple, key), FALSE);
+	g_free (key);
+
+	nautilus_prefix_index_free (index);
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
@@ -0,0 +1,60 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-prefix-index.h: finding items by the start of their names.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_PREFIX_INDEX_H
+#define NAUTILUS_PREFIX_INDEX_H
+
+#include <glib.h>
+
+/* Type-ahead search support. Names are normalized and case folded
+ * once when an item is added, and kept in a sorted array, so finding
+ * the items that start with a typed key is a binary search.
+ *
+ * Keys passed to the lookup functions must come from
+ * nautilus_prefix_index_make_key().
+ */
+typedef struct NautilusPrefixIndex NautilusPrefixIndex;
+
+NautilusPrefixIndex *nautilus_prefix_index_new          (void);
+void                 nautilus_prefix_index_free         (NautilusPrefixIndex *index);
+
+/* Adding an item that is already there replaces its name. The index
+ * isn't changed if the name is the same.
+ */
+void                 nautilus_prefix_index_add          (NautilusPrefixIndex *index,
+							 gpointer             item,
+							 const char          *name);
+void                 nautilus_prefix_index_remove       (NautilusPrefixIndex *index,
+							 gpointer             item);
+
+/* Returns a newly allocated key, or NULL if string isn't valid UTF-8 */
+char *               nautilus_prefix_index_make_key     (const char          *string);
+
+/* The nth (counting from 1) item whose name starts with key, in
+ * the order of the keys, or NULL if there are fewer matches.
+ */
+gpointer             nautilus_prefix_index_lookup_nth   (NautilusPrefixIndex *index,
+							 const char          *key,
+							 int                  n);
+gboolean             nautilus_prefix_index_has_prefix   (NautilusPrefixIndex *index,
+							 gpointer             item,
+							 const char          *key);
+
+#endif /* NAUTILUS_PREFIX_INDEX_H */
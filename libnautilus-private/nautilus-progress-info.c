@@ -33,6 +33,7 @@
 enum {
   CHANGED,
   PROGRESS_CHANGED,
+  QUEUED,
   STARTED,
   FINISHED,
   LAST_SIGNAL
@@ -57,6 +58,7 @@ struct _NautilusProgressInfo
 	char *details;
 	double progress;
 	gboolean activity_mode;
+	gboolean queued;
 	gboolean started;
 	gboolean finished;
 	gboolean paused;
@@ -64,6 +66,7 @@ struct _NautilusProgressInfo
 	GSource *idle_source;
 	gboolean source_is_now;
 	
+	gboolean queue_at_idle;
 	gboolean start_at_idle;
 	gboolean finish_at_idle;
 	gboolean changed_at_idle;
@@ -165,6 +168,15 @@ nautilus_progress_info_class_init (NautilusProgressInfoClass *klass)
 			      g_cclosure_marshal_VOID__VOID,
 			      G_TYPE_NONE, 0);
 	
+	signals[QUEUED] =
+		g_signal_new ("queued",
+			      NAUTILUS_TYPE_PROGRESS_INFO,
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+	
 	signals[STARTED] =
 		g_signal_new ("started",
 			      NAUTILUS_TYPE_PROGRESS_INFO,
@@ -469,6 +481,9 @@ nautilus_progress_info_init (NautilusProgressInfo *info)
 	active_progress_infos = g_list_append (active_progress_infos, info);
 	G_UNLOCK (progress_info);
 
+	/* Queued operations show up in the progress window just like
+	   running ones, so the user can see (and cancel) them */
+	g_signal_connect (info, "queued", (GCallback)new_op_started, NULL);
 	g_signal_connect (info, "started", (GCallback)new_op_started, NULL);
 }
 
@@ -602,10 +617,25 @@ nautilus_progress_info_get_is_paused (NautilusProgressInfo *info)
 	return res;
 }
 
+gboolean
+nautilus_progress_info_get_is_queued (NautilusProgressInfo *info)
+{
+	gboolean res;
+	
+	G_LOCK (progress_info);
+	
+	res = info->queued;
+	
+	G_UNLOCK (progress_info);
+	
+	return res;
+}
+
 static gboolean
 idle_callback (gpointer data)
 {
 	NautilusProgressInfo *info = data;
+	gboolean queue_at_idle;
 	gboolean start_at_idle;
 	gboolean finish_at_idle;
 	gboolean changed_at_idle;
@@ -637,11 +667,13 @@ idle_callback (gpointer data)
 	g_source_unref (source);
 	info->idle_source = NULL;
 	
+	queue_at_idle = info->queue_at_idle;
 	start_at_idle = info->start_at_idle;
 	finish_at_idle = info->finish_at_idle;
 	changed_at_idle = info->changed_at_idle;
 	progress_at_idle = info->progress_at_idle;
 	
+	info->queue_at_idle = FALSE;
 	info->start_at_idle = FALSE;
 	info->finish_at_idle = FALSE;
 	info->changed_at_idle = FALSE;
@@ -649,6 +681,12 @@ idle_callback (gpointer data)
 	
 	G_UNLOCK (progress_info);
 	
+	if (queue_at_idle) {
+		g_signal_emit (info,
+			       signals[QUEUED],
+			       0);
+	}
+	
 	if (start_at_idle) {
 		g_signal_emit (info,
 			       signals[STARTED],
@@ -725,6 +763,21 @@ nautilus_progress_info_resume (NautilusProgressInfo *info)
 	G_UNLOCK (progress_info);
 }
 
+void
+nautilus_progress_info_queue (NautilusProgressInfo *info)
+{
+	G_LOCK (progress_info);
+	
+	if (!info->queued && !info->started) {
+		info->queued = TRUE;
+		
+		info->queue_at_idle = TRUE;
+		queue_idle (info, TRUE);
+	}
+	
+	G_UNLOCK (progress_info);
+}
+
 void
 nautilus_progress_info_start (NautilusProgressInfo *info)
 {
@@ -732,6 +785,7 @@ nautilus_progress_info_start (NautilusProgressInfo *info)
 	
 	if (!info->started) {
 		info->started = TRUE;
+		info->queued = FALSE;
 		
 		info->start_at_idle = TRUE;
 		queue_idle (info, TRUE);
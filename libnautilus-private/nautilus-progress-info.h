@@ -43,6 +43,7 @@ GType nautilus_progress_info_get_type (void) G_GNUC_CONST;
 /* Signals:
    "changed" - status or details changed
    "progress-changed" - the percentage progress changed (or we pulsed if in activity_mode
+   "queued" - emitted when the job is waiting for other jobs to finish
    "started" - emited on job start
    "finished" - emitted when job is done
    
@@ -62,7 +63,9 @@ void          nautilus_progress_info_cancel          (NautilusProgressInfo *info
 gboolean      nautilus_progress_info_get_is_started  (NautilusProgressInfo *info);
 gboolean      nautilus_progress_info_get_is_finished (NautilusProgressInfo *info);
 gboolean      nautilus_progress_info_get_is_paused   (NautilusProgressInfo *info);
+gboolean      nautilus_progress_info_get_is_queued   (NautilusProgressInfo *info);
 
+void          nautilus_progress_info_queue           (NautilusProgressInfo *info);
 void          nautilus_progress_info_start           (NautilusProgressInfo *info);
 void          nautilus_progress_info_finish          (NautilusProgressInfo *info);
 void          nautilus_progress_info_pause           (NautilusProgressInfo *info);
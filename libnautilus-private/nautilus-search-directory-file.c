@@ -212,8 +212,6 @@ nautilus_search_directory_file_init (NautilusSearchDirectoryFile *search_file)
 
 	file->details->file_info_is_up_to_date = TRUE;
 
-	file->details->custom_icon = NULL;
-	file->details->activation_uri = NULL;
 	file->details->got_link_info = TRUE;
 	file->details->link_info_is_up_to_date = TRUE;
 
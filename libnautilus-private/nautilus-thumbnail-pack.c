@@ -0,0 +1,766 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-thumbnail-pack.c: decoded thumbnails of a folder in one
+   memory mapped file.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-thumbnail-pack.h"
+
+#include "nautilus-file-utilities.h"
+#include "nautilus-global-preferences.h"
+#include "nautilus-lib-self-check-functions.h"
+#include <eel/eel-preferences.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <utime.h>
+
+/* A pack is a header, the entries, the uris and then the pixels of
+ * each thumbnail. Numbers are in the byte order of the machine that
+ * wrote it, packs written elsewhere are ignored.
+ */
+
+#define PACK_MAGIC "NTPK"
+#define PACK_VERSION 1
+#define PACK_BYTE_ORDER 0x01020304
+
+#define PACK_DIRECTORY_NAME "thumbnail-packs"
+
+#define PIXELS_ALIGNMENT 16
+
+/* Larger thumbnails are left out, as are any past this many bytes */
+#define MAX_THUMBNAIL_DIMENSION 1024
+#define MAX_PACK_BYTES (256 * 1024 * 1024)
+
+/* After a pack is written, the least recently used ones are removed
+ * until all of them together fit in this many bytes.
+ */
+#define MAX_PACK_DIRECTORY_BYTES (G_GUINT64_CONSTANT (1024) * 1024 * 1024)
+
+typedef struct {
+	char magic[4];
+	guint32 byte_order;
+	guint32 version;
+	guint32 thumbnail_size;
+	guint32 n_entries;
+	guint32 reserved;
+} PackHeader;
+
+typedef struct {
+	guint64 pixels_offset;
+	gint64 mtime;
+	guint32 uri_offset;	/* the uri is NUL terminated */
+	guint32 uri_length;
+	guint32 width;
+	guint32 height;
+	guint32 rowstride;
+	guint32 has_alpha;
+} PackEntry;
+
+struct NautilusThumbnailPack {
+	int ref_count;	/* pixels may be let go on other threads */
+	GMappedFile *mapped_file;
+	const char *contents;
+	int thumbnail_size;
+
+	/* uri in the pack -> PackEntry in the pack */
+	GHashTable *entries;
+};
+
+typedef struct {
+	char *uri;
+	gint64 mtime;
+	GdkPixbuf *thumbnail;
+} BuilderEntry;
+
+struct NautilusThumbnailPackBuilder {
+	int thumbnail_size;
+	GArray *entries;	/* of BuilderEntry */
+	guint64 n_bytes;
+	char *path;
+};
+
+static gboolean use_thumbnail_packs;
+
+gboolean
+nautilus_thumbnail_pack_is_enabled (void)
+{
+	static gboolean setup_autos = FALSE;
+
+	if (!setup_autos) {
+		setup_autos = TRUE;
+		eel_preferences_add_auto_boolean (NAUTILUS_PREFERENCES_USE_THUMBNAIL_PACKS,
+						  &use_thumbnail_packs);
+	}
+
+	return use_thumbnail_packs;
+}
+
+static char *
+get_pack_path (const char *directory_uri)
+{
+	char *user_directory, *checksum, *name, *path;
+
+	user_directory = nautilus_get_user_directory ();
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, directory_uri, -1);
+	name = g_strconcat (checksum, ".pack", NULL);
+
+	path = g_build_filename (user_directory, PACK_DIRECTORY_NAME, name, NULL);
+
+	g_free (name);
+	g_free (checksum);
+	g_free (user_directory);
+
+	return path;
+}
+
+static int
+get_row_bytes (guint width, gboolean has_alpha)
+{
+	return (width * (has_alpha ? 4 : 3) + 3) & ~3;
+}
+
+static gboolean
+entry_is_valid (const PackEntry *entry,
+		const char *contents,
+		gsize length)
+{
+	if (entry->uri_offset >= length ||
+	    entry->uri_length >= length - entry->uri_offset ||
+	    contents[entry->uri_offset + entry->uri_length] != '\0') {
+		return FALSE;
+	}
+
+	if (entry->width == 0 || entry->width > MAX_THUMBNAIL_DIMENSION ||
+	    entry->height == 0 || entry->height > MAX_THUMBNAIL_DIMENSION ||
+	    entry->rowstride != (guint32) get_row_bytes (entry->width, entry->has_alpha)) {
+		return FALSE;
+	}
+
+	return entry->pixels_offset % PIXELS_ALIGNMENT == 0 &&
+		entry->pixels_offset <= length &&
+		(guint64) entry->rowstride * entry->height <= length - entry->pixels_offset;
+}
+
+static NautilusThumbnailPack *
+open_path (const char *path, int thumbnail_size)
+{
+	NautilusThumbnailPack *pack;
+	GMappedFile *mapped_file;
+	const char *contents;
+	const PackHeader *header;
+	const PackEntry *entry;
+	gsize length;
+	guint i;
+
+	mapped_file = g_mapped_file_new (path, FALSE, NULL);
+	if (mapped_file == NULL) {
+		return NULL;
+	}
+
+	contents = g_mapped_file_get_contents (mapped_file);
+	length = g_mapped_file_get_length (mapped_file);
+	header = (const PackHeader *) contents;
+
+	if (length < sizeof (PackHeader) ||
+	    memcmp (header->magic, PACK_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->byte_order != PACK_BYTE_ORDER ||
+	    header->version != PACK_VERSION ||
+	    header->thumbnail_size != (guint32) thumbnail_size ||
+	    header->n_entries > (length - sizeof (PackHeader)) / sizeof (PackEntry)) {
+		g_mapped_file_free (mapped_file);
+		return NULL;
+	}
+
+	pack = g_new0 (NautilusThumbnailPack, 1);
+	pack->ref_count = 1;
+	pack->mapped_file = mapped_file;
+	pack->contents = contents;
+	pack->thumbnail_size = thumbnail_size;
+	pack->entries = g_hash_table_new (g_str_hash, g_str_equal);
+
+	entry = (const PackEntry *) (contents + sizeof (PackHeader));
+	for (i = 0; i < header->n_entries; i++, entry++) {
+		/* Anything that doesn't fit is ignored, the file may
+		 * have been cut short.
+		 */
+		if (entry_is_valid (entry, contents, length)) {
+			g_hash_table_insert (pack->entries,
+					     (char *) contents + entry->uri_offset,
+					     (gpointer) entry);
+		}
+	}
+
+	return pack;
+}
+
+NautilusThumbnailPack *
+nautilus_thumbnail_pack_open (const char *directory_uri,
+			      int thumbnail_size)
+{
+	NautilusThumbnailPack *pack;
+	char *path;
+
+	path = get_pack_path (directory_uri);
+	pack = open_path (path, thumbnail_size);
+	g_free (path);
+
+	return pack;
+}
+
+NautilusThumbnailPack *
+nautilus_thumbnail_pack_ref (NautilusThumbnailPack *pack)
+{
+	g_atomic_int_inc (&pack->ref_count);
+
+	return pack;
+}
+
+void
+nautilus_thumbnail_pack_unref (NautilusThumbnailPack *pack)
+{
+	if (pack == NULL || !g_atomic_int_dec_and_test (&pack->ref_count)) {
+		return;
+	}
+
+	g_hash_table_destroy (pack->entries);
+	g_mapped_file_free (pack->mapped_file);
+	g_free (pack);
+}
+
+static void
+pixels_destroyed (guchar *pixels, gpointer callback_data)
+{
+	nautilus_thumbnail_pack_unref (callback_data);
+}
+
+GdkPixbuf *
+nautilus_thumbnail_pack_lookup (NautilusThumbnailPack *pack,
+				const char *uri,
+				time_t mtime)
+{
+	const PackEntry *entry;
+
+	entry = g_hash_table_lookup (pack->entries, uri);
+	if (entry == NULL || entry->mtime != (gint64) mtime) {
+		return NULL;
+	}
+
+	return gdk_pixbuf_new_from_data ((const guchar *) pack->contents + entry->pixels_offset,
+					 GDK_COLORSPACE_RGB,
+					 entry->has_alpha,
+					 8,
+					 entry->width,
+					 entry->height,
+					 entry->rowstride,
+					 pixels_destroyed,
+					 nautilus_thumbnail_pack_ref (pack));
+}
+
+NautilusThumbnailPackBuilder *
+nautilus_thumbnail_pack_builder_new (int thumbnail_size)
+{
+	NautilusThumbnailPackBuilder *builder;
+
+	builder = g_new0 (NautilusThumbnailPackBuilder, 1);
+	builder->thumbnail_size = thumbnail_size;
+	builder->entries = g_array_new (FALSE, FALSE, sizeof (BuilderEntry));
+
+	return builder;
+}
+
+void
+nautilus_thumbnail_pack_builder_free (NautilusThumbnailPackBuilder *builder)
+{
+	BuilderEntry *entry;
+	guint i;
+
+	for (i = 0; i < builder->entries->len; i++) {
+		entry = &g_array_index (builder->entries, BuilderEntry, i);
+		g_free (entry->uri);
+		g_object_unref (entry->thumbnail);
+	}
+	g_array_free (builder->entries, TRUE);
+	g_free (builder->path);
+	g_free (builder);
+}
+
+void
+nautilus_thumbnail_pack_builder_add (NautilusThumbnailPackBuilder *builder,
+				     const char *uri,
+				     time_t mtime,
+				     GdkPixbuf *thumbnail)
+{
+	BuilderEntry entry;
+	int width, height;
+	guint64 n_bytes;
+
+	width = gdk_pixbuf_get_width (thumbnail);
+	height = gdk_pixbuf_get_height (thumbnail);
+
+	if (gdk_pixbuf_get_colorspace (thumbnail) != GDK_COLORSPACE_RGB ||
+	    gdk_pixbuf_get_bits_per_sample (thumbnail) != 8 ||
+	    gdk_pixbuf_get_n_channels (thumbnail) != (gdk_pixbuf_get_has_alpha (thumbnail) ? 4 : 3) ||
+	    width > MAX_THUMBNAIL_DIMENSION || height > MAX_THUMBNAIL_DIMENSION) {
+		return;
+	}
+
+	n_bytes = strlen (uri) + 1 + sizeof (PackEntry) + PIXELS_ALIGNMENT +
+		(guint64) get_row_bytes (width, gdk_pixbuf_get_has_alpha (thumbnail)) * height;
+	if (builder->n_bytes + n_bytes > MAX_PACK_BYTES) {
+		return;
+	}
+	builder->n_bytes += n_bytes;
+
+	entry.uri = g_strdup (uri);
+	entry.mtime = mtime;
+	entry.thumbnail = g_object_ref (thumbnail);
+	g_array_append_val (builder->entries, entry);
+}
+
+int
+nautilus_thumbnail_pack_builder_get_n_thumbnails (NautilusThumbnailPackBuilder *builder)
+{
+	return builder->entries->len;
+}
+
+static guint64
+align_offset (guint64 offset)
+{
+	return (offset + PIXELS_ALIGNMENT - 1) / PIXELS_ALIGNMENT * PIXELS_ALIGNMENT;
+}
+
+static gboolean
+write_padding (FILE *out, guint64 from, guint64 to)
+{
+	static const char zeroes[PIXELS_ALIGNMENT];
+
+	return fwrite (zeroes, 1, to - from, out) == to - from;
+}
+
+static gboolean
+write_pack (FILE *out, NautilusThumbnailPackBuilder *builder)
+{
+	PackHeader header;
+	PackEntry *pack_entries;
+	BuilderEntry *entry;
+	const guchar *pixels;
+	guint64 offset, strings_end;
+	guint i, n_entries;
+	int row, row_bytes;
+	gboolean success;
+
+	n_entries = builder->entries->len;
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, PACK_MAGIC, sizeof (header.magic));
+	header.byte_order = PACK_BYTE_ORDER;
+	header.version = PACK_VERSION;
+	header.thumbnail_size = builder->thumbnail_size;
+	header.n_entries = n_entries;
+
+	/* Lay the pack out before writing it */
+	pack_entries = g_new0 (PackEntry, n_entries);
+	offset = sizeof (PackHeader) + n_entries * sizeof (PackEntry);
+	for (i = 0; i < n_entries; i++) {
+		entry = &g_array_index (builder->entries, BuilderEntry, i);
+		pack_entries[i].uri_offset = offset;
+		pack_entries[i].uri_length = strlen (entry->uri);
+		offset += pack_entries[i].uri_length + 1;
+	}
+	strings_end = offset;
+	for (i = 0; i < n_entries; i++) {
+		entry = &g_array_index (builder->entries, BuilderEntry, i);
+		offset = align_offset (offset);
+		pack_entries[i].pixels_offset = offset;
+		pack_entries[i].mtime = entry->mtime;
+		pack_entries[i].width = gdk_pixbuf_get_width (entry->thumbnail);
+		pack_entries[i].height = gdk_pixbuf_get_height (entry->thumbnail);
+		pack_entries[i].has_alpha = gdk_pixbuf_get_has_alpha (entry->thumbnail);
+		pack_entries[i].rowstride = get_row_bytes (pack_entries[i].width,
+							   pack_entries[i].has_alpha);
+		offset += (guint64) pack_entries[i].rowstride * pack_entries[i].height;
+	}
+
+	success = fwrite (&header, sizeof (header), 1, out) == 1 &&
+		(n_entries == 0 || fwrite (pack_entries, sizeof (PackEntry), n_entries, out) == n_entries);
+
+	for (i = 0; success && i < n_entries; i++) {
+		entry = &g_array_index (builder->entries, BuilderEntry, i);
+		success = fwrite (entry->uri, 1, pack_entries[i].uri_length + 1, out) ==
+			pack_entries[i].uri_length + 1;
+	}
+
+	offset = strings_end;
+	for (i = 0; success && i < n_entries; i++) {
+		entry = &g_array_index (builder->entries, BuilderEntry, i);
+		success = write_padding (out, offset, pack_entries[i].pixels_offset);
+
+		/* Rows of a pixbuf may be padded differently */
+		pixels = gdk_pixbuf_get_pixels (entry->thumbnail);
+		row_bytes = pack_entries[i].width * (pack_entries[i].has_alpha ? 4 : 3);
+		for (row = 0; success && row < (int) pack_entries[i].height; row++) {
+			success = fwrite (pixels + row * gdk_pixbuf_get_rowstride (entry->thumbnail),
+					  1, row_bytes, out) == (size_t) row_bytes &&
+				write_padding (out, row_bytes, pack_entries[i].rowstride);
+		}
+
+		offset = pack_entries[i].pixels_offset +
+			(guint64) pack_entries[i].rowstride * pack_entries[i].height;
+	}
+
+	g_free (pack_entries);
+
+	return success;
+}
+
+/* Writes a new file and renames it over the old one, which may still
+ * be mapped by this or another process.
+ */
+static gboolean
+write_path (NautilusThumbnailPackBuilder *builder, const char *path)
+{
+	char *temp_path;
+	FILE *out;
+	int fd;
+	gboolean success;
+
+	temp_path = g_strconcat (path, ".XXXXXX", NULL);
+	fd = g_mkstemp (temp_path);
+	if (fd < 0) {
+		g_free (temp_path);
+		return FALSE;
+	}
+
+	out = fdopen (fd, "wb");
+	if (out == NULL) {
+		close (fd);
+		success = FALSE;
+	} else {
+		success = write_pack (out, builder);
+		success = fclose (out) == 0 && success;
+	}
+
+	if (success) {
+		success = g_rename (temp_path, path) == 0;
+	}
+	if (!success) {
+		g_unlink (temp_path);
+	}
+	g_free (temp_path);
+
+	return success;
+}
+
+typedef struct {
+	char *path;
+	time_t last_used;
+	guint64 size;
+} PackFile;
+
+static int
+compare_pack_files_by_last_use (gconstpointer a, gconstpointer b)
+{
+	const PackFile *pack_a = a, *pack_b = b;
+
+	if (pack_a->last_used != pack_b->last_used) {
+		return pack_a->last_used < pack_b->last_used ? -1 : 1;
+	}
+	return strcmp (pack_a->path, pack_b->path);
+}
+
+/* Packs are mapped without being written to, so the access time is
+ * the best sign of use there is. With relatime it is still updated
+ * once a day, and it can't be older than the last write.
+ */
+static void
+prune_pack_directory (const char *pack_directory,
+		      const char *keep_path,
+		      guint64 max_bytes)
+{
+	GDir *dir;
+	const char *name;
+	struct stat statbuf;
+	PackFile *pack;
+	GList *packs, *node;
+	guint64 total_bytes;
+
+	dir = g_dir_open (pack_directory, 0, NULL);
+	if (dir == NULL) {
+		return;
+	}
+
+	packs = NULL;
+	total_bytes = 0;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		if (!g_str_has_suffix (name, ".pack")) {
+			continue;
+		}
+
+		pack = g_new (PackFile, 1);
+		pack->path = g_build_filename (pack_directory, name, NULL);
+		if (g_stat (pack->path, &statbuf) != 0) {
+			g_free (pack->path);
+			g_free (pack);
+			continue;
+		}
+		pack->last_used = MAX (statbuf.st_atime, statbuf.st_mtime);
+		pack->size = statbuf.st_size;
+		total_bytes += pack->size;
+		packs = g_list_prepend (packs, pack);
+	}
+	g_dir_close (dir);
+
+	packs = g_list_sort (packs, compare_pack_files_by_last_use);
+	for (node = packs; node != NULL; node = node->next) {
+		pack = node->data;
+		if (total_bytes > max_bytes &&
+		    strcmp (pack->path, keep_path) != 0 &&
+		    g_unlink (pack->path) == 0) {
+			total_bytes -= pack->size;
+		}
+		g_free (pack->path);
+		g_free (pack);
+	}
+	g_list_free (packs);
+}
+
+static gboolean
+write_pack_job (GIOSchedulerJob *job,
+		GCancellable *cancellable,
+		gpointer user_data)
+{
+	NautilusThumbnailPackBuilder *builder;
+	char *pack_directory;
+
+	builder = user_data;
+
+	pack_directory = g_path_get_dirname (builder->path);
+	g_mkdir_with_parents (pack_directory, 0700);
+
+	if (write_path (builder, builder->path)) {
+		prune_pack_directory (pack_directory, builder->path,
+				      MAX_PACK_DIRECTORY_BYTES);
+	}
+	g_free (pack_directory);
+
+	/* Thumbnails from the old pack let go of it here */
+	nautilus_thumbnail_pack_builder_free (builder);
+
+	return FALSE;
+}
+
+void
+nautilus_thumbnail_pack_builder_write_async (NautilusThumbnailPackBuilder *builder,
+					     const char *directory_uri)
+{
+	builder->path = get_pack_path (directory_uri);
+
+	g_io_scheduler_push_job (write_pack_job,
+				 builder,
+				 NULL,
+				 G_PRIORITY_LOW,
+				 NULL);
+}
+
+#if !defined (NAUTILUS_OMIT_SELF_CHECK)
+
+static GdkPixbuf *
+new_filled_pixbuf (gboolean has_alpha, int width, int height, guint32 pixel)
+{
+	GdkPixbuf *pixbuf;
+
+	pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, has_alpha, 8, width, height);
+	gdk_pixbuf_fill (pixbuf, pixel);
+
+	return pixbuf;
+}
+
+static char *
+describe_lookup (NautilusThumbnailPack *pack, const char *uri, time_t mtime)
+{
+	GdkPixbuf *pixbuf;
+	const guchar *pixels;
+	int last;
+	char *description;
+
+	pixbuf = nautilus_thumbnail_pack_lookup (pack, uri, mtime);
+	if (pixbuf == NULL) {
+		return g_strdup ("none");
+	}
+
+	/* The last pixel, to see that the rows are all there */
+	pixels = gdk_pixbuf_get_pixels (pixbuf);
+	last = (gdk_pixbuf_get_height (pixbuf) - 1) * gdk_pixbuf_get_rowstride (pixbuf) +
+		(gdk_pixbuf_get_width (pixbuf) - 1) * gdk_pixbuf_get_n_channels (pixbuf);
+	description = g_strdup_printf ("%dx%d %s %02x%02x%02x",
+				       gdk_pixbuf_get_width (pixbuf),
+				       gdk_pixbuf_get_height (pixbuf),
+				       gdk_pixbuf_get_has_alpha (pixbuf) ? "RGBA" : "RGB",
+				       pixels[last], pixels[last + 1], pixels[last + 2]);
+	g_object_unref (pixbuf);
+
+	return description;
+}
+
+static char *
+add_pack_file (const char *directory, const char *name, time_t last_used)
+{
+	struct utimbuf times;
+	char *path;
+
+	path = g_build_filename (directory, name, NULL);
+	g_file_set_contents (path, "0123456789", 10, NULL);
+	times.actime = last_used;
+	times.modtime = last_used;
+	g_utime (path, &times);
+
+	return path;
+}
+
+static char *
+describe_pack_directory (const char *directory)
+{
+	const char *names[] = { "a.pack", "b.pack", "c.pack", "d.pack", "other" };
+	GString *description;
+	char *path;
+	guint i;
+
+	description = g_string_new (NULL);
+	for (i = 0; i < G_N_ELEMENTS (names); i++) {
+		path = g_build_filename (directory, names[i], NULL);
+		if (g_file_test (path, G_FILE_TEST_EXISTS)) {
+			g_string_append_printf (description, "%s%s",
+						description->len > 0 ? " " : "", names[i]);
+		}
+		g_free (path);
+	}
+
+	return g_string_free (description, FALSE);
+}
+
+static void
+check_prune_pack_directory (void)
+{
+	char *directory, *paths[5];
+	guint i;
+	int fd;
+
+	/* A unique name for the directory */
+	fd = g_file_open_tmp ("nautilus-thumbnail-packs-XXXXXX", &directory, NULL);
+	if (fd < 0) {
+		return;
+	}
+	close (fd);
+	g_unlink (directory);
+	if (g_mkdir (directory, 0700) != 0) {
+		g_free (directory);
+		return;
+	}
+
+	/* d was just written, so it stays even though it is the oldest */
+	paths[0] = add_pack_file (directory, "a.pack", 3000);
+	paths[1] = add_pack_file (directory, "b.pack", 1000);
+	paths[2] = add_pack_file (directory, "c.pack", 2000);
+	paths[3] = add_pack_file (directory, "d.pack", 500);
+	paths[4] = add_pack_file (directory, "other", 100);
+
+	prune_pack_directory (directory, paths[3], 40);
+	EEL_CHECK_STRING_RESULT (describe_pack_directory (directory), "a.pack b.pack c.pack d.pack other");
+	prune_pack_directory (directory, paths[3], 30);
+	EEL_CHECK_STRING_RESULT (describe_pack_directory (directory), "a.pack c.pack d.pack other");
+	prune_pack_directory (directory, paths[3], 0);
+	EEL_CHECK_STRING_RESULT (describe_pack_directory (directory), "d.pack other");
+
+	for (i = 0; i < G_N_ELEMENTS (paths); i++) {
+		g_unlink (paths[i]);
+		g_free (paths[i]);
+	}
+	g_rmdir (directory);
+	g_free (directory);
+}
+
+static gboolean
+check_opens (const char *path, int thumbnail_size)
+{
+	NautilusThumbnailPack *pack;
+
+	pack = open_path (path, thumbnail_size);
+	nautilus_thumbnail_pack_unref (pack);
+
+	return pack != NULL;
+}
+
+void
+nautilus_self_check_thumbnail_pack (void)
+{
+	NautilusThumbnailPackBuilder *builder;
+	NautilusThumbnailPack *pack;
+	GdkPixbuf *pixbuf;
+	char *path;
+	int fd;
+
+	fd = g_file_open_tmp ("nautilus-thumbnail-pack-XXXXXX", &path, NULL);
+	if (fd < 0) {
+		return;
+	}
+	close (fd);
+
+	builder = nautilus_thumbnail_pack_builder_new (64);
+	pixbuf = new_filled_pixbuf (TRUE, 5, 3, 0x11223344);
+	nautilus_thumbnail_pack_builder_add (builder, "file:///a.png", 1000, pixbuf);
+	g_object_unref (pixbuf);
+	/* 7 pixels of 3 bytes need padding */
+	pixbuf = new_filled_pixbuf (FALSE, 7, 2, 0x556677ff);
+	nautilus_thumbnail_pack_builder_add (builder, "file:///b.jpg", 2000, pixbuf);
+	g_object_unref (pixbuf);
+	EEL_CHECK_INTEGER_RESULT (nautilus_thumbnail_pack_builder_get_n_thumbnails (builder), 2);
+	EEL_CHECK_BOOLEAN_RESULT (write_path (builder, path), TRUE);
+	nautilus_thumbnail_pack_builder_free (builder);
+
+	EEL_CHECK_BOOLEAN_RESULT (check_opens (path, 64), TRUE);
+	EEL_CHECK_BOOLEAN_RESULT (check_opens (path, 96), FALSE);
+
+	pack = open_path (path, 64);
+	if (pack != NULL) {
+		EEL_CHECK_STRING_RESULT (describe_lookup (pack, "file:///a.png", 1000), "5x3 RGBA 112233");
+		EEL_CHECK_STRING_RESULT (describe_lookup (pack, "file:///b.jpg", 2000), "7x2 RGB 556677");
+		EEL_CHECK_STRING_RESULT (describe_lookup (pack, "file:///a.png", 1001), "none");
+		EEL_CHECK_STRING_RESULT (describe_lookup (pack, "file:///c.png", 1000), "none");
+		nautilus_thumbnail_pack_unref (pack);
+	}
+
+	/* A pack cut short keeps the thumbnails that are complete */
+	EEL_CHECK_BOOLEAN_RESULT (truncate (path, 230) == 0, TRUE);
+	pack = open_path (path, 64);
+	if (pack != NULL) {
+		EEL_CHECK_STRING_RESULT (describe_lookup (pack, "file:///a.png", 1000), "5x3 RGBA 112233");
+		EEL_CHECK_STRING_RESULT (describe_lookup (pack, "file:///b.jpg", 2000), "none");
+		nautilus_thumbnail_pack_unref (pack);
+	}
+
+	g_unlink (path);
+	g_free (path);
+
+	check_prune_pack_directory ();
+}
+
+#endif /* !NAUTILUS_OMIT_SELF_CHECK */
@@ -0,0 +1,68 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-thumbnail-pack.h: decoded thumbnails of a folder in one
+   memory mapped file.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_THUMBNAIL_PACK_H
+#define NAUTILUS_THUMBNAIL_PACK_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <time.h>
+
+/* Reading a folder's thumbnails means reading and decoding a PNG
+ * for each file. A pack keeps the decoded thumbnails of a folder in
+ * one file in ~/.nautilus, so the next time the folder is shown they
+ * are mapped in instead. Each thumbnail is stored with the uri and
+ * modification time of its file, and is only used while the file
+ * still has that modification time.
+ *
+ * Packs are only used if the use_thumbnail_packs preference is set.
+ */
+
+typedef struct NautilusThumbnailPack NautilusThumbnailPack;
+typedef struct NautilusThumbnailPackBuilder NautilusThumbnailPackBuilder;
+
+gboolean                      nautilus_thumbnail_pack_is_enabled   (void);
+
+/* Returns NULL if the folder has no pack for thumbnails of this size */
+NautilusThumbnailPack *       nautilus_thumbnail_pack_open         (const char                   *directory_uri,
+								    int                           thumbnail_size);
+NautilusThumbnailPack *       nautilus_thumbnail_pack_ref          (NautilusThumbnailPack        *pack);
+void                          nautilus_thumbnail_pack_unref        (NautilusThumbnailPack        *pack);
+
+/* The pixbuf shares the memory of the pack, and must not be changed */
+GdkPixbuf *                   nautilus_thumbnail_pack_lookup       (NautilusThumbnailPack        *pack,
+								    const char                   *uri,
+								    time_t                        mtime);
+
+NautilusThumbnailPackBuilder *nautilus_thumbnail_pack_builder_new  (int                           thumbnail_size);
+void                          nautilus_thumbnail_pack_builder_free (NautilusThumbnailPackBuilder *builder);
+void                          nautilus_thumbnail_pack_builder_add  (NautilusThumbnailPackBuilder *builder,
+								    const char                   *uri,
+								    time_t                        mtime,
+								    GdkPixbuf                    *thumbnail);
+int                           nautilus_thumbnail_pack_builder_get_n_thumbnails
+								   (NautilusThumbnailPackBuilder *builder);
+
+/* Replaces the folder's pack in a thread, and frees the builder */
+void                          nautilus_thumbnail_pack_builder_write_async
+								   (NautilusThumbnailPackBuilder *builder,
+								    const char                   *directory_uri);
+
+#endif /* NAUTILUS_THUMBNAIL_PACK_H */
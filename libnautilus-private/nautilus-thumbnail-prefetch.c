@@ -0,0 +1,219 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-thumbnail-prefetch.c: thumbnails for the pages a view is
+   scrolling towards.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-thumbnail-prefetch.h"
+
+#include "nautilus-directory-notify.h"
+#include "nautilus-file-private.h"
+#include "nautilus-thumbnails.h"
+
+/* Paging faster than this prefetches two pages instead of one */
+#define FAST_PAGES_PER_SECOND 2.0
+
+/* A longer pause starts a new scroll, the old speed is forgotten */
+#define SCROLL_PAUSE_SECONDS 0.5
+
+/* Files whose thumbnails are being made are remembered up to this, to
+ * be cancelled. Older ones are left to finish.
+ */
+#define MAX_STARTED_FILES 512
+
+struct NautilusThumbnailPrefetch {
+	gboolean has_position;
+	double position;
+	GTimeVal time;
+
+	int direction;
+	double pages_per_second;
+
+	/* Files prefetch started thumbnails for, oldest first */
+	GQueue started;
+};
+
+NautilusThumbnailPrefetch *
+nautilus_thumbnail_prefetch_new (void)
+{
+	NautilusThumbnailPrefetch *prefetch;
+
+	prefetch = g_new0 (NautilusThumbnailPrefetch, 1);
+	g_queue_init (&prefetch->started);
+
+	return prefetch;
+}
+
+void
+nautilus_thumbnail_prefetch_free (NautilusThumbnailPrefetch *prefetch)
+{
+	if (prefetch == NULL) {
+		return;
+	}
+
+	nautilus_thumbnail_prefetch_cancel (prefetch);
+	g_free (prefetch);
+}
+
+static void
+forget_oldest_started (NautilusThumbnailPrefetch *prefetch)
+{
+	NautilusFile *file;
+
+	file = g_queue_pop_head (&prefetch->started);
+	nautilus_file_unref (file);
+}
+
+/* Drops the files whose thumbnails are done */
+static void
+forget_finished (NautilusThumbnailPrefetch *prefetch)
+{
+	GList *node, *next;
+	NautilusFile *file;
+
+	for (node = prefetch->started.head; node != NULL; node = next) {
+		next = node->next;
+		file = node->data;
+
+		if (!nautilus_file_is_thumbnailing (file)) {
+			g_queue_delete_link (&prefetch->started, node);
+			nautilus_file_unref (file);
+		}
+	}
+}
+
+void
+nautilus_thumbnail_prefetch_cancel (NautilusThumbnailPrefetch *prefetch)
+{
+	NautilusFile *file;
+	char *uri;
+
+	while (!g_queue_is_empty (&prefetch->started)) {
+		file = g_queue_pop_head (&prefetch->started);
+
+		uri = nautilus_file_get_uri (file);
+		if (nautilus_thumbnail_remove_from_queue (uri)) {
+			/* Views showing it get the icon again, and ask for
+			 * the thumbnail themselves if it is still visible.
+			 */
+			nautilus_file_set_is_thumbnailing (file, FALSE);
+			nautilus_file_changed (file);
+		}
+		g_free (uri);
+
+		nautilus_file_unref (file);
+	}
+}
+
+int
+nautilus_thumbnail_prefetch_scrolled (NautilusThumbnailPrefetch *prefetch,
+				      double position,
+				      double page_size)
+{
+	GTimeVal now;
+	double delta, elapsed, pages_per_second;
+	int direction;
+
+	g_get_current_time (&now);
+
+	if (!prefetch->has_position) {
+		prefetch->has_position = TRUE;
+		prefetch->position = position;
+		prefetch->time = now;
+		return 0;
+	}
+
+	delta = position - prefetch->position;
+	if (delta == 0 || page_size <= 0) {
+		return 0;
+	}
+
+	elapsed = (now.tv_sec - prefetch->time.tv_sec) +
+		(now.tv_usec - prefetch->time.tv_usec) / (double) G_USEC_PER_SEC;
+	elapsed = MAX (elapsed, 0.001);
+	pages_per_second = ABS (delta) / page_size / elapsed;
+
+	direction = delta > 0 ? 1 : -1;
+	if (direction != prefetch->direction) {
+		/* The pages prefetched are behind now */
+		nautilus_thumbnail_prefetch_cancel (prefetch);
+		prefetch->pages_per_second = pages_per_second;
+	} else if (elapsed > SCROLL_PAUSE_SECONDS) {
+		prefetch->pages_per_second = pages_per_second;
+	} else {
+		/* Single scroll events are too uneven to go by */
+		prefetch->pages_per_second = (prefetch->pages_per_second + pages_per_second) / 2;
+	}
+
+	prefetch->direction = direction;
+	prefetch->position = position;
+	prefetch->time = now;
+
+	if (prefetch->pages_per_second >= FAST_PAGES_PER_SECOND) {
+		return 2 * direction;
+	}
+	return direction;
+}
+
+static void
+prefetch_files (NautilusThumbnailPrefetch *prefetch,
+		GList *files,
+		gboolean remember_started)
+{
+	GList *node;
+	NautilusFile *file;
+	char *uri;
+
+	/* Farthest first, so that each file is queued ahead of those
+	 * farther away.
+	 */
+	for (node = g_list_last (files); node != NULL; node = node->prev) {
+		file = NAUTILUS_FILE (node->data);
+
+		/* Files already thumbnailing aren't started again, so
+		 * none is remembered twice.
+		 */
+		if (nautilus_file_prefetch_thumbnail (file) && remember_started) {
+			if (g_queue_get_length (&prefetch->started) >= MAX_STARTED_FILES) {
+				forget_oldest_started (prefetch);
+			}
+			g_queue_push_tail (&prefetch->started, nautilus_file_ref (file));
+		}
+
+		if (nautilus_file_is_thumbnailing (file)) {
+			uri = nautilus_file_get_uri (file);
+			nautilus_thumbnail_prioritize (uri);
+			g_free (uri);
+		}
+	}
+}
+
+void
+nautilus_thumbnail_prefetch_files (NautilusThumbnailPrefetch *prefetch,
+				   GList *visible_files,
+				   GList *ahead_files)
+{
+	forget_finished (prefetch);
+
+	/* Visible files would be asked for again anyway, so they are
+	 * never cancelled.
+	 */
+	prefetch_files (prefetch, ahead_files, TRUE);
+	prefetch_files (prefetch, visible_files, FALSE);
+}
@@ -0,0 +1,53 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-thumbnail-prefetch.h: thumbnails for the pages a view is
+   scrolling towards.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_THUMBNAIL_PREFETCH_H
+#define NAUTILUS_THUMBNAIL_PREFETCH_H
+
+#include <libnautilus-private/nautilus-file.h>
+
+/* A view reports each scroll position, then passes the files it shows
+ * and those in the pages it is scrolling towards. Their thumbnails are
+ * read or made before the others, so they are ready when the files
+ * are scrolled into view. Thumbnails started for pages ahead are
+ * cancelled when the view scrolls back.
+ */
+
+typedef struct NautilusThumbnailPrefetch NautilusThumbnailPrefetch;
+
+NautilusThumbnailPrefetch *nautilus_thumbnail_prefetch_new      (void);
+void                       nautilus_thumbnail_prefetch_free     (NautilusThumbnailPrefetch *prefetch);
+
+/* Position and page size in any unit, usually those of an adjustment.
+ * Returns how many pages ahead to prefetch, negative when scrolling
+ * back and 0 if the position didn't change.
+ */
+int                        nautilus_thumbnail_prefetch_scrolled (NautilusThumbnailPrefetch *prefetch,
+								 double                     position,
+								 double                     page_size);
+
+/* Both lists are nearest first. Visible files come before the others. */
+void                       nautilus_thumbnail_prefetch_files    (NautilusThumbnailPrefetch *prefetch,
+								 GList                     *visible_files,
+								 GList                     *ahead_files);
+void                       nautilus_thumbnail_prefetch_cancel   (NautilusThumbnailPrefetch *prefetch);
+
+#endif /* NAUTILUS_THUMBNAIL_PREFETCH_H */
@@ -593,10 +593,12 @@ nautilus_thumbnail_load_image_cancel (NautilusThumbnailAsyncLoadHandle *handle)
 	g_cancellable_cancel  (handle->cancellable);
 }
 
-void
+/* Returns TRUE if the thumbnail was still waiting to be made */
+gboolean
 nautilus_thumbnail_remove_from_queue (const char *file_uri)
 {
 	GList *node;
+	gboolean removed;
 	
 #ifdef DEBUG_THUMBNAILS
 	g_message ("(Remove from queue) Locking mutex\n");
@@ -607,6 +609,7 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
 	 * MUTEX LOCKED
 	 *********************************/
 
+	removed = FALSE;
 	if (thumbnails_to_make_hash) {
 		node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
 		
@@ -614,6 +617,7 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
 			g_hash_table_remove (thumbnails_to_make_hash, file_uri);
 			free_thumbnail_info (node->data);
 			g_queue_delete_link ((GQueue *)&thumbnails_to_make, node);
+			removed = TRUE;
 		}
 	}
 	
@@ -625,6 +629,8 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
 	g_message ("(Remove from queue) Unlocking mutex\n");
 #endif
 	pthread_mutex_unlock (&thumbnails_mutex);
+
+	return removed;
 }
 
 void
@@ -71,7 +71,7 @@ void       nautilus_update_thumbnail_file_renamed   (const char   *source_file_u
 void       nautilus_remove_thumbnail_for_file       (const char   *file_uri);
 
 /* Queue handling: */
-void       nautilus_thumbnail_remove_from_queue     (const char   *file_uri);
+gboolean   nautilus_thumbnail_remove_from_queue     (const char   *file_uri);
 void       nautilus_thumbnail_remove_all_from_queue (void);
 void       nautilus_thumbnail_prioritize            (const char   *file_uri);
 
@@ -0,0 +1,224 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-trace.c: timing spans for the asynchronous I/O code.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-trace.h"
+
+#include "nautilus-debug-log.h"
+#include <eel/eel-glib-extensions.h>
+#include <unistd.h>
+
+/* Spans kept for each thread, the oldest are overwritten */
+#define SPANS_PER_THREAD 8192
+
+/* Including the terminating nul, an empty location means none */
+#define SPAN_LOCATION_SIZE 128
+
+typedef struct {
+	const char *name;
+	char location[SPAN_LOCATION_SIZE];
+	gint64 start_time;
+	gint64 duration;
+	gint64 queue_wait;
+} TraceSpan;
+
+typedef struct {
+	int thread_number;
+	/* Only written by the owning thread. Readers may see a span
+	 * that is being overwritten, which is harmless since the names
+	 * live forever and the location is read from a copy that is
+	 * terminated again.
+	 */
+	volatile gint next_span;
+	volatile gint num_spans;
+	TraceSpan spans[SPANS_PER_THREAD];
+} TraceRing;
+
+static GStaticPrivate ring_key = G_STATIC_PRIVATE_INIT;
+
+/* All rings ever created, rings are never freed */
+static GStaticMutex rings_mutex = G_STATIC_MUTEX_INIT;
+static GSList *rings;
+static int next_thread_number = 1;
+
+gint64
+nautilus_trace_get_time (void)
+{
+	return eel_get_system_time ();
+}
+
+static char *trace_to_string (void);
+
+static TraceRing *
+get_ring (void)
+{
+	TraceRing *ring;
+	gboolean first_ring;
+
+	ring = g_static_private_get (&ring_key);
+	if (ring != NULL) {
+		return ring;
+	}
+
+	ring = g_new0 (TraceRing, 1);
+
+	g_static_mutex_lock (&rings_mutex);
+	first_ring = rings == NULL;
+	ring->thread_number = next_thread_number++;
+	rings = g_slist_append (rings, ring);
+	g_static_mutex_unlock (&rings_mutex);
+
+	g_static_private_set (&ring_key, ring, NULL);
+
+	/* Not while holding rings_mutex, the debug log calls
+	 * trace_to_string () with its own lock held.
+	 */
+	if (first_ring) {
+		nautilus_debug_log_add_section ("ASYNC TRACE", trace_to_string);
+	}
+
+	return ring;
+}
+
+void
+nautilus_trace_add_span (const char *name,
+			 const char *location,
+			 gint64 start_time,
+			 gint64 queue_wait)
+{
+	TraceRing *ring;
+	TraceSpan *span;
+	int index;
+
+	ring = get_ring ();
+
+	index = ring->next_span;
+	span = &ring->spans[index];
+	span->name = name;
+	g_strlcpy (span->location, location != NULL ? location : "",
+		   sizeof (span->location));
+	span->start_time = start_time;
+	span->duration = nautilus_trace_get_time () - start_time;
+	span->queue_wait = queue_wait;
+
+	g_atomic_int_set (&ring->next_span, (index + 1) % SPANS_PER_THREAD);
+	if (ring->num_spans < SPANS_PER_THREAD) {
+		g_atomic_int_set (&ring->num_spans, ring->num_spans + 1);
+	}
+}
+
+static void
+append_json_string (GString *json, const char *string)
+{
+	const char *p;
+
+	g_string_append_c (json, '"');
+	for (p = string; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\') {
+			g_string_append_c (json, '\\');
+			g_string_append_c (json, *p);
+		} else if ((guchar) *p < 0x20) {
+			g_string_append_printf (json, "\\u%04x", (guchar) *p);
+		} else {
+			g_string_append_c (json, *p);
+		}
+	}
+	g_string_append_c (json, '"');
+}
+
+static void
+append_ring (GString *json, TraceRing *ring, int pid, gboolean *first)
+{
+	TraceSpan span;
+	int num_spans, next_span, i;
+
+	num_spans = g_atomic_int_get (&ring->num_spans);
+	next_span = g_atomic_int_get (&ring->next_span);
+
+	g_string_append_printf (json,
+				"%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+				"\"args\":{\"name\":\"thread %d\"}}",
+				*first ? "" : ",", pid, ring->thread_number, ring->thread_number);
+	*first = FALSE;
+
+	for (i = 0; i < num_spans; i++) {
+		span = ring->spans[(next_span - num_spans + i + SPANS_PER_THREAD) % SPANS_PER_THREAD];
+		if (span.name == NULL) {
+			continue;
+		}
+		span.location[SPAN_LOCATION_SIZE - 1] = '\0';
+
+		g_string_append (json, ",\n{\"name\":");
+		append_json_string (json, span.name);
+		g_string_append_printf (json,
+					",\"cat\":\"nautilus\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+					"\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ",\"args\":{",
+					pid, ring->thread_number,
+					span.start_time, span.duration);
+		if (span.location[0] != '\0') {
+			g_string_append (json, "\"location\":");
+			append_json_string (json, span.location);
+		}
+		if (span.queue_wait >= 0) {
+			g_string_append_printf (json, "%s\"queue_wait_us\":%" G_GINT64_FORMAT,
+						span.location[0] != '\0' ? "," : "",
+						span.queue_wait);
+		}
+		g_string_append (json, "}}");
+	}
+}
+
+static char *
+trace_to_string (void)
+{
+	GString *json;
+	GSList *l;
+	gboolean first;
+	int pid;
+
+	pid = getpid ();
+	first = TRUE;
+
+	json = g_string_new ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	g_static_mutex_lock (&rings_mutex);
+	for (l = rings; l != NULL; l = l->next) {
+		append_ring (json, l->data, pid, &first);
+	}
+	g_static_mutex_unlock (&rings_mutex);
+
+	g_string_append (json, "\n]}\n");
+
+	return g_string_free (json, FALSE);
+}
+
+gboolean
+nautilus_trace_dump (const char *filename,
+		     GError **error)
+{
+	char *data;
+	gboolean success;
+
+	data = trace_to_string ();
+	success = g_file_set_contents (filename, data, -1, error);
+	g_free (data);
+
+	return success;
+}
@@ -0,0 +1,51 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-trace.h: timing spans for the asynchronous I/O code.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_TRACE_H
+#define NAUTILUS_TRACE_H
+
+#include <glib.h>
+
+/* Spans are always recorded, into a fixed size ring for each thread
+ * that only that thread writes to. nautilus_debug_log_dump() includes
+ * them, and nautilus_trace_dump() writes them on their own, in the
+ * Chrome trace event format that chrome://tracing and Perfetto read.
+ *
+ * The name is not copied, so it must be a literal or come from
+ * g_intern_string(). The location is copied into the span, and cut
+ * off if it is longer than fits.
+ */
+
+/* Microseconds, the time base of all spans */
+gint64   nautilus_trace_get_time (void);
+
+/* Records a span from start_time until now. location may be NULL,
+ * queue_wait is how long the work waited before it could start, in
+ * microseconds, or -1 if it didn't wait in a queue.
+ */
+void     nautilus_trace_add_span (const char  *name,
+				  const char  *location,
+				  gint64       start_time,
+				  gint64       queue_wait);
+
+gboolean nautilus_trace_dump     (const char  *filename,
+				  GError     **error);
+
+#endif /* NAUTILUS_TRACE_H */
@@ -138,7 +138,9 @@ vfs_are_all_files_seen (NautilusDirectory *directory)
 {
 	g_assert (NAUTILUS_IS_VFS_DIRECTORY (directory));
 	
-	return directory->details->directory_loaded;
+	/* Files still waiting in the time-sliced queue are not seen yet */
+	return directory->details->directory_loaded &&
+		directory->details->pending_file_info == NULL;
 }
 
 static gboolean
@@ -92,6 +92,14 @@
 #define UPDATE_INTERVAL_TIMEOUT_INTERVAL 250
 /* Milliseconds that have to pass without a change to reset the update interval */
 #define UPDATE_INTERVAL_RESET 1000
+/* Interval at which files are shown while the directory is still loading */
+#define UPDATE_INTERVAL_LOADING 1000
+
+/* How long one round of display_pending_files may take, in microseconds,
+ * and how many files it shows between looking at the clock.
+ */
+#define DISPLAY_PENDING_TIME_SLICE (8 * 1000)
+#define DISPLAY_PENDING_CHECK_TIME_INTERVAL 16
 
 #define SILENT_WINDOW_OPEN_LIMIT 5
 
@@ -204,8 +212,14 @@ struct FMDirectoryViewDetails
 
 	GHashTable *non_ready_files;
 
-	GList *old_added_files;
-	GList *old_changed_files;
+	/* Ready files waiting to be shown, of FileAndDirectory, kept
+	 * sorted as they come in. The hash tables map each of them to
+	 * its place, to move it when its sort keys change.
+	 */
+	GSequence *old_added_files;
+	GSequence *old_changed_files;
+	GHashTable *old_added_file_iters;
+	GHashTable *old_changed_file_iters;
 
 	GList *pending_locations_selected;
 
@@ -218,6 +232,9 @@ struct FMDirectoryViewDetails
 	 * after it finishes loading the directory and its view.
 	 */
 	gboolean loading;
+	/* Set once some files were shown while loading, and how many */
+	gboolean showed_first_files;
+	guint loading_shown_file_count;
 	gboolean menu_states_untrustworthy;
 	gboolean scripts_invalid;
 	gboolean templates_invalid;
@@ -313,6 +330,7 @@ static void     remove_update_status_idle_callback             (FMDirectoryView
 static void     reset_update_interval                          (FMDirectoryView      *view);
 static void     schedule_idle_display_of_pending_files         (FMDirectoryView      *view);
 static void     unschedule_display_of_pending_files            (FMDirectoryView      *view);
+static gboolean display_pending_callback                       (gpointer              data);
 static void     disconnect_model_handlers                      (FMDirectoryView      *view);
 static void     metadata_for_directory_as_file_ready_callback  (NautilusFile         *file,
 								gpointer              callback_data);
@@ -449,21 +467,6 @@ application_launch_parameters_free (ApplicationLaunchParameters *parameters)
 	g_free (parameters);
 }			      
 
-static GList *
-file_and_directory_list_to_files (GList *fad_list)
-{
-	GList *res, *l;
-	FileAndDirectory *fad;
-
-	res = NULL;
-	for (l = fad_list; l != NULL; l = l->next) {
-		fad = l->data;
-		res = g_list_prepend (res, nautilus_file_ref (fad->file));
-	}
-	return g_list_reverse (res);
-}
-
-
 static GList *
 file_and_directory_list_from_files (NautilusDirectory *directory, GList *files)
 {
@@ -1885,6 +1888,14 @@ fm_directory_view_init (FMDirectoryView *view)
 				       file_and_directory_equal,
 				       (GDestroyNotify)file_and_directory_free,
 				       NULL);
+	view->details->old_added_files =
+		g_sequence_new ((GDestroyNotify)file_and_directory_free);
+	view->details->old_changed_files =
+		g_sequence_new ((GDestroyNotify)file_and_directory_free);
+	view->details->old_added_file_iters =
+		g_hash_table_new (file_and_directory_hash, file_and_directory_equal);
+	view->details->old_changed_file_iters =
+		g_hash_table_new (file_and_directory_hash, file_and_directory_equal);
 
 	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (view),
 					GTK_POLICY_AUTOMATIC,
@@ -2063,6 +2074,10 @@ fm_directory_view_finalize (GObject *object)
 	}
 
 	g_hash_table_destroy (view->details->non_ready_files);
+	g_hash_table_destroy (view->details->old_added_file_iters);
+	g_hash_table_destroy (view->details->old_changed_file_iters);
+	g_sequence_free (view->details->old_added_files);
+	g_sequence_free (view->details->old_changed_files);
 
 	g_free (view->details);
 
@@ -2665,22 +2680,84 @@ compare_files_cover (gconstpointer a, gconstpointer b, gpointer callback_data)
 					  (view, fad1->file, fad2->file));
 	}
 }
+
+static gboolean
+sequence_is_empty (GSequence *sequence)
+{
+	return g_sequence_iter_is_end (g_sequence_get_begin_iter (sequence));
+}
+
 static void
-sort_files (FMDirectoryView *view, GList **list)
+sequence_clear (GSequence *sequence, GHashTable *iters)
 {
-	*list = g_list_sort_with_data (*list, compare_files_cover, view);
-	
+	g_hash_table_remove_all (iters);
+	g_sequence_remove_range (g_sequence_get_begin_iter (sequence),
+				 g_sequence_get_end_iter (sequence));
+}
+
+/* Removes the files from the start of the sequence up to end */
+static void
+sequence_remove_head (GSequence *sequence, GHashTable *iters, GSequenceIter *end)
+{
+	GSequenceIter *iter;
+
+	for (iter = g_sequence_get_begin_iter (sequence);
+	     iter != end;
+	     iter = g_sequence_iter_next (iter)) {
+		g_hash_table_remove (iters, g_sequence_get (iter));
+	}
+	g_sequence_remove_range (g_sequence_get_begin_iter (sequence), end);
+}
+
+/* Moves a file that is already waiting to its new place, since the
+ * change may have been to its sort keys. Returns FALSE if it isn't
+ * waiting.
+ */
+static gboolean
+sequence_sort_changed (FMDirectoryView *view,
+		       GHashTable *iters,
+		       FileAndDirectory *pending)
+{
+	GSequenceIter *iter;
+
+	iter = g_hash_table_lookup (iters, pending);
+	if (iter == NULL) {
+		return FALSE;
+	}
+
+	g_sequence_sort_changed (iter, compare_files_cover, view);
+	return TRUE;
+}
+
+/* Takes over pending */
+static void
+sequence_insert_sorted (FMDirectoryView *view,
+			GSequence *sequence,
+			GHashTable *iters,
+			FileAndDirectory *pending)
+{
+	GSequenceIter *iter;
+
+	if (sequence_sort_changed (view, iters, pending)) {
+		file_and_directory_free (pending);
+		return;
+	}
+
+	iter = g_sequence_insert_sorted (sequence, pending,
+					 compare_files_cover, view);
+	g_hash_table_insert (iters, pending, iter);
 }
 
 /* Go through all the new added and changed files.
  * Put any that are not ready to load in the non_ready_files hash table.
- * Add all the rest to the old_added_files and old_changed_files lists.
- * Sort the old_*_files lists if anything was added to them.
+ * Insert all the rest into the sorted old_added_files and
+ * old_changed_files, so only the new files have to be placed.
  */
 static void
 process_new_files (FMDirectoryView *view)
 {
-	GList *new_added_files, *new_changed_files, *old_added_files, *old_changed_files;
+	GList *new_added_files, *new_changed_files;
+	GSequence *old_added_files, *old_changed_files;
 	GHashTable *non_ready_files;
 	GList *node, *next;
 	FileAndDirectory *pending;
@@ -2696,6 +2773,16 @@ process_new_files (FMDirectoryView *view)
 	old_added_files = view->details->old_added_files;
 	old_changed_files = view->details->old_changed_files;
 
+	/* Files that are waiting to be shown and changed since then may
+	 * have new sort keys. Move them first, the sequences have to be
+	 * in order for anything to be inserted.
+	 */
+	for (node = new_changed_files; node != NULL; node = node->next) {
+		pending = node->data;
+		sequence_sort_changed (view, view->details->old_added_file_iters, pending);
+		sequence_sort_changed (view, view->details->old_changed_file_iters, pending);
+	}
+
 	/* Newly added files go into the old_added_files list if they're
 	 * ready, and into the hash table if they're not.
 	 */
@@ -2709,7 +2796,9 @@ process_new_files (FMDirectoryView *view)
 					g_hash_table_remove (non_ready_files, pending);
 				}
 				new_added_files = g_list_delete_link (new_added_files, node);
-				old_added_files = g_list_prepend (old_added_files, pending);
+				sequence_insert_sorted (view, old_added_files,
+							view->details->old_added_file_iters,
+							pending);
 			} else {
 				if (!in_non_ready) {
 					new_added_files = g_list_delete_link (new_added_files, node);
@@ -2733,78 +2822,128 @@ process_new_files (FMDirectoryView *view)
 				g_hash_table_remove (non_ready_files, pending);
 				if (still_should_show_file (view, pending->file, pending->directory)) {
 					new_changed_files = g_list_delete_link (new_changed_files, node);
-					old_added_files = g_list_prepend (old_added_files, pending);
+					sequence_insert_sorted (view, old_added_files,
+								view->details->old_added_file_iters,
+								pending);
 				}
 			} else if (fm_directory_view_should_show_file (view, pending->file)) {
 				new_changed_files = g_list_delete_link (new_changed_files, node);
-				old_changed_files = g_list_prepend (old_changed_files, pending);
+				sequence_insert_sorted (view, old_changed_files,
+							view->details->old_changed_file_iters,
+							pending);
 			}
 		}
 	}
 	file_and_directory_list_free (new_changed_files);
+}
+
+static gboolean
+display_slice_is_over (int *count, gint64 deadline)
+{
+	*count += 1;
+	return *count % DISPLAY_PENDING_CHECK_TIME_INTERVAL == 0 &&
+		eel_get_system_time () > deadline;
+}
 
-	/* If any files were added to old_added_files, then resort it. */
-	if (old_added_files != view->details->old_added_files) {
-		view->details->old_added_files = old_added_files;
-		sort_files (view, &view->details->old_added_files);
+/* Returns TRUE if the two file lists have a file in common. Unlike
+ * eel_g_lists_sort_and_check_for_intersection() this is linear, and
+ * doesn't reorder the lists.
+ */
+static gboolean
+file_lists_intersect (GList *files_a, GList *files_b)
+{
+	GHashTable *set;
+	GList *l;
+	gboolean found;
+
+	if (files_a == NULL || files_b == NULL) {
+		return FALSE;
 	}
 
-	/* Resort old_changed_files too, since file attributes
-	 * relevant to sorting could have changed.
-	 */
-	if (old_changed_files != view->details->old_changed_files) {
-		view->details->old_changed_files = old_changed_files;
-		sort_files (view, &view->details->old_changed_files);
+	set = g_hash_table_new (NULL, NULL);
+	for (l = files_a; l != NULL; l = l->next) {
+		g_hash_table_insert (set, l->data, l->data);
 	}
 
+	found = FALSE;
+	for (l = files_b; l != NULL && !found; l = l->next) {
+		found = g_hash_table_lookup (set, l->data) != NULL;
+	}
+
+	g_hash_table_destroy (set);
+
+	return found;
 }
 
-static void
+/* Shows as many of the old_added_files and old_changed_files as fit
+ * in one time slice. Returns TRUE if none are left.
+ */
+static gboolean
 process_old_files (FMDirectoryView *view)
 {
-	GList *files_added, *files_changed, *node;
+	GSequenceIter *iter;
 	FileAndDirectory *pending;
-	GList *selection, *files;
+	GList *files_changed, *selection;
 	gboolean send_selection_change;
+	gint64 deadline;
+	int count;
 
-	files_added = view->details->old_added_files;
-	files_changed = view->details->old_changed_files;
-	
 	send_selection_change = FALSE;
+	files_changed = NULL;
+
+	if (!sequence_is_empty (view->details->old_added_files) ||
+	    !sequence_is_empty (view->details->old_changed_files)) {
+		deadline = eel_get_system_time () + DISPLAY_PENDING_TIME_SLICE;
+		count = 0;
 
-	if (files_added != NULL || files_changed != NULL) {
 		g_signal_emit (view, signals[BEGIN_FILE_CHANGES], 0);
 
-		for (node = files_added; node != NULL; node = node->next) {
-			pending = node->data;
+		for (iter = g_sequence_get_begin_iter (view->details->old_added_files);
+		     !g_sequence_iter_is_end (iter);
+		     iter = g_sequence_iter_next (iter)) {
+			if (display_slice_is_over (&count, deadline)) {
+				break;
+			}
+			pending = g_sequence_get (iter);
 			g_signal_emit (view,
 				       signals[ADD_FILE], 0, pending->file, pending->directory);
+			if (view->details->loading) {
+				view->details->loading_shown_file_count += 1;
+			}
 		}
-
-		for (node = files_changed; node != NULL; node = node->next) {
-			pending = node->data;
-			g_signal_emit (view,
-				       signals[still_should_show_file (view, pending->file, pending->directory)
-					       ? FILE_CHANGED : REMOVE_FILE], 0,
-				       pending->file, pending->directory);
+		sequence_remove_head (view->details->old_added_files,
+				      view->details->old_added_file_iters,
+				      iter);
+
+		/* Changes wait until all the added files are shown */
+		if (sequence_is_empty (view->details->old_added_files)) {
+			for (iter = g_sequence_get_begin_iter (view->details->old_changed_files);
+			     !g_sequence_iter_is_end (iter);
+			     iter = g_sequence_iter_next (iter)) {
+				if (display_slice_is_over (&count, deadline)) {
+					break;
+				}
+				pending = g_sequence_get (iter);
+				g_signal_emit (view,
+					       signals[still_should_show_file (view, pending->file, pending->directory)
+						       ? FILE_CHANGED : REMOVE_FILE], 0,
+					       pending->file, pending->directory);
+				files_changed = g_list_prepend (files_changed,
+								nautilus_file_ref (pending->file));
+			}
+			sequence_remove_head (view->details->old_changed_files,
+					      view->details->old_changed_file_iters,
+					      iter);
 		}
 
 		g_signal_emit (view, signals[END_FILE_CHANGES], 0);
 
 		if (files_changed != NULL) {
 			selection = fm_directory_view_get_selection (view);
-			files = file_and_directory_list_to_files (files_changed);
-			send_selection_change = eel_g_lists_sort_and_check_for_intersection
-				(&files, &selection);
-			nautilus_file_list_free (files);
+			send_selection_change = file_lists_intersect (files_changed, selection);
 			nautilus_file_list_free (selection);
+			nautilus_file_list_free (files_changed);
 		}
-		
-		file_and_directory_list_free (view->details->old_added_files);
-		view->details->old_added_files = NULL;
-
-		file_and_directory_list_free (view->details->old_changed_files);
-		view->details->old_changed_files = NULL;
 	}
 
 	if (send_selection_change) {
@@ -2813,21 +2952,65 @@ process_old_files (FMDirectoryView *view)
 		 */
 		fm_directory_view_send_selection_change (view);
 	}
+
+	return sequence_is_empty (view->details->old_added_files) &&
+		sequence_is_empty (view->details->old_changed_files);
+}
+
+static void
+display_loading_progress (FMDirectoryView *view)
+{
+	char *status;
+
+	if (view->details->window == NULL) {
+		return;
+	}
+
+	status = g_strdup_printf (ngettext ("Loading... %'u item shown",
+					    "Loading... %'u items shown",
+					    view->details->loading_shown_file_count),
+				  view->details->loading_shown_file_count);
+	nautilus_window_slot_info_set_status (view->details->slot, status);
+	g_free (status);
 }
 
 static void
 display_pending_files (FMDirectoryView *view)
 {
+	gboolean first_files;
 
 	/* Don't dispatch any updates while the view is frozen. */
 	if (view->details->updates_frozen) {
 		return;
 	}
 
+	first_files = view->details->loading && !view->details->showed_first_files;
+
 	process_new_files (view);
-	process_old_files (view);
+	if (!process_old_files (view)) {
+		/* Go on with the rest in the next slice. The first files
+		 * shown while loading get laid out and painted before that.
+		 */
+		unschedule_display_of_pending_files (view);
+		if (first_files) {
+			view->details->display_pending_source_id =
+				g_idle_add_full (G_PRIORITY_LOW,
+						 display_pending_callback, view, NULL);
+		} else {
+			schedule_idle_display_of_pending_files (view);
+		}
+	}
+
+	if (view->details->loading) {
+		if (view->details->loading_shown_file_count > 0) {
+			view->details->showed_first_files = TRUE;
+		}
+		display_loading_progress (view);
+	}
 
 	if (view->details->model != NULL
+	    && sequence_is_empty (view->details->old_added_files)
+	    && sequence_is_empty (view->details->old_changed_files)
 	    && nautilus_directory_are_all_files_seen (view->details->model)
 	    && g_hash_table_size (view->details->non_ready_files) == 0) {
 		done_loading (view, TRUE);
@@ -3001,6 +3184,11 @@ queue_pending_files (FMDirectoryView *view,
 
 	if (! view->details->loading || nautilus_directory_are_all_files_seen (directory)) {
 		schedule_timeout_display_of_pending_files (view, view->details->update_interval);
+	} else {
+		/* Show what we have so far, the first screenful quickly */
+		schedule_timeout_display_of_pending_files (view,
+							   view->details->showed_first_files ?
+							   UPDATE_INTERVAL_LOADING : UPDATE_INTERVAL_MIN);
 	}
 }
 
@@ -9044,6 +9232,8 @@ load_directory (FMDirectoryView *view,
 	fm_directory_view_clear (view);
 
 	view->details->loading = TRUE;
+	view->details->showed_first_files = FALSE;
+	view->details->loading_shown_file_count = 0;
 
 	/* Update menus when directory is empty, before going to new
 	 * location, so they won't have any false lingering knowledge
@@ -9440,10 +9630,10 @@ fm_directory_view_stop (FMDirectoryView *view)
 	file_and_directory_list_free (view->details->new_changed_files);
 	view->details->new_changed_files = NULL;
 	g_hash_table_foreach_remove (view->details->non_ready_files, remove_all, NULL);
-	file_and_directory_list_free (view->details->old_added_files);
-	view->details->old_added_files = NULL;
-	file_and_directory_list_free (view->details->old_changed_files);
-	view->details->old_changed_files = NULL;
+	sequence_clear (view->details->old_added_files,
+			view->details->old_added_file_iters);
+	sequence_clear (view->details->old_changed_files,
+			view->details->old_changed_file_iters);
 	eel_g_object_list_free (view->details->pending_locations_selected);
 	view->details->pending_locations_selected = NULL;
 
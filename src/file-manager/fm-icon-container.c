@@ -187,6 +187,34 @@ fm_icon_container_prioritize_thumbnailing (NautilusIconContainer *container,
 	}
 }
 
+static int
+fm_icon_container_report_scroll_position (NautilusIconContainer *container,
+					  double                 position,
+					  double                 page_size)
+{
+	FMIconContainer *icon_container;
+
+	icon_container = FM_ICON_CONTAINER (container);
+
+	/* Still scrolled while being disposed */
+	if (icon_container->thumbnail_prefetch == NULL) {
+		return 0;
+	}
+
+	return nautilus_thumbnail_prefetch_scrolled (icon_container->thumbnail_prefetch,
+						     position, page_size);
+}
+
+static void
+fm_icon_container_prefetch_thumbnails (NautilusIconContainer *container,
+				       GList                 *visible_data,
+				       GList                 *ahead_data)
+{
+	/* The icon data are the files */
+	nautilus_thumbnail_prefetch_files (FM_ICON_CONTAINER (container)->thumbnail_prefetch,
+					   visible_data, ahead_data);
+}
+
 /*
  * Get the preference for which caption text should appear
  * beneath icons.
@@ -498,6 +526,29 @@ fm_icon_container_compare_icons_by_name (NautilusIconContainer *container,
 		 FALSE, FALSE);
 }
 
+static gboolean
+fm_icon_container_sort_icons (NautilusIconContainer *container,
+			      gpointer              *icons,
+			      guint                  n_icons,
+			      NautilusIconGetData    get_data)
+{
+	FMIconView *icon_view;
+
+	icon_view = get_icon_view (container);
+	g_return_val_if_fail (icon_view != NULL, FALSE);
+
+	/* The desktop sorts by its own categories */
+	if (FM_ICON_CONTAINER (container)->sort_for_desktop) {
+		return FALSE;
+	}
+
+	/* Type unsafe cast, the icon data are the files */
+	fm_icon_view_sort_files (icon_view, icons, n_icons,
+				 (NautilusFileSortGetFile) get_data);
+
+	return TRUE;
+}
+
 static void
 fm_icon_container_freeze_updates (NautilusIconContainer *container)
 {
@@ -525,6 +576,9 @@ fm_icon_container_dispose (GObject *object)
 
 	icon_container->view = NULL;
 
+	nautilus_thumbnail_prefetch_free (icon_container->thumbnail_prefetch);
+	icon_container->thumbnail_prefetch = NULL;
+
 	G_OBJECT_CLASS (fm_icon_container_parent_class)->dispose (object);
 }
 
@@ -543,9 +597,12 @@ fm_icon_container_class_init (FMIconContainerClass *klass)
 	ic_class->start_monitor_top_left = fm_icon_container_start_monitor_top_left;
 	ic_class->stop_monitor_top_left = fm_icon_container_stop_monitor_top_left;
 	ic_class->prioritize_thumbnailing = fm_icon_container_prioritize_thumbnailing;
+	ic_class->report_scroll_position = fm_icon_container_report_scroll_position;
+	ic_class->prefetch_thumbnails = fm_icon_container_prefetch_thumbnails;
 
 	ic_class->compare_icons = fm_icon_container_compare_icons;
 	ic_class->compare_icons_by_name = fm_icon_container_compare_icons_by_name;
+	ic_class->sort_icons = fm_icon_container_sort_icons;
 	ic_class->freeze_updates = fm_icon_container_freeze_updates;
 	ic_class->unfreeze_updates = fm_icon_container_unfreeze_updates;
 
@@ -555,6 +612,7 @@ fm_icon_container_class_init (FMIconContainerClass *klass)
 static void
 fm_icon_container_init (FMIconContainer *icon_container)
 {
+	icon_container->thumbnail_prefetch = nautilus_thumbnail_prefetch_new ();
 }
 
 NautilusIconContainer *
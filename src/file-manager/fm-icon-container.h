@@ -26,6 +26,7 @@
 #define FM_ICON_CONTAINER_H
 
 #include <libnautilus-private/nautilus-icon-container.h>
+#include <libnautilus-private/nautilus-thumbnail-prefetch.h>
 #include "fm-icon-view.h"
 
 typedef struct FMIconContainer FMIconContainer;
@@ -50,6 +51,7 @@ struct FMIconContainer {
 
 	FMIconView *view;
 	gboolean    sort_for_desktop;
+	NautilusThumbnailPrefetch *thumbnail_prefetch;
 };
 
 struct FMIconContainerClass {
@@ -2123,6 +2123,23 @@ fm_icon_view_compare_files (FMIconView   *icon_view,
 		 icon_view->details->sort_reversed);
 }
 
+/* Sorts the items in the order of fm_icon_view_compare_files() */
+void
+fm_icon_view_sort_files (FMIconView *icon_view,
+			 gpointer *items,
+			 guint n_items,
+			 NautilusFileSortGetFile get_file)
+{
+	NautilusFileSortKeys *keys;
+
+	keys = nautilus_file_sort_keys_new_for_sort_type
+		(icon_view->details->sort->sort_type,
+		 fm_directory_view_should_sort_directories_first (FM_DIRECTORY_VIEW (icon_view)),
+		 icon_view->details->sort_reversed);
+	nautilus_file_sort_keys_sort (keys, items, n_items, get_file);
+	nautilus_file_sort_keys_free (keys);
+}
+
 static int
 compare_files (FMDirectoryView   *icon_view,
 	       NautilusFile *a,
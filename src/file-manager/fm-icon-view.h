@@ -118,6 +118,10 @@ GType   fm_icon_view_get_type      (void);
 int     fm_icon_view_compare_files (FMIconView   *icon_view,
 				    NautilusFile *a,
 				    NautilusFile *b);
+void    fm_icon_view_sort_files    (FMIconView   *icon_view,
+				    gpointer     *items,
+				    guint         n_items,
+				    NautilusFileSortGetFile get_file);
 void    fm_icon_view_filter_by_screen (FMIconView *icon_view, gboolean filter);
 gboolean fm_icon_view_is_compact   (FMIconView *icon_view);
 
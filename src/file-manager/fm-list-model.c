@@ -29,6 +29,7 @@
 #include <libegg/eggtreemultidnd.h>
 
 #include <string.h>
+#include <time.h>
 #include <eel/eel-gtk-macros.h>
 #include <eel/eel-glib-extensions.h>
 #include <eel/eel-gdk-pixbuf-extensions.h>
@@ -75,6 +76,13 @@ struct FMListModelDetails {
 	int drag_begin_y;
 
 	GPtrArray *columns;
+
+	/* Cached values of older generations are recomputed, see
+	 * get_cached_value()
+	 */
+	guint value_generation;
+	time_t value_day_checked_at;
+	guint32 value_day;
 };
 
 typedef struct {
@@ -92,6 +100,13 @@ struct FileEntry {
 	FileEntry *parent;
 	GSequence *files;
 	GSequenceIter *ptr;
+	/* Values for the columns that are expensive to compute,
+	 * dropped whenever the row changes.
+	 */
+	GValue *values;
+	guint n_values;
+	guint value_generation;
+	GList *cached_pixbufs_link; /* in rows_with_cached_pixbufs */
 	guint loaded : 1;
 };
 
@@ -110,9 +125,94 @@ static const GtkTargetEntry drag_types [] = {
 
 static GtkTargetList *drag_target_list = NULL;
 
+/* The icon and emblem pixbufs are most of what the cached values
+ * take, so they are only kept for the rows that were drawn last, in
+ * all models. Most recently used first.
+ */
+#define MAX_ROWS_WITH_CACHED_PIXBUFS 512
+
+static GQueue rows_with_cached_pixbufs = G_QUEUE_INIT;
+
+static gboolean
+column_is_pixbuf (int column)
+{
+	return column >= FM_LIST_MODEL_SMALLEST_ICON_COLUMN &&
+		column <= FM_LIST_MODEL_LARGEST_EMBLEM_COLUMN;
+}
+
+static void
+file_entry_forget_cached_pixbufs (FileEntry *file_entry)
+{
+	if (file_entry->cached_pixbufs_link != NULL) {
+		g_queue_delete_link (&rows_with_cached_pixbufs,
+				     file_entry->cached_pixbufs_link);
+		file_entry->cached_pixbufs_link = NULL;
+	}
+}
+
+static void
+file_entry_clear_pixbuf_values (FileEntry *file_entry)
+{
+	int column;
+
+	for (column = FM_LIST_MODEL_SMALLEST_ICON_COLUMN;
+	     column <= FM_LIST_MODEL_LARGEST_EMBLEM_COLUMN &&
+		     (guint) column < file_entry->n_values;
+	     column++) {
+		if (G_IS_VALUE (&file_entry->values[column])) {
+			g_value_unset (&file_entry->values[column]);
+		}
+	}
+
+	file_entry_forget_cached_pixbufs (file_entry);
+}
+
+/* Called when a pixbuf value of the row is used */
+static void
+file_entry_used_cached_pixbuf (FileEntry *file_entry)
+{
+	GList *link;
+
+	link = file_entry->cached_pixbufs_link;
+	if (link == rows_with_cached_pixbufs.head && link != NULL) {
+		return;
+	}
+
+	if (link != NULL) {
+		g_queue_unlink (&rows_with_cached_pixbufs, link);
+		g_queue_push_head_link (&rows_with_cached_pixbufs, link);
+		return;
+	}
+
+	g_queue_push_head (&rows_with_cached_pixbufs, file_entry);
+	file_entry->cached_pixbufs_link = rows_with_cached_pixbufs.head;
+
+	if (rows_with_cached_pixbufs.length > MAX_ROWS_WITH_CACHED_PIXBUFS) {
+		file_entry_clear_pixbuf_values (g_queue_peek_tail (&rows_with_cached_pixbufs));
+	}
+}
+
+static void
+file_entry_clear_values (FileEntry *file_entry)
+{
+	guint i;
+
+	for (i = 0; i < file_entry->n_values; i++) {
+		if (G_IS_VALUE (&file_entry->values[i])) {
+			g_value_unset (&file_entry->values[i]);
+		}
+	}
+	g_free (file_entry->values);
+	file_entry->values = NULL;
+	file_entry->n_values = 0;
+
+	file_entry_forget_cached_pixbufs (file_entry);
+}
+
 static void
 file_entry_free (FileEntry *file_entry)
 {
+	file_entry_clear_values (file_entry);
 	nautilus_file_unref (file_entry->file);
 	if (file_entry->reverse_map) {
 		g_hash_table_destroy (file_entry->reverse_map);
@@ -247,7 +347,7 @@ fm_list_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
 }
 
 static void
-fm_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column, GValue *value)
+fm_list_model_compute_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column, GValue *value)
 {
 	FMListModel *model;
 	FileEntry *file_entry;
@@ -265,9 +365,6 @@ fm_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column
 	
 	model = (FMListModel *)tree_model;
 
-	g_return_if_fail (model->details->stamp == iter->stamp);
-	g_return_if_fail (!g_sequence_iter_is_end (iter->user_data));
-
 	file_entry = g_sequence_get (iter->user_data);
 	file = file_entry->file;
 	
@@ -390,6 +487,170 @@ fm_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column
 	}
 }
 
+static gboolean
+column_value_is_cached (FMListModel *model, int column)
+{
+	switch (column) {
+	case FM_LIST_MODEL_FILE_COLUMN:
+	case FM_LIST_MODEL_SUBDIRECTORY_COLUMN:
+		/* Cheap enough as they are */
+		return FALSE;
+	case FM_LIST_MODEL_SMALLEST_ICON_COLUMN:
+	case FM_LIST_MODEL_SMALLER_ICON_COLUMN:
+	case FM_LIST_MODEL_SMALL_ICON_COLUMN:
+	case FM_LIST_MODEL_STANDARD_ICON_COLUMN:
+	case FM_LIST_MODEL_LARGE_ICON_COLUMN:
+	case FM_LIST_MODEL_LARGER_ICON_COLUMN:
+	case FM_LIST_MODEL_LARGEST_ICON_COLUMN:
+		/* The drop target row is highlighted without a row change */
+		return model->details->drag_view == NULL;
+	default:
+		return TRUE;
+	}
+}
+
+/* Dates are shown relative to today, so all values are recomputed
+ * when the day changes.
+ */
+static void
+check_value_day (FMListModel *model)
+{
+	GDate today;
+	time_t now;
+	guint32 day;
+
+	now = time (NULL);
+	if (now == model->details->value_day_checked_at) {
+		return;
+	}
+	model->details->value_day_checked_at = now;
+
+	g_date_clear (&today, 1);
+	g_date_set_time_t (&today, now);
+	day = g_date_get_julian (&today);
+
+	if (day != model->details->value_day) {
+		model->details->value_day = day;
+		model->details->value_generation++;
+	}
+}
+
+/* Returns the cached value of the column, which isn't initialized
+ * yet if it has to be computed.
+ */
+static GValue *
+get_cached_value (FMListModel *model, FileEntry *file_entry, int column)
+{
+	guint n_values;
+
+	check_value_day (model);
+
+	if (file_entry->value_generation != model->details->value_generation) {
+		file_entry_clear_values (file_entry);
+		file_entry->value_generation = model->details->value_generation;
+	}
+
+	if ((guint) column >= file_entry->n_values) {
+		/* Columns can be added after the values were first cached */
+		n_values = fm_list_model_get_n_columns (GTK_TREE_MODEL (model));
+		file_entry->values = g_renew (GValue, file_entry->values, n_values);
+		memset (file_entry->values + file_entry->n_values, 0,
+			(n_values - file_entry->n_values) * sizeof (GValue));
+		file_entry->n_values = n_values;
+	}
+
+	return &file_entry->values[column];
+}
+
+/* Rows whose attribute column values are formatted together */
+#define ATTRIBUTE_BATCH_SIZE 64
+
+/* The tree view asks for the rows from the top down, so this fills in
+ * the column for the following rows too, letting the file code share
+ * the work between them (dates are checked against today only once).
+ */
+static void
+fill_attribute_values (FMListModel *model, GSequenceIter *ptr, int column)
+{
+	NautilusColumn *nautilus_column;
+	NautilusFile *files[ATTRIBUTE_BATCH_SIZE];
+	GValue *values[ATTRIBUTE_BATCH_SIZE];
+	char *strings[ATTRIBUTE_BATCH_SIZE];
+	FileEntry *file_entry;
+	GValue *cached_value;
+	GQuark attribute;
+	int n_files, i;
+
+	nautilus_column = model->details->columns->pdata[column - FM_LIST_MODEL_NUM_COLUMNS];
+	g_object_get (nautilus_column, 
+		      "attribute_q", &attribute, 
+		      NULL);
+
+	n_files = 0;
+	for (; !g_sequence_iter_is_end (ptr) && n_files < ATTRIBUTE_BATCH_SIZE;
+	     ptr = g_sequence_iter_next (ptr)) {
+		file_entry = g_sequence_get (ptr);
+		if (file_entry->file == NULL) {
+			continue;
+		}
+
+		cached_value = get_cached_value (model, file_entry, column);
+		if (G_IS_VALUE (cached_value)) {
+			/* Filled by an earlier batch */
+			break;
+		}
+
+		files[n_files] = file_entry->file;
+		values[n_files] = cached_value;
+		n_files++;
+	}
+
+	nautilus_file_get_string_attributes_with_default_q (files, n_files, attribute, strings);
+
+	for (i = 0; i < n_files; i++) {
+		g_value_init (values[i], G_TYPE_STRING);
+		g_value_take_string (values[i], strings[i]);
+	}
+}
+
+static void
+fm_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column, GValue *value)
+{
+	FMListModel *model;
+	FileEntry *file_entry;
+	GValue *cached_value;
+
+	model = (FMListModel *)tree_model;
+
+	g_return_if_fail (model->details->stamp == iter->stamp);
+	g_return_if_fail (!g_sequence_iter_is_end (iter->user_data));
+	g_return_if_fail (column >= 0 && column < fm_list_model_get_n_columns (tree_model));
+
+	file_entry = g_sequence_get (iter->user_data);
+
+	/* The tree view asks for each value several times per redraw */
+	if (file_entry->file == NULL || !column_value_is_cached (model, column)) {
+		fm_list_model_compute_value (tree_model, iter, column, value);
+		return;
+	}
+
+	cached_value = get_cached_value (model, file_entry, column);
+	if (!G_IS_VALUE (cached_value)) {
+		if (column >= FM_LIST_MODEL_NUM_COLUMNS) {
+			fill_attribute_values (model, iter->user_data, column);
+		} else {
+			fm_list_model_compute_value (tree_model, iter, column, cached_value);
+		}
+	}
+
+	if (column_is_pixbuf (column)) {
+		file_entry_used_cached_pixbuf (file_entry);
+	}
+
+	g_value_init (value, G_VALUE_TYPE (cached_value));
+	g_value_copy (cached_value, value);
+}
+
 static gboolean
 fm_list_model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
 {
@@ -672,14 +933,25 @@ fm_list_model_compare_func (FMListModel *model,
 	return result;
 }
 
+static NautilusFile *
+file_entry_ptr_get_file (gpointer ptr)
+{
+	FileEntry *file_entry;
+
+	file_entry = g_sequence_get (ptr);
+	return file_entry->file;
+}
+
 static void
-fm_list_model_sort_file_entries (FMListModel *model, GSequence *files, GtkTreePath *path)
+fm_list_model_sort_file_entries (FMListModel *model, GSequence *files, GtkTreePath *path,
+				 NautilusFileSortKeys *keys)
 {
-	GSequenceIter **old_order;
+	GSequenceIter *ptr;
+	gpointer *new_ptrs;
 	GtkTreeIter iter;
 	int *new_order;
 	int length;
-	int i;
+	int i, n_dummies;
 	FileEntry *file_entry;
 	gboolean has_iter;
 
@@ -689,29 +961,48 @@ fm_list_model_sort_file_entries (FMListModel *model, GSequence *files, GtkTreePa
 		return;
 	}
 	
-	/* generate old order of GSequenceIter's */
-	old_order = g_new (GSequenceIter *, length);
-	for (i = 0; i < length; ++i) {
-		GSequenceIter *ptr = g_sequence_get_iter_at_pos (files, i);
-		
+	/* Dummy rows go first, the others are sorted after them */
+	new_ptrs = g_new (gpointer, length);
+	n_dummies = 0;
+	for (ptr = g_sequence_get_begin_iter (files);
+	     !g_sequence_iter_is_end (ptr);
+	     ptr = g_sequence_iter_next (ptr)) {
+		file_entry = g_sequence_get (ptr);
+		if (file_entry->file == NULL) {
+			new_ptrs[n_dummies++] = ptr;
+		}
+	}
+
+	i = n_dummies;
+	for (ptr = g_sequence_get_begin_iter (files);
+	     !g_sequence_iter_is_end (ptr);
+	     ptr = g_sequence_iter_next (ptr)) {
 		file_entry = g_sequence_get (ptr);
 		if (file_entry->files != NULL) {
-			gtk_tree_path_append_index (path, i);
-			fm_list_model_sort_file_entries (model, file_entry->files, path);
+			gtk_tree_path_append_index (path, g_sequence_iter_get_position (ptr));
+			fm_list_model_sort_file_entries (model, file_entry->files, path, keys);
 			gtk_tree_path_up (path);
 		}
 
-		old_order[i] = ptr;
+		if (file_entry->file != NULL) {
+			new_ptrs[i++] = ptr;
+		}
 	}
 
 	/* sort */
-	g_sequence_sort (files, fm_list_model_file_entry_compare_func, model);
+	nautilus_file_sort_keys_sort (keys, new_ptrs + n_dummies, length - n_dummies,
+				      file_entry_ptr_get_file);
 
 	/* generate new order */
 	new_order = g_new (int, length);
 	/* Note: new_order[newpos] = oldpos */
 	for (i = 0; i < length; ++i) {
-		new_order[g_sequence_iter_get_position (old_order[i])] = i;
+		new_order[i] = g_sequence_iter_get_position (new_ptrs[i]);
+	}
+
+	/* Moving the rows keeps their GSequenceIter's valid */
+	for (i = 0; i < length; ++i) {
+		g_sequence_move (new_ptrs[i], g_sequence_get_end_iter (files));
 	}
 
 	/* Let the world know about our new order */
@@ -729,19 +1020,24 @@ fm_list_model_sort_file_entries (FMListModel *model, GSequence *files, GtkTreePa
 	gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model),
 				       path, has_iter ? &iter : NULL, new_order);
 
-	g_free (old_order);
+	g_free (new_ptrs);
 	g_free (new_order);
 }
 
 static void
 fm_list_model_sort (FMListModel *model)
 {
+	NautilusFileSortKeys *keys;
 	GtkTreePath *path;
 
 	path = gtk_tree_path_new ();
+	keys = nautilus_file_sort_keys_new (model->details->sort_attribute,
+					    model->details->sort_directories_first,
+					    (model->details->order == GTK_SORT_DESCENDING));
 
-	fm_list_model_sort_file_entries (model, model->details->files, path);
+	fm_list_model_sort_file_entries (model, model->details->files, path, keys);
 
+	nautilus_file_sort_keys_free (keys);
 	gtk_tree_path_free (path);
 }
 
@@ -1058,6 +1354,9 @@ fm_list_model_file_changed (FMListModel *model, NautilusFile *file,
 		g_free (new_order);
 	}
 	
+	/* Before the signal, its handlers read the new values */
+	file_entry_clear_values (g_sequence_get (ptr));
+
 	fm_list_model_ptr_to_iter (model, ptr, &iter);
 	path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), &iter);
 	gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
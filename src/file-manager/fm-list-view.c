@@ -54,6 +54,8 @@
 #include <libnautilus-private/nautilus-icon-dnd.h>
 #include <libnautilus-private/nautilus-metadata.h>
 #include <libnautilus-private/nautilus-module.h>
+#include <libnautilus-private/nautilus-prefix-index.h>
+#include <libnautilus-private/nautilus-thumbnail-prefetch.h>
 #include <libnautilus-private/nautilus-tree-view-drag-dest.h>
 #include <libnautilus-private/nautilus-view-factory.h>
 #include <libnautilus-private/nautilus-clipboard.h>
@@ -105,6 +107,13 @@ struct FMListViewDetails {
 	guint renaming_file_activate_timeout;
 
 	GQuark last_sort_attr;
+
+	/* Type-ahead search, see search_equal_func () */
+	NautilusPrefixIndex *search_index;
+	char *search_text;
+	char *search_key;
+
+	NautilusThumbnailPrefetch *thumbnail_prefetch;
 };
 
 struct SelectionForeachData {
@@ -145,6 +154,7 @@ static void   fm_list_view_scale_font_size                 (FMListView        *v
 static void   fm_list_view_scroll_to_file                  (FMListView        *view,
 							    NautilusFile      *file);
 static void   fm_list_view_iface_init                      (NautilusViewIface *iface);
+static void   search_index_free                            (FMListView        *view);
 static void   fm_list_view_rename_callback                 (NautilusFile      *file,
 							    GFile             *result_location,
 							    GError            *error,
@@ -918,6 +928,12 @@ subdirectory_unloaded_callback (FMListModel *model,
 					      G_CALLBACK (subdirectory_done_loading_callback),
 					      view);
 	fm_directory_view_remove_subdirectory (FM_DIRECTORY_VIEW (view), directory);
+
+	/* The files of the subdirectory left the model without going
+	 * through remove_file, and the model no longer holds them. The
+	 * index is built again for the next search.
+	 */
+	search_index_free (view);
 }
 
 static gboolean
@@ -1330,6 +1346,165 @@ filename_cell_data_func (GtkTreeViewColumn *column,
 	g_free (text);
 }
 
+static void
+search_index_add_file (FMListView *view, NautilusFile *file)
+{
+	char *name;
+
+	name = nautilus_file_get_display_name (file);
+	nautilus_prefix_index_add (view->details->search_index, file, name);
+	g_free (name);
+}
+
+static gboolean
+add_file_to_search_index (GtkTreeModel *model,
+			  GtkTreePath *path,
+			  GtkTreeIter *iter,
+			  gpointer data)
+{
+	NautilusFile *file;
+
+	gtk_tree_model_get (model, iter, FM_LIST_MODEL_FILE_COLUMN, &file, -1);
+	if (file != NULL) {
+		search_index_add_file (FM_LIST_VIEW (data), file);
+		nautilus_file_unref (file);
+	}
+
+	return FALSE;
+}
+
+static void
+search_index_free (FMListView *view)
+{
+	nautilus_prefix_index_free (view->details->search_index);
+	view->details->search_index = NULL;
+}
+
+/* The tree view still goes through the rows one by one, but with
+ * the names folded in advance each row is just a lookup, instead of
+ * getting the name and normalizing it for every row on every key.
+ */
+static gboolean
+search_equal_func (GtkTreeModel *model,
+		   gint column,
+		   const gchar *key,
+		   GtkTreeIter *iter,
+		   gpointer data)
+{
+	FMListView *view;
+	NautilusFile *file;
+	gboolean matches;
+
+	view = FM_LIST_VIEW (data);
+
+	if (view->details->search_index == NULL) {
+		view->details->search_index = nautilus_prefix_index_new ();
+		gtk_tree_model_foreach (model, add_file_to_search_index, view);
+	}
+
+	if (view->details->search_text == NULL ||
+	    strcmp (view->details->search_text, key) != 0) {
+		g_free (view->details->search_text);
+		g_free (view->details->search_key);
+		view->details->search_text = g_strdup (key);
+		view->details->search_key = nautilus_prefix_index_make_key (key);
+	}
+
+	if (view->details->search_key == NULL ||
+	    nautilus_prefix_index_lookup_nth (view->details->search_index,
+					      view->details->search_key, 1) == NULL) {
+		/* Nothing matches anywhere */
+		return TRUE;
+	}
+
+	gtk_tree_model_get (model, iter, FM_LIST_MODEL_FILE_COLUMN, &file, -1);
+	if (file == NULL) {
+		return TRUE;
+	}
+
+	matches = nautilus_prefix_index_has_prefix (view->details->search_index,
+						    file, view->details->search_key);
+	nautilus_file_unref (file);
+
+	return !matches;
+}
+
+/* Prepends the files in top level rows first to last, so the list
+ * starts with the file in row last.
+ */
+static GList *
+prepend_files_in_rows (FMListView *view, GList *files,
+		       int first, int last)
+{
+	GtkTreePath *path;
+	NautilusFile *file;
+	int step, i;
+
+	step = first <= last ? 1 : -1;
+	for (i = first; i != last + step; i += step) {
+		path = gtk_tree_path_new_from_indices (i, -1);
+		file = fm_list_model_file_for_path (view->details->model, path);
+		gtk_tree_path_free (path);
+
+		/* Dummy rows have no file */
+		if (file != NULL) {
+			files = g_list_prepend (files, file);
+		}
+	}
+
+	return files;
+}
+
+static void
+vadjustment_value_changed_callback (GtkAdjustment *adjustment,
+				    FMListView *view)
+{
+	GtkTreePath *start_path, *end_path;
+	GList *visible_files, *ahead_files;
+	int prefetch_pages, start, end, n_rows, page_rows;
+
+	if (view->details->model == NULL ||
+	    view->details->thumbnail_prefetch == NULL) {
+		return;
+	}
+
+	prefetch_pages = nautilus_thumbnail_prefetch_scrolled (view->details->thumbnail_prefetch,
+							       adjustment->value,
+							       adjustment->page_size);
+	if (prefetch_pages == 0 ||
+	    !gtk_tree_view_get_visible_range (view->details->tree_view,
+					      &start_path, &end_path)) {
+		return;
+	}
+
+	/* Rows in expanded folders count as part of their folder */
+	start = gtk_tree_path_get_indices (start_path)[0];
+	end = gtk_tree_path_get_indices (end_path)[0];
+	gtk_tree_path_free (start_path);
+	gtk_tree_path_free (end_path);
+
+	n_rows = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (view->details->model), NULL);
+	page_rows = end - start + 1;
+
+	visible_files = prepend_files_in_rows (view, NULL, end, start);
+	ahead_files = NULL;
+	if (prefetch_pages > 0 && end + 1 < n_rows) {
+		ahead_files = prepend_files_in_rows (view, NULL,
+						     MIN (end + prefetch_pages * page_rows, n_rows - 1),
+						     end + 1);
+	} else if (prefetch_pages < 0 && start > 0) {
+		ahead_files = prepend_files_in_rows (view, NULL,
+						     MAX (start + prefetch_pages * page_rows, 0),
+						     start - 1);
+	}
+
+	nautilus_thumbnail_prefetch_files (view->details->thumbnail_prefetch,
+					   visible_files, ahead_files);
+
+	nautilus_file_list_free (visible_files);
+	nautilus_file_list_free (ahead_files);
+}
+
 static void
 create_and_set_up_tree_view (FMListView *view)
 {
@@ -1346,6 +1521,8 @@ create_and_set_up_tree_view (FMListView *view)
 							(GDestroyNotify)g_free,
 							(GDestroyNotify) g_object_unref);
 	gtk_tree_view_set_enable_search (view->details->tree_view, TRUE);
+	gtk_tree_view_set_search_equal_func (view->details->tree_view,
+					     search_equal_func, view, NULL);
 
 	/* Don't handle backspace key. It's used to open the parent folder. */
 	binding_set = gtk_binding_set_by_class (GTK_WIDGET_GET_CLASS (view->details->tree_view));
@@ -1506,6 +1683,12 @@ create_and_set_up_tree_view (FMListView *view)
 	gtk_widget_show (GTK_WIDGET (view->details->tree_view));
 	gtk_container_add (GTK_CONTAINER (view), GTK_WIDGET (view->details->tree_view));
 
+	view->details->thumbnail_prefetch = nautilus_thumbnail_prefetch_new ();
+	g_signal_connect_object (gtk_tree_view_get_vadjustment (view->details->tree_view),
+				 "value_changed",
+				 G_CALLBACK (vadjustment_value_changed_callback),
+				 view, 0);
+
 
         atk_obj = gtk_widget_get_accessible (GTK_WIDGET (view->details->tree_view));
         atk_object_set_name (atk_obj, _("List View"));
@@ -1518,6 +1701,10 @@ fm_list_view_add_file (FMDirectoryView *view, NautilusFile *file, NautilusDirect
 
 	model = FM_LIST_VIEW (view)->details->model;
 	fm_list_model_add_file (model, file, directory);
+
+	if (FM_LIST_VIEW (view)->details->search_index != NULL) {
+		search_index_add_file (FM_LIST_VIEW (view), file);
+	}
 }
 
 static char **
@@ -1710,6 +1897,8 @@ fm_list_view_clear (FMDirectoryView *view)
 		stop_cell_editing (list_view);
 		fm_list_model_clear (list_view->details->model);
 	}
+
+	search_index_free (list_view);
 }
 
 static void
@@ -1750,6 +1939,11 @@ fm_list_view_file_changed (FMDirectoryView *view, NautilusFile *file, NautilusDi
 	
 	fm_list_model_file_changed (listview->details->model, file, directory);
 
+	if (listview->details->search_index != NULL) {
+		/* The name may have changed */
+		search_index_add_file (listview, file);
+	}
+
 	if (listview->details->renaming_file != NULL &&
 	    file == listview->details->renaming_file &&
 	    listview->details->rename_done) {
@@ -1929,6 +2123,9 @@ fm_list_view_remove_file (FMDirectoryView *view, NautilusFile *file, NautilusDir
 	   gtk_tree_path_free (file_path);
 		
 	   fm_list_model_remove_file (list_view->details->model, file, directory);
+	   if (list_view->details->search_index != NULL) {
+	      nautilus_prefix_index_remove (list_view->details->search_index, file);
+	   }
 
 	   if (gtk_tree_row_reference_valid (row_reference)) {
 	      if (list_view->details->new_selection_path) {
@@ -2639,6 +2836,11 @@ fm_list_view_dispose (GObject *object)
 		list_view->details->drag_dest = NULL;
 	}
 
+	search_index_free (list_view);
+
+	nautilus_thumbnail_prefetch_free (list_view->details->thumbnail_prefetch);
+	list_view->details->thumbnail_prefetch = NULL;
+
 	if (list_view->details->renaming_file_activate_timeout != 0) {
 		g_source_remove (list_view->details->renaming_file_activate_timeout);
 		list_view->details->renaming_file_activate_timeout = 0;
@@ -2656,6 +2858,9 @@ fm_list_view_finalize (GObject *object)
 
 	g_free (list_view->details->original_name);
 	list_view->details->original_name = NULL;
+
+	g_free (list_view->details->search_text);
+	g_free (list_view->details->search_key);
 	
 	if (list_view->details->double_click_path[0]) {
 		gtk_tree_path_free (list_view->details->double_click_path[0]);
@@ -47,6 +47,11 @@ static guint tree_model_signals[LAST_SIGNAL] = { 0 };
 
 typedef gboolean (* FilePredicate) (NautilusFile *);
 
+/* Children of a directory that is still loading are reported in
+ * batches, when it is done or every this many milliseconds.
+ */
+#define PENDING_FILES_FLUSH_INTERVAL 250
+
 /* The user_data of the GtkTreeIter is the TreeNode pointer.
  * It's NULL for the dummy node. If it's NULL, then user_data2
  * is the TreeNode pointer to the parent.
@@ -70,8 +75,9 @@ struct TreeNode {
 	FMTreeModelRoot *root;
 
 	TreeNode *parent;
-	TreeNode *next;
-	TreeNode *prev;
+	/* position in the parent's children, or in the model's
+	 * root nodes for roots */
+	guint index;
 
 	/* part of the node used only for directories */
 	int dummy_child_ref_count;
@@ -82,7 +88,9 @@ struct TreeNode {
 	guint files_added_id;
 	guint files_changed_id;
 
-	TreeNode *first_child;
+	GPtrArray *children;
+	/* files seen while loading, not yet inserted */
+	GHashTable *pending_files;
 
 	/* misc. flags */
 	guint done_loading : 1;
@@ -93,10 +101,13 @@ struct TreeNode {
 struct FMTreeModelDetails {
 	int stamp;
 	
-	TreeNode *root_node;	
+	GPtrArray *root_nodes;
 
 	guint monitoring_update_idle_id;
 
+	GList *nodes_with_pending_files;
+	guint pending_files_flush_id;
+
 	gboolean show_hidden_files;
 	gboolean show_backup_files;
 	gboolean show_only_directories;
@@ -122,6 +133,8 @@ static void destroy_node_without_reporting (FMTreeModel *model,
 					    TreeNode          *node);
 static void report_node_contents_changed   (FMTreeModel *model,
 					    TreeNode          *node);
+static void discard_pending_files          (FMTreeModel *model,
+					    TreeNode          *node);
 
 G_DEFINE_TYPE_WITH_CODE (FMTreeModel, fm_tree_model, G_TYPE_OBJECT,
 			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
@@ -165,44 +178,95 @@ tree_node_new (NautilusFile *file, FMTreeModelRoot *root)
 	return node;
 }
 
-static void
-tree_node_unparent (FMTreeModel *model, TreeNode *node)
+static GPtrArray *
+tree_node_get_siblings (FMTreeModel *model, TreeNode *node)
+{
+	if (node->parent == NULL) {
+		return model->details->root_nodes;
+	}
+	return node->parent->children;
+}
+
+static guint
+tree_node_get_n_children (TreeNode *node)
 {
-	TreeNode *parent, *next, *prev;
+	return node->children == NULL ? 0 : node->children->len;
+}
 
-	parent = node->parent;
-	next = node->next;
-	prev = node->prev;
+static TreeNode *
+tree_node_get_nth_child (TreeNode *node, guint n)
+{
+	if (n >= tree_node_get_n_children (node)) {
+		return NULL;
+	}
+	return g_ptr_array_index (node->children, n);
+}
+
+static TreeNode *
+tree_node_get_last_child (TreeNode *node)
+{
+	guint n_children;
 
-	if (parent == NULL &&
-	    node == model->details->root_node) {
-		/* it's the first root node -> if there is a next then let it be the first root node */
-		model->details->root_node = next;
+	n_children = tree_node_get_n_children (node);
+	if (n_children == 0) {
+		return NULL;
 	}
+	return g_ptr_array_index (node->children, n_children - 1);
+}
+
+static TreeNode *
+tree_node_get_next (FMTreeModel *model, TreeNode *node)
+{
+	GPtrArray *siblings;
 
-	if (next != NULL) {
-		next->prev = prev;
+	siblings = tree_node_get_siblings (model, node);
+	if (node->index + 1 >= siblings->len) {
+		return NULL;
 	}
-	if (prev == NULL && parent != NULL) {
-		g_assert (parent->first_child == node);
-		parent->first_child = next;
-	} else if (prev != NULL) {
-		prev->next = next;
+	return g_ptr_array_index (siblings, node->index + 1);
+}
+
+static TreeNode *
+get_root_node (FMTreeModel *model, guint n)
+{
+	if (n >= model->details->root_nodes->len) {
+		return NULL;
+	}
+	return g_ptr_array_index (model->details->root_nodes, n);
+}
+
+static void
+tree_node_unparent (FMTreeModel *model, TreeNode *node)
+{
+	GPtrArray *siblings;
+	guint i;
+
+	siblings = tree_node_get_siblings (model, node);
+	g_assert (node->index < siblings->len &&
+		  g_ptr_array_index (siblings, node->index) == node);
+
+	/* Children are usually removed from the end, which keeps this cheap */
+	g_ptr_array_remove_index (siblings, node->index);
+	for (i = node->index; i < siblings->len; i++) {
+		((TreeNode *) g_ptr_array_index (siblings, i))->index = i;
 	}
 
 	node->parent = NULL;
-	node->next = NULL;
-	node->prev = NULL;
+	node->index = 0;
 	node->root = NULL;
 }
 
 static void
 tree_node_destroy (FMTreeModel *model, TreeNode *node)
 {
-	g_assert (node->first_child == NULL);
+	g_assert (tree_node_get_n_children (node) == 0);
 	g_assert (node->ref_count == 0);
 
 	tree_node_unparent (model, node);
+	discard_pending_files (model, node);
+	if (node->children != NULL) {
+		g_ptr_array_free (node->children, TRUE);
+	}
 
 	g_object_unref (node->file);
 	g_free (node->display_name);
@@ -222,25 +286,18 @@ tree_node_destroy (FMTreeModel *model, TreeNode *node)
 static void
 tree_node_parent (TreeNode *node, TreeNode *parent)
 {
-	TreeNode *first_child;
-
 	g_assert (parent != NULL);
 	g_assert (node->parent == NULL);
-	g_assert (node->prev == NULL);
-	g_assert (node->next == NULL);
-
-	first_child = parent->first_child;
-	
-	node->parent = parent;
-	node->root = parent->root;
-	node->next = first_child;
 
-	if (first_child != NULL) {
-		g_assert (first_child->prev == NULL);
-		first_child->prev = node;
+	if (parent->children == NULL) {
+		parent->children = g_ptr_array_new ();
 	}
 
-	parent->first_child = node;
+	/* The rows are not sorted, so just append */
+	node->parent = parent;
+	node->root = parent->root;
+	node->index = parent->children->len;
+	g_ptr_array_add (parent->children, node);
 }
 
 static GdkPixbuf *
@@ -435,7 +492,7 @@ tree_node_has_dummy_child (TreeNode *node)
 {
 	return (node->directory != NULL
 		&& (!node->done_loading
-		    || node->first_child == NULL
+		    || tree_node_get_n_children (node) == 0
 		    || node->force_has_dummy)) ||
 		/* Roots always have dummy nodes if directory isn't loaded yet */
 		(node->directory == NULL && node->parent == NULL);
@@ -444,23 +501,14 @@ tree_node_has_dummy_child (TreeNode *node)
 static int
 tree_node_get_child_index (TreeNode *parent, TreeNode *child)
 {
-	int i;
-	TreeNode *node;
-
 	if (child == NULL) {
 		g_assert (tree_node_has_dummy_child (parent));
 		return 0;
 	}
 
-	i = tree_node_has_dummy_child (parent) ? 1 : 0;
-	for (node = parent->first_child; node != NULL; node = node->next, i++) {
-		if (child == node) {
-			return i;
-		}
-	}
+	g_assert (child->parent == parent);
 
-	g_assert_not_reached ();
-	return 0;
+	return (tree_node_has_dummy_child (parent) ? 1 : 0) + child->index;
 }
 
 static gboolean
@@ -724,6 +772,7 @@ stop_monitoring_directory (FMTreeModel *model, TreeNode *node)
 	if (node->done_loading_id == 0) {
 		g_assert (node->files_added_id == 0);
 		g_assert (node->files_changed_id == 0);
+		discard_pending_files (model, node);
 		return;
 	}
 
@@ -738,13 +787,15 @@ stop_monitoring_directory (FMTreeModel *model, TreeNode *node)
 	node->files_changed_id = 0;
 
 	nautilus_directory_file_monitor_remove (node->directory, model);
+
+	discard_pending_files (model, node);
 }
 
 static void
 destroy_children_without_reporting (FMTreeModel *model, TreeNode *parent)
 {
-	while (parent->first_child != NULL) {
-		destroy_node_without_reporting (model, parent->first_child);
+	while (tree_node_get_n_children (parent) != 0) {
+		destroy_node_without_reporting (model, tree_node_get_last_child (parent));
 	}
 }
 
@@ -789,18 +840,24 @@ destroy_node (FMTreeModel *model, TreeNode *node)
 static void
 destroy_children (FMTreeModel *model, TreeNode *parent)
 {
-	while (parent->first_child != NULL) {
-		destroy_node (model, parent->first_child);
+	while (tree_node_get_n_children (parent) != 0) {
+		destroy_node (model, tree_node_get_last_child (parent));
 	}
 }
 
 static void
 destroy_children_by_function (FMTreeModel *model, TreeNode *parent, FilePredicate f)
 {
-	TreeNode *child, *next;
-
-	for (child = parent->first_child; child != NULL; child = next) {
-		next = child->next;
+	TreeNode *child;
+	guint i;
+
+	/* Go backwards, so destroying a child doesn't move the ones
+	 * we have yet to look at */
+	for (i = tree_node_get_n_children (parent); i > 0; i--) {
+		child = tree_node_get_nth_child (parent, i - 1);
+		if (child == NULL) {
+			continue;
+		}
 		if (f (child->file)) {
 			destroy_node (model, child);
 		} else {
@@ -813,7 +870,9 @@ static void
 destroy_by_function (FMTreeModel *model, FilePredicate f)
 {
 	TreeNode *node;
-	for (node = model->details->root_node; node != NULL; node = node->next) {
+	guint i;
+
+	for (i = 0; (node = get_root_node (model, i)) != NULL; i++) {
 		destroy_children_by_function (model, node, f);
 	}
 }
@@ -849,7 +908,7 @@ insert_node (FMTreeModel *model, TreeNode *parent, TreeNode *node)
 {
 	gboolean parent_empty;
 
-	parent_empty = parent->first_child == NULL;
+	parent_empty = tree_node_get_n_children (parent) == 0;
 	if (parent_empty) {
 		/* Make sure the dummy lives as we insert the new row */
 		parent->force_has_dummy = TRUE;
@@ -901,6 +960,7 @@ should_show_file (FMTreeModel *model, NautilusFile *file)
 {
 	gboolean should;
 	TreeNode *node;
+	guint i;
 
 	should = nautilus_file_should_show (file,
 					    model->details->show_hidden_files,
@@ -917,8 +977,8 @@ should_show_file (FMTreeModel *model, NautilusFile *file)
 		should = FALSE;
 	}
 
-	for (node = model->details->root_node; node != NULL; node = node->next) {
-		if (!should && node != NULL && file == node->file) {
+	for (i = 0; !should && (node = get_root_node (model, i)) != NULL; i++) {
+		if (file == node->file) {
 			should = TRUE;
 		}
 	}
@@ -972,6 +1032,86 @@ update_node (FMTreeModel *model, TreeNode *node)
 	}
 }
 
+static void
+flush_pending_files (FMTreeModel *model, TreeNode *parent)
+{
+	GHashTable *pending_files;
+	GList *files, *l;
+	NautilusFile *file;
+
+	pending_files = parent->pending_files;
+	if (pending_files == NULL) {
+		return;
+	}
+	parent->pending_files = NULL;
+	model->details->nodes_with_pending_files =
+		g_list_remove (model->details->nodes_with_pending_files, parent);
+
+	/* Things may have changed since the files were queued */
+	files = g_hash_table_get_keys (pending_files);
+	for (l = files; l != NULL; l = l->next) {
+		file = l->data;
+		if (get_node_from_file (parent->root, file) == NULL &&
+		    should_show_file (model, file) &&
+		    get_parent_node_from_file (parent->root, file) == parent) {
+			insert_node (model, parent, create_node_for_file (parent->root, file));
+		}
+	}
+	g_list_free (files);
+
+	g_hash_table_destroy (pending_files);
+}
+
+static gboolean
+flush_pending_files_callback (gpointer callback_data)
+{
+	FMTreeModel *model;
+
+	model = FM_TREE_MODEL (callback_data);
+	model->details->pending_files_flush_id = 0;
+
+	while (model->details->nodes_with_pending_files != NULL) {
+		flush_pending_files (model, model->details->nodes_with_pending_files->data);
+	}
+
+	return FALSE;
+}
+
+static void
+queue_pending_file (FMTreeModel *model, TreeNode *parent, NautilusFile *file)
+{
+	if (parent->pending_files == NULL) {
+		parent->pending_files = g_hash_table_new_full (NULL, NULL,
+							       (GDestroyNotify) nautilus_file_unref,
+							       NULL);
+		model->details->nodes_with_pending_files =
+			g_list_prepend (model->details->nodes_with_pending_files, parent);
+	}
+
+	if (g_hash_table_lookup (parent->pending_files, file) == NULL) {
+		g_hash_table_insert (parent->pending_files, nautilus_file_ref (file), file);
+	}
+
+	if (model->details->pending_files_flush_id == 0) {
+		model->details->pending_files_flush_id =
+			g_timeout_add (PENDING_FILES_FLUSH_INTERVAL,
+				       flush_pending_files_callback, model);
+	}
+}
+
+static void
+discard_pending_files (FMTreeModel *model, TreeNode *node)
+{
+	if (node->pending_files == NULL) {
+		return;
+	}
+
+	g_hash_table_destroy (node->pending_files);
+	node->pending_files = NULL;
+	model->details->nodes_with_pending_files =
+		g_list_remove (model->details->nodes_with_pending_files, node);
+}
+
 static void
 process_file_change (FMTreeModelRoot *root,
 		     NautilusFile *file)
@@ -993,6 +1133,11 @@ process_file_change (FMTreeModelRoot *root,
 		return;
 	}
 
+	if (!parent->done_loading && parent->inserted) {
+		queue_pending_file (root->model, parent, file);
+		return;
+	}
+
 	insert_node (root->model, parent, create_node_for_file (root, file));
 }
 
@@ -1061,6 +1206,8 @@ done_loading_callback (NautilusDirectory *directory,
 		 */
 		return;
 	}
+	/* Insert the last batch while the dummy row is still around */
+	flush_pending_files (root->model, node);
 	set_done_loading (root->model, node, TRUE);
 	nautilus_file_unref (file);
 
@@ -1207,10 +1354,9 @@ static GtkTreePath *
 fm_tree_model_get_path (GtkTreeModel *model, GtkTreeIter *iter)
 {
 	FMTreeModel *tree_model;
-	TreeNode *node, *parent, *cnode;
+	TreeNode *node, *parent;
 	GtkTreePath *path;
 	GtkTreeIter parent_iter;
-	int i;
 
 	g_return_val_if_fail (FM_IS_TREE_MODEL (model), NULL);
 	tree_model = FM_TREE_MODEL (model);
@@ -1225,12 +1371,8 @@ fm_tree_model_get_path (GtkTreeModel *model, GtkTreeIter *iter)
 	} else {
 		parent = node->parent;
 		if (parent == NULL) {
-			i = 0;
-			for (cnode = tree_model->details->root_node; cnode != node; cnode = cnode->next) {
-				i++;
-			}
 			path = gtk_tree_path_new ();
-			gtk_tree_path_append_index (path, i);
+			gtk_tree_path_append_index (path, node->index);
 			return path;
 		}
 	}
@@ -1307,9 +1449,9 @@ fm_tree_model_iter_next (GtkTreeModel *model, GtkTreeIter *iter)
 
 	if (node == NULL) {
 		parent = iter->user_data2;
-		next = parent->first_child;
+		next = tree_node_get_nth_child (parent, 0);
 	} else {
-		next = node->next;
+		next = tree_node_get_next (FM_TREE_MODEL (model), node);
 	}
 
 	return make_iter_for_node (next, iter, iter->stamp);
@@ -1331,7 +1473,7 @@ fm_tree_model_iter_children (GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter
 	if (tree_node_has_dummy_child (parent)) {
 		return make_iter_for_dummy_row (parent, iter, parent_iter->stamp);
 	}
-	return make_iter_for_node (parent->first_child, iter, parent_iter->stamp);
+	return make_iter_for_node (tree_node_get_nth_child (parent, 0), iter, parent_iter->stamp);
 }
 
 static gboolean
@@ -1378,8 +1520,7 @@ static int
 fm_tree_model_iter_n_children (GtkTreeModel *model, GtkTreeIter *iter)
 {
 	FMTreeModel *tree_model;
-	TreeNode *parent, *node;
-	int n;
+	TreeNode *parent;
 	
 	g_return_val_if_fail (FM_IS_TREE_MODEL (model), FALSE);
 	g_return_val_if_fail (iter == NULL || iter_is_valid (FM_TREE_MODEL (model), iter), FALSE);
@@ -1395,12 +1536,7 @@ fm_tree_model_iter_n_children (GtkTreeModel *model, GtkTreeIter *iter)
 		return 0;
 	}
 
-	n = tree_node_has_dummy_child (parent) ? 1 : 0;
-	for (node = parent->first_child; node != NULL; node = node->next) {
-		n++;
-	}
-
-	return n;
+	return (tree_node_has_dummy_child (parent) ? 1 : 0) + tree_node_get_n_children (parent);
 }
 
 static gboolean
@@ -1408,7 +1544,7 @@ fm_tree_model_iter_nth_child (GtkTreeModel *model, GtkTreeIter *iter,
 				    GtkTreeIter *parent_iter, int n)
 {
 	FMTreeModel *tree_model;
-	TreeNode *parent, *node;
+	TreeNode *parent;
 	int i;
 	
 	g_return_val_if_fail (FM_IS_TREE_MODEL (model), FALSE);
@@ -1417,10 +1553,12 @@ fm_tree_model_iter_nth_child (GtkTreeModel *model, GtkTreeIter *iter,
 	
 	tree_model = FM_TREE_MODEL (model);
 
+	if (n < 0) {
+		return make_iter_invalid (iter);
+	}
+
 	if (parent_iter == NULL) {
-		node = tree_model->details->root_node;
-		for (i = 0; i < n && node != NULL; i++, node = node->next);
-		return make_iter_for_node (node, iter,
+		return make_iter_for_node (get_root_node (tree_model, n), iter,
 		                           tree_model->details->stamp);
 	}
 
@@ -1433,25 +1571,21 @@ fm_tree_model_iter_nth_child (GtkTreeModel *model, GtkTreeIter *iter,
 	if (n == 0 && i == 1) {
 		return make_iter_for_dummy_row (parent, iter, parent_iter->stamp);
 	}
-	for (node = parent->first_child; i != n; i++, node = node->next) {
-		if (node == NULL) {
-			return make_iter_invalid (iter);
-		}
-	}
 
-	return make_iter_for_node (node, iter, parent_iter->stamp);	
+	return make_iter_for_node (tree_node_get_nth_child (parent, n - i), iter, parent_iter->stamp);
 }
 
 static void
 update_monitoring (FMTreeModel *model, TreeNode *node)
 {
 	TreeNode *child;
+	guint i;
 
 	if (node->all_children_ref_count == 0) {
 		stop_monitoring_directory (model, node);
 		destroy_children (model, node);
 	} else {
-		for (child = node->first_child; child != NULL; child = child->next) {
+		for (i = 0; (child = tree_node_get_nth_child (node, i)) != NULL; i++) {
 			update_monitoring (model, child);
 		}
 		start_monitoring_directory (model, node);
@@ -1463,10 +1597,11 @@ update_monitoring_idle_callback (gpointer callback_data)
 {
 	FMTreeModel *model;
 	TreeNode *node;
+	guint i;
 
 	model = FM_TREE_MODEL (callback_data);
 	model->details->monitoring_update_idle_id = 0;
-	for (node = model->details->root_node; node != NULL; node = node->next) { 
+	for (i = 0; (node = get_root_node (model, i)) != NULL; i++) {
 		update_monitoring (model, node);
 	}
 	return FALSE;
@@ -1485,9 +1620,10 @@ static void
 stop_monitoring_directory_and_children (FMTreeModel *model, TreeNode *node)
 {
 	TreeNode *child;
+	guint i;
 
 	stop_monitoring_directory (model, node);
-	for (child = node->first_child; child != NULL; child = child->next) {
+	for (i = 0; (child = tree_node_get_nth_child (node, i)) != NULL; i++) {
 		stop_monitoring_directory_and_children (model, child);
 	}
 }
@@ -1496,8 +1632,9 @@ static void
 stop_monitoring (FMTreeModel *model)
 {
 	TreeNode *node;
+	guint i;
 
-	for (node = model->details->root_node; node != NULL; node = node->next) {
+	for (i = 0; (node = get_root_node (model, i)) != NULL; i++) {
 		stop_monitoring_directory_and_children (model, node);
 	}
 }
@@ -1527,7 +1664,7 @@ fm_tree_model_ref_node (GtkTreeModel *model, GtkTreeIter *iter)
 	if (parent != NULL) {
 		g_assert (parent->all_children_ref_count >= 0);
 		if (++parent->all_children_ref_count == 1) {
-			if (parent->first_child == NULL) {
+			if (tree_node_get_n_children (parent) == 0) {
 				parent->done_loading = FALSE;
 			}
 			schedule_monitoring_update (FM_TREE_MODEL (model));
@@ -1581,7 +1718,7 @@ void
 fm_tree_model_add_root_uri (FMTreeModel *model, const char *root_uri, const char *display_name, GIcon *icon, GMount *mount)
 {
 	NautilusFile *file;
-	TreeNode *node, *cnode;
+	TreeNode *node;
 	FMTreeModelRoot *newroot;
 	
 	file = nautilus_file_get_by_uri (root_uri);
@@ -1595,14 +1732,8 @@ fm_tree_model_add_root_uri (FMTreeModel *model, const char *root_uri, const char
 	}
 	newroot->root_node = node;
 	node->parent = NULL;
-	if (model->details->root_node == NULL) {
-		model->details->root_node = node;
-	} else {
-		/* append it */
-		for (cnode = model->details->root_node; cnode->next != NULL; cnode = cnode->next);
-		cnode->next = node;
-		node->prev = cnode;
-	}
+	node->index = model->details->root_nodes->len;
+	g_ptr_array_add (model->details->root_nodes, node);
 
 	nautilus_file_unref (file);
 
@@ -1614,8 +1745,9 @@ GMount *
 fm_tree_model_get_mount_for_root_node_file (FMTreeModel *model, NautilusFile *file)
 {
 	TreeNode *node;
+	guint i;
 
-	for (node = model->details->root_node; node != NULL; node = node->next) {
+	for (i = 0; (node = get_root_node (model, i)) != NULL; i++) {
 		if (file == node->file) {
 			break;
 		}
@@ -1635,9 +1767,10 @@ fm_tree_model_remove_root_uri (FMTreeModel *model, const char *uri)
 	GtkTreePath *path;
 	FMTreeModelRoot *root;
 	NautilusFile *file;
+	guint i;
 
 	file = nautilus_file_get_by_uri (uri);
-	for (node = model->details->root_node; node != NULL; node = node->next) {
+	for (i = 0; (node = get_root_node (model, i)) != NULL; i++) {
 		if (file == node->file) {
 			break;
 		}
@@ -1659,16 +1792,6 @@ fm_tree_model_remove_root_uri (FMTreeModel *model, const char *uri)
 		gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
 		gtk_tree_path_free (path);
 		
-		if (node->prev) {
-			node->prev->next = node->next;
-		}
-		if (node->next) {
-			node->next->prev = node->prev;
-		}
-		if (node == model->details->root_node) {
-			model->details->root_node = node->next;
-		}
-		
 		/* destroy the root identifier */
 		root = node->root;
 		destroy_node_without_reporting (model, node);
@@ -1751,7 +1874,7 @@ fm_tree_model_iter_compare_roots (FMTreeModel *model,
 				  GtkTreeIter *iter_a,
 				  GtkTreeIter *iter_b)
 {
-	TreeNode *a, *b, *n;
+	TreeNode *a, *b;
 
 	g_return_val_if_fail (FM_IS_TREE_MODEL (model), 0);
 	g_return_val_if_fail (iter_is_valid (model, iter_a), 0);
@@ -1766,16 +1889,8 @@ fm_tree_model_iter_compare_roots (FMTreeModel *model,
 	if (a == b) {
 		return 0;
 	}
-	
-	for (n = model->details->root_node; n != NULL; n = n->next) {
-		if (n == a) {
-			return -1;
-		}
-		if (n == b) {
-			return 1;
-		}
-	}
-	g_assert_not_reached ();
+
+	return a->index < b->index ? -1 : 1;
 }
 
 gboolean
@@ -1800,13 +1915,14 @@ fm_tree_model_file_get_iter (FMTreeModel *model,
 				   GtkTreeIter *current_iter)
 {
 	TreeNode *node, *root_node;
+	guint i;
 
 	if (current_iter != NULL && current_iter->user_data != NULL) {
 		node = get_node_from_file (((TreeNode *) current_iter->user_data)->root, file);
 		return make_iter_for_node (node, iter, model->details->stamp);
 	}
 
-	for (root_node = model->details->root_node; root_node != NULL; root_node = root_node->next) {
+	for (i = 0; (root_node = get_root_node (model, i)) != NULL; i++) {
 		node = get_node_from_file (root_node->root, file);
 		if (node != NULL) {
 			return make_iter_for_node (node, iter, model->details->stamp);
@@ -1819,6 +1935,7 @@ static void
 fm_tree_model_init (FMTreeModel *model)
 {
 	model->details = g_new0 (FMTreeModelDetails, 1);
+	model->details->root_nodes = g_ptr_array_new ();
 
 	do {
 		model->details->stamp = g_random_int ();
@@ -1829,13 +1946,14 @@ static void
 fm_tree_model_finalize (GObject *object)
 {
 	FMTreeModel *model;
-	TreeNode *root_node, *next_root;
+	TreeNode *root_node;
 	FMTreeModelRoot *root;
 
 	model = FM_TREE_MODEL (object);
 
-	for (root_node = model->details->root_node; root_node != NULL; root_node = next_root) {
-		next_root = root_node->next;
+	while (model->details->root_nodes->len != 0) {
+		root_node = g_ptr_array_index (model->details->root_nodes,
+					       model->details->root_nodes->len - 1);
 		root = root_node->root;
 		destroy_node_without_reporting (model, root_node);
 		g_hash_table_destroy (root->file_to_node_map);
@@ -1846,6 +1964,11 @@ fm_tree_model_finalize (GObject *object)
 		g_source_remove (model->details->monitoring_update_idle_id);
 	}
 
+	if (model->details->pending_files_flush_id != 0) {
+		g_source_remove (model->details->pending_files_flush_id);
+	}
+
+	g_ptr_array_free (model->details->root_nodes, TRUE);
 	g_free (model->details);
 
 	G_OBJECT_CLASS (fm_tree_model_parent_class)->finalize (object);
@@ -46,6 +46,8 @@
 #include <glib/gi18n.h>
 #include <gio/gdesktopappinfo.h>
 #include <libnautilus-private/nautilus-debug-log.h>
+#include <libnautilus-private/nautilus-file-operation-stats.h>
+#include <libnautilus-private/nautilus-trace.h>
 #include <libnautilus-private/nautilus-global-preferences.h>
 #include <libnautilus-private/nautilus-lib-self-check-functions.h>
 #include <libnautilus-private/nautilus-icon-names.h>
@@ -163,6 +165,15 @@ dump_debug_log (void)
 	filename = g_build_filename (g_get_home_dir (), "nautilus-debug-log.txt", NULL);
 	nautilus_debug_log_dump (filename, NULL); /* NULL GError */
 	g_free (filename);
+
+	filename = g_build_filename (g_get_home_dir (), "nautilus-file-operation-stats.txt", NULL);
+	nautilus_file_operation_stats_dump (filename, NULL); /* NULL GError */
+	g_free (filename);
+
+	/* For chrome://tracing or Perfetto */
+	filename = g_build_filename (g_get_home_dir (), "nautilus-trace.json", NULL);
+	nautilus_trace_dump (filename, NULL); /* NULL GError */
+	g_free (filename);
 }
 
 static int debug_log_pipes[2];
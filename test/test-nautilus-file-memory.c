@@ -0,0 +1,158 @@
+/* Reports how much memory NautilusFile objects take per loaded file.
+ *
+ * Usage: test-nautilus-file-memory [DIRECTORY]
+ *
+ * Without a directory, a temporary one with N_GENERATED_FILES empty
+ * files is created and removed again afterwards. Run it on two builds
+ * to compare them.
+ */
+
+#include <gtk/gtk.h>
+#include <libnautilus-private/nautilus-directory.h>
+#include <libnautilus-private/nautilus-file.h>
+#include <libnautilus-private/nautilus-file-private.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define N_GENERATED_FILES 100000
+
+static GMainLoop *loop;
+static GList *loaded_files;
+
+static long
+get_heap_in_use (void)
+{
+#ifdef __GLIBC__
+	struct mallinfo info;
+
+	info = mallinfo ();
+	return info.uordblks + info.hblkhd;
+#else
+	return -1;
+#endif
+}
+
+static char *
+create_test_directory (int n_files)
+{
+	char *path, *name;
+	int i;
+
+	path = g_build_filename (g_get_tmp_dir (), "nautilus-file-memory-XXXXXX", NULL);
+	if (mkdtemp (path) == NULL) {
+		g_error ("Can't create test directory %s", path);
+	}
+
+	for (i = 0; i < n_files; i++) {
+		name = g_strdup_printf ("%s/file-%07d.txt", path, i);
+		g_file_set_contents (name, "", 0, NULL);
+		g_free (name);
+	}
+
+	return path;
+}
+
+static void
+remove_test_directory (const char *path)
+{
+	GDir *dir;
+	const char *name;
+	char *filename;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir != NULL) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			filename = g_build_filename (path, name, NULL);
+			g_unlink (filename);
+			g_free (filename);
+		}
+		g_dir_close (dir);
+	}
+	g_rmdir (path);
+}
+
+static void
+directory_ready (NautilusDirectory *directory,
+		 GList *files,
+		 gpointer callback_data)
+{
+	loaded_files = nautilus_file_list_copy (files);
+	g_main_loop_quit (loop);
+}
+
+int
+main (int argc, char **argv)
+{
+	NautilusDirectory *directory;
+	NautilusFile *file;
+	GList *l;
+	char *path, *uri;
+	gboolean generated;
+	long heap_before, heap_after;
+	int n_files, n_rare;
+	GTimer *timer;
+
+	gtk_init (&argc, &argv);
+
+	generated = argc < 2;
+	if (generated) {
+		path = create_test_directory (N_GENERATED_FILES);
+	} else {
+		path = g_strdup (argv[1]);
+	}
+	uri = g_filename_to_uri (path, NULL, NULL);
+
+	loop = g_main_loop_new (NULL, FALSE);
+	timer = g_timer_new ();
+
+	heap_before = get_heap_in_use ();
+
+	directory = nautilus_directory_get_by_uri (uri);
+	nautilus_directory_call_when_ready (directory,
+					    NAUTILUS_FILE_ATTRIBUTE_INFO,
+					    TRUE,
+					    directory_ready, NULL);
+	g_main_loop_run (loop);
+
+	heap_after = get_heap_in_use ();
+
+	n_files = 0;
+	n_rare = 0;
+	for (l = loaded_files; l != NULL; l = l->next) {
+		file = l->data;
+		n_files++;
+		if (file->details->rare != NULL) {
+			n_rare++;
+		}
+	}
+
+	g_print ("directory:                   %s\n", path);
+	g_print ("files loaded:                %d in %.2f s\n", n_files, g_timer_elapsed (timer, NULL));
+	g_print ("sizeof NautilusFileDetails:  %d\n", (int) sizeof (NautilusFileDetails));
+	g_print ("sizeof rare details:         %d (%d files use them)\n",
+		 (int) sizeof (NautilusFileRareDetails), n_rare);
+	if (heap_before >= 0 && n_files > 0) {
+		g_print ("heap bytes per loaded file:  %ld\n",
+			 (heap_after - heap_before) / n_files);
+	} else {
+		g_print ("heap bytes per loaded file:  not available on this platform\n");
+	}
+
+	nautilus_file_list_free (loaded_files);
+	nautilus_directory_unref (directory);
+
+	if (generated) {
+		remove_test_directory (path);
+	}
+
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+	g_free (uri);
+	g_free (path);
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+/* Times sorting synthetic NautilusFile objects, one pair at a time
+ * as views used to and with nautilus_file_sort_keys_sort().
+ *
+ * Usage: test-nautilus-file-sort [N_FILES...]
+ *
+ * Without arguments, 10000, 100000 and 1000000 files are sorted. The
+ * files are never loaded, so only their names are known.
+ *
+ * Both ways are run once untimed, so whichever goes first doesn't pay
+ * for filling the caches of the files. After that they take turns
+ * going first, and the best of the rounds is printed.
+ */
+
+#include <gtk/gtk.h>
+#include <libnautilus-private/nautilus-file.h>
+#include <stdlib.h>
+
+#define TIMED_ROUNDS 3
+
+static NautilusFile *
+get_file (gpointer item)
+{
+	return item;
+}
+
+static int
+compare_by_name (gconstpointer a, gconstpointer b, gpointer callback_data)
+{
+	return nautilus_file_compare_for_sort (NAUTILUS_FILE (a), NAUTILUS_FILE (b),
+					       NAUTILUS_FILE_SORT_BY_DISPLAY_NAME,
+					       FALSE, FALSE);
+}
+
+static int
+compare_by_attribute (gconstpointer a, gconstpointer b, gpointer callback_data)
+{
+	return nautilus_file_compare_for_sort_by_attribute_q (NAUTILUS_FILE (a), NAUTILUS_FILE (b),
+							      GPOINTER_TO_UINT (callback_data),
+							      FALSE, FALSE);
+}
+
+static GList *
+list_from_array (gpointer *files, int n_files)
+{
+	GList *list;
+	int i;
+
+	list = NULL;
+	for (i = 0; i < n_files; i++) {
+		list = g_list_prepend (list, files[i]);
+	}
+
+	return list;
+}
+
+static void
+shuffle (gpointer *files, int n_files)
+{
+	gpointer file;
+	int i, j;
+
+	for (i = n_files - 1; i > 0; i--) {
+		j = g_random_int_range (0, i + 1);
+		file = files[i];
+		files[i] = files[j];
+		files[j] = file;
+	}
+}
+
+static double
+time_list_sort (gpointer *files, int n_files,
+		GCompareDataFunc compare, gpointer data)
+{
+	GTimer *timer;
+	GList *list;
+	double elapsed;
+
+	list = list_from_array (files, n_files);
+
+	timer = g_timer_new ();
+	list = g_list_sort_with_data (list, compare, data);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	g_timer_destroy (timer);
+	g_list_free (list);
+
+	return elapsed;
+}
+
+static double
+time_keys_sort (gpointer *files, int n_files, GQuark attribute)
+{
+	NautilusFileSortKeys *keys;
+	GTimer *timer;
+	gpointer *array;
+	double elapsed;
+
+	array = g_memdup (files, n_files * sizeof (gpointer));
+
+	timer = g_timer_new ();
+	keys = nautilus_file_sort_keys_new (attribute, FALSE, FALSE);
+	nautilus_file_sort_keys_sort (keys, array, n_files, get_file);
+	nautilus_file_sort_keys_free (keys);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	g_timer_destroy (timer);
+	g_free (array);
+
+	return elapsed;
+}
+
+static void
+time_sorts (gpointer *files, int n_files,
+	    GCompareDataFunc compare, gpointer data, GQuark attribute,
+	    double *list_time, double *keys_time)
+{
+	double elapsed;
+	int i;
+
+	time_list_sort (files, n_files, compare, data);
+	time_keys_sort (files, n_files, attribute);
+
+	*list_time = G_MAXDOUBLE;
+	*keys_time = G_MAXDOUBLE;
+	for (i = 0; i < TIMED_ROUNDS; i++) {
+		if (i % 2 == 0) {
+			elapsed = time_list_sort (files, n_files, compare, data);
+			*list_time = MIN (*list_time, elapsed);
+			elapsed = time_keys_sort (files, n_files, attribute);
+			*keys_time = MIN (*keys_time, elapsed);
+		} else {
+			elapsed = time_keys_sort (files, n_files, attribute);
+			*keys_time = MIN (*keys_time, elapsed);
+			elapsed = time_list_sort (files, n_files, compare, data);
+			*list_time = MIN (*list_time, elapsed);
+		}
+	}
+}
+
+static void
+run (int n_files)
+{
+	gpointer *files;
+	GQuark name, uri;
+	char *file_uri;
+	double list_time, keys_time;
+	int i;
+
+	name = g_quark_from_static_string ("name");
+	uri = g_quark_from_static_string ("uri");
+
+	files = g_new (gpointer, n_files);
+	for (i = 0; i < n_files; i++) {
+		file_uri = g_strdup_printf ("file:///nautilus-file-sort-test/file-%d.txt",
+					    g_random_int ());
+		files[i] = nautilus_file_get_by_uri (file_uri);
+		g_free (file_uri);
+	}
+	shuffle (files, n_files);
+
+	time_sorts (files, n_files, compare_by_name, NULL, name,
+		    &list_time, &keys_time);
+	g_print ("%8d files  by name:  list %7.3f s  keys %7.3f s\n",
+		 n_files, list_time, keys_time);
+	time_sorts (files, n_files, compare_by_attribute, GUINT_TO_POINTER (uri), uri,
+		    &list_time, &keys_time);
+	g_print ("%8d files  by uri:   list %7.3f s  keys %7.3f s\n",
+		 n_files, list_time, keys_time);
+
+	for (i = 0; i < n_files; i++) {
+		nautilus_file_unref (files[i]);
+	}
+	g_free (files);
+}
+
+int
+main (int argc, char **argv)
+{
+	int i;
+
+	g_thread_init (NULL);
+	gtk_init (&argc, &argv);
+
+	if (argc < 2) {
+		run (10000);
+		run (100000);
+		run (1000000);
+	} else {
+		for (i = 1; i < argc; i++) {
+			run (atoi (argv[i]));
+		}
+	}
+
+	return 0;
+}